@@ -0,0 +1,205 @@
+// FILE: ball_tree.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ball_tree.h"
+#include "frame.h"
+#include "knn_heap.h"
+
+static void *bt_alloc(void *p, size_t n, size_t size) {
+    p = realloc(p, (n ? n : 1) * size);
+    if (!p) {
+        fprintf(stderr, "Error: Out of memory for ball tree\n");
+        exit(1);
+    }
+    return p;
+}
+
+// Ranking key of a point: squared distance for euclidean, so leaves never
+// take a sqrt, and the plain distance for manhattan
+static inline double point_key(const double *a, const double *b, int d, int use_euclidean) {
+    double s = 0.0;
+    if (use_euclidean) {
+        for (int j = 0; j < d; j++) {
+            double v = a[j] - b[j];
+            s += v * v;
+        }
+    } else {
+        for (int j = 0; j < d; j++) s += fabs(a[j] - b[j]);
+    }
+    return s;
+}
+
+static inline double key_to_dist(double key, int use_euclidean) {
+    return use_euclidean ? sqrt(key) : key;
+}
+
+static int new_node(BallTree *T, int start, int end) {
+    if (T->n_nodes == T->cap_nodes) {
+        int cap = T->cap_nodes ? T->cap_nodes * 2 : 64;
+        T->start = bt_alloc(T->start, cap, sizeof(int));
+        T->end = bt_alloc(T->end, cap, sizeof(int));
+        T->left = bt_alloc(T->left, cap, sizeof(int));
+        T->right = bt_alloc(T->right, cap, sizeof(int));
+        T->radius = bt_alloc(T->radius, cap, sizeof(double));
+        T->center = bt_alloc(T->center, (size_t)cap * T->d, sizeof(double));
+        T->cap_nodes = cap;
+    }
+    int id = T->n_nodes++;
+    T->start[id] = start;
+    T->end[id] = end;
+    T->left[id] = T->right[id] = -1;
+    return id;
+}
+
+// Reorder order[lo, hi) so position nth holds the value it would have after
+// sorting on column dim; three way partitions keep one hot ties cheap
+static void select_nth(const Frame *X, int *order, int lo, int hi, int nth, int dim) {
+    while (hi - lo > 1) {
+        double pivot = frame_row(X, order[lo + (hi - lo) / 2])[dim];
+        int lt = lo, i = lo, gt = hi;
+        while (i < gt) {
+            double v = frame_row(X, order[i])[dim];
+            if (v < pivot) {
+                int t = order[lt]; order[lt++] = order[i]; order[i++] = t;
+            } else if (v > pivot) {
+                int t = order[--gt]; order[gt] = order[i]; order[i] = t;
+            } else {
+                i++;
+            }
+        }
+        if (nth < lt) hi = lt;
+        else if (nth >= gt) lo = gt;
+        else return;
+    }
+}
+
+// Build the subtree over order[start, end); returns its node id
+static int build(BallTree *T, const Frame *X, int *order, int start, int end, int leaf_size) {
+    int d = T->d;
+    int id = new_node(T, start, end);
+    double *c = T->center + (size_t)id * d;
+
+    // centroid, radius, and the column with the widest spread
+    for (int j = 0; j < d; j++) c[j] = 0.0;
+    for (int i = start; i < end; i++) {
+        const double *x = frame_row(X, order[i]);
+        for (int j = 0; j < d; j++) c[j] += x[j];
+    }
+    for (int j = 0; j < d; j++) c[j] /= (end - start);
+
+    double r = 0.0;
+    for (int i = start; i < end; i++) {
+        double dist = key_to_dist(point_key(frame_row(X, order[i]), c, d, T->use_euclidean),
+                                  T->use_euclidean);
+        if (dist > r) r = dist;
+    }
+    T->radius[id] = r;
+    if (end - start <= leaf_size || r == 0.0) return id;
+
+    int dim = 0;
+    double best_spread = -1.0;
+    for (int j = 0; j < d; j++) {
+        double lo = INFINITY, hi = -INFINITY;
+        for (int i = start; i < end; i++) {
+            double v = frame_row(X, order[i])[j];
+            if (v < lo) lo = v;
+            if (v > hi) hi = v;
+        }
+        if (hi - lo > best_spread) { best_spread = hi - lo; dim = j; }
+    }
+
+    int mid = start + (end - start) / 2;
+    select_nth(X, order, start, end, mid, dim);
+
+    // children may move T->center, so only ids are kept across the calls
+    int left = build(T, X, order, start, mid, leaf_size);
+    int right = build(T, X, order, mid, end, leaf_size);
+    T->left[id] = left;
+    T->right[id] = right;
+    return id;
+}
+
+// Index the rows of X (leaf_size <= 0 picks BALL_TREE_LEAF)
+void ball_tree_build(BallTree *T, const Frame *X, int use_euclidean, int leaf_size) {
+    memset(T, 0, sizeof(*T));
+    T->n = X->rows;
+    T->d = X->cols;
+    T->use_euclidean = use_euclidean;
+    if (leaf_size <= 0) leaf_size = BALL_TREE_LEAF;
+
+    T->index = bt_alloc(NULL, T->n, sizeof(int));
+    for (int i = 0; i < T->n; i++) T->index[i] = i;
+    if (T->n > 0) build(T, X, T->index, 0, T->n, leaf_size);
+
+    T->points = bt_alloc(NULL, (size_t)T->n * T->d, sizeof(double));
+    for (int i = 0; i < T->n; i++)
+        memcpy(T->points + (size_t)i * T->d, frame_row(X, T->index[i]), T->d * sizeof(double));
+}
+
+typedef struct {
+    const BallTree *T;
+    const double *x;
+    KnnHeap h;
+} TreeQuery;
+
+static double center_dist(const BallTree *T, int node, const double *x) {
+    return key_to_dist(point_key(x, T->center + (size_t)node * T->d, T->d, T->use_euclidean),
+                       T->use_euclidean);
+}
+
+// Depth first, nearer child first; a node is skipped once even its closest
+// possible point (center distance minus radius) is beyond the k-th best
+static void search(TreeQuery *q, int node, double dist_c) {
+    const BallTree *T = q->T;
+    double lb = dist_c - T->radius[node];
+    if (q->h.count == q->h.k && lb > 0.0) {
+        lb *= 1.0 - 1e-12; // keep exact ties with the k-th best reachable
+        if ((T->use_euclidean ? lb * lb : lb) > q->h.dist[0]) return;
+    }
+
+    if (T->left[node] < 0) {
+        for (int p = T->start[node]; p < T->end[node]; p++)
+            heap_push(&q->h, point_key(q->x, T->points + (size_t)p * T->d, T->d, T->use_euclidean),
+                      T->index[p]);
+        return;
+    }
+
+    int l = T->left[node], r = T->right[node];
+    double dl = center_dist(T, l, q->x);
+    double dr = center_dist(T, r, q->x);
+    if (dl <= dr) {
+        search(q, l, dl);
+        search(q, r, dr);
+    } else {
+        search(q, r, dr);
+        search(q, l, dl);
+    }
+}
+
+// The k nearest rows to x, nearest first (equal distances by row). idx_out
+// and dist_out need room for k entries; returns how many were found.
+int ball_tree_query(const BallTree *T, const double *x, int k,
+                    int *idx_out, double *dist_out) {
+    if (T->n == 0 || k <= 0) return 0;
+    TreeQuery q = { T, x, { k < T->n ? k : T->n, 0, dist_out, idx_out } };
+    search(&q, 0, center_dist(T, 0, x));
+
+    heap_sort(&q.h);
+    for (int i = 0; i < q.h.count; i++) dist_out[i] = key_to_dist(dist_out[i], T->use_euclidean);
+    return q.h.count;
+}
+
+void ball_tree_free(BallTree *T) {
+    free(T->points);
+    free(T->index);
+    free(T->start);
+    free(T->end);
+    free(T->left);
+    free(T->right);
+    free(T->center);
+    free(T->radius);
+    memset(T, 0, sizeof(*T));
+}
@@ -0,0 +1,15 @@
+// FILE: ball_tree.h
+
+#ifndef BALL_TREE_H
+#define BALL_TREE_H
+
+#include "data_types.h"
+
+#define BALL_TREE_LEAF 32 // default points per leaf
+
+void ball_tree_build(BallTree *T, const Frame *X, int use_euclidean, int leaf_size);
+int ball_tree_query(const BallTree *T, const double *x, int k,
+                    int *idx_out, double *dist_out);
+void ball_tree_free(BallTree *T);
+
+#endif
@@ -0,0 +1,149 @@
+// FILE: chunk_reader.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chunk_reader.h"
+#include "data_utils.h"
+#include "preprocessing.h"
+#include "frame.h"
+#include "str_dict.h"
+
+// Start a pass over the CSV at its first data row; a pass from the top also
+// writes the dataset cache as it goes
+static void csv_start(ChunkReader *r) {
+    if (csv_open(&r->csv, r->path, 0) != 0) {
+        fprintf(stderr, "Error: Cannot open file %s\n", r->path);
+        exit(1);
+    }
+    r->col_count = read_csv_header(&r->csv, r->target, NULL, &r->target_index);
+    if (r->col_count - 1 != r->encoding.n_cols) {
+        fprintf(stderr, "Error: %s changed while streaming it\n", r->path);
+        exit(1);
+    }
+    for (int i = 0, c = 0; i < r->col_count; i++)
+        if (i != r->target_index) r->field_of[c++] = i;
+    r->csv_active = 1;
+    dataset_cache_begin(&r->writer, r->path, r->target, r->rows, &r->X, &r->encoding);
+}
+
+// Stream the rows of path (with target_col as the target) chunk_rows at a
+// time (CHUNK_ROWS_DEFAULT when chunk_rows <= 0). Without a valid cache the
+// encoding is fitted by encoding_scan first.
+void chunk_reader_open(ChunkReader *r, const char *path, const char *target_col, int chunk_rows) {
+    memset(r, 0, sizeof(*r));
+    snprintf(r->path, sizeof(r->path), "%s", path);
+    strncpy(r->target, target_col, MAX_STR - 1);
+    r->chunk_rows = chunk_rows > 0 ? chunk_rows : CHUNK_ROWS_DEFAULT;
+
+    r->cache = dataset_cache_open(path, target_col, &r->layout, &r->encoding);
+    if (r->cache) {
+        r->rows = r->layout.rows;
+        printf("Streaming %d rows from the dataset cache\n", r->rows);
+        if (r->encoding.target_is_categorical)
+            printf("Target is categorical with %d unique classes\n",
+                   r->encoding.target_classes.count);
+        else
+            printf("Target is numeric (regression)\n");
+    } else {
+        r->rows = encoding_scan(path, target_col, &r->encoding);
+    }
+
+    if (r->chunk_rows > r->rows) r->chunk_rows = r->rows;
+    frame_init(&r->X, r->chunk_rows, r->encoding.n_encoded_cols);
+    encoding_colnames(&r->encoding, r->X.colnames);
+    r->X.rows = 0;
+    r->y = malloc((size_t)r->chunk_rows * sizeof(double));
+    int n_cols = r->encoding.n_cols > 0 ? r->encoding.n_cols : 1;
+    r->field_of = malloc((size_t)n_cols * sizeof(int));
+    r->cells = malloc((size_t)n_cols * sizeof(char *));
+    if (!r->y || !r->field_of || !r->cells) {
+        fprintf(stderr, "Error: Out of memory for chunk buffers\n");
+        exit(1);
+    }
+}
+
+// Load the next chunk into r->X / r->y (class codes for a categorical
+// target); returns its row count, 0 once the pass is over
+int chunk_reader_next(ChunkReader *r) {
+    int want = r->rows - r->next;
+    if (want > r->chunk_rows) want = r->chunk_rows;
+    if (want <= 0) {
+        r->X.rows = 0;
+        return 0;
+    }
+    int d = r->X.cols;
+    const EncodingInfo *E = &r->encoding;
+
+    if (r->cache) {
+        size_t row_bytes = (size_t)d * sizeof(double);
+        if (fseek(r->cache, r->layout.data_offset + (long long)r->next * row_bytes, SEEK_SET) != 0 ||
+            fread(r->X.data, row_bytes, want, r->cache) != (size_t)want ||
+            fseek(r->cache, r->layout.y_offset + (long long)r->next * sizeof(double), SEEK_SET) != 0 ||
+            fread(r->y, sizeof(double), want, r->cache) != (size_t)want) {
+            fprintf(stderr, "Error: Cannot read the dataset cache of %s\n", r->path);
+            exit(1);
+        }
+    } else {
+        if (!r->csv_active) csv_start(r);
+        int got = 0, n_fields;
+        while (got < want && (n_fields = csv_next_row(&r->csv)) >= 0) {
+            if (n_fields < r->col_count) continue; // short row
+            for (int c = 0; c < E->n_cols; c++) r->cells[c] = r->csv.fields[r->field_of[c]];
+            double *x = frame_row(&r->X, got);
+            memset(x, 0, d * sizeof(double));
+            encode_cells(E, r->cells, x);
+            const char *cell = r->csv.fields[r->target_index];
+            r->y[got] = E->target_is_categorical
+                        ? (double)dict_find(&E->target_classes, cell) : atof(cell);
+            got++;
+        }
+        if (got < want) {
+            fprintf(stderr, "Error: %s changed while streaming it\n", r->path);
+            exit(1);
+        }
+        r->X.rows = got;
+        dataset_cache_append(&r->writer, &r->X, r->y);
+    }
+    r->X.rows = want;
+    r->next += want;
+
+    // the first full pass over the CSV has just written the cache: read that from now on
+    if (r->next == r->rows && !r->cache) {
+        csv_close(&r->csv);
+        r->csv_active = 0;
+        if (r->writer.fp) {
+            dataset_cache_end(&r->writer);
+            EncodingInfo cached;
+            r->cache = dataset_cache_open(r->path, r->target, &r->layout, &cached);
+            if (r->cache) encoding_info_free(&cached);
+        }
+    }
+    return want;
+}
+
+// Back to the first row for another pass
+void chunk_reader_rewind(ChunkReader *r) {
+    if (r->csv_active) {
+        csv_close(&r->csv);
+        r->csv_active = 0;
+        dataset_cache_end(&r->writer); // an unfinished cache is dropped
+    }
+    r->next = 0;
+    r->X.rows = 0;
+}
+
+void chunk_reader_close(ChunkReader *r) {
+    chunk_reader_rewind(r);
+    if (r->cache) fclose(r->cache);
+    r->cache = NULL;
+    r->X.rows = r->chunk_rows;
+    frame_free(&r->X);
+    free(r->y);
+    r->y = NULL;
+    free(r->field_of);
+    free(r->cells);
+    r->field_of = NULL;
+    r->cells = NULL;
+    encoding_info_free(&r->encoding);
+}
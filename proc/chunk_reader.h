@@ -0,0 +1,42 @@
+// FILE: chunk_reader.h
+
+#ifndef CHUNK_READER_H
+#define CHUNK_READER_H
+
+#include <stdio.h>
+#include "data_types.h"
+#include "csv_reader.h"
+#include "dataset_cache.h"
+
+#define CHUNK_ROWS_DEFAULT 65536  // rows per chunk unless asked otherwise
+
+// Encoded rows of a CSV handed out a chunk at a time, so memory holds one
+// chunk however long the file is. Rows come from the dataset cache when it
+// is valid and are parsed from the CSV otherwise; the first full pass over
+// the CSV writes the cache, so every later pass reads binary rows.
+typedef struct {
+    char path[4096];
+    char target[MAX_STR];
+    EncodingInfo encoding;   // fitted by encoding_scan or read from the cache
+    int rows;                // data rows in the file
+    int chunk_rows;
+    int next;                // file row the next chunk starts at
+    Frame X;                 // current chunk (X.rows of them)
+    double *y;
+    CsvReader csv;           // CSV source, open while csv_active
+    int csv_active;
+    int col_count;
+    int target_index;
+    int *field_of;           // CSV field of each original column
+    const char **cells;      // the current row's cells, by original column
+    CacheWriter writer;
+    FILE *cache;             // cache source, NULL while reading the CSV
+    CacheLayout layout;
+} ChunkReader;
+
+void chunk_reader_open(ChunkReader *r, const char *path, const char *target_col, int chunk_rows);
+int chunk_reader_next(ChunkReader *r);
+void chunk_reader_rewind(ChunkReader *r);
+void chunk_reader_close(ChunkReader *r);
+
+#endif
@@ -0,0 +1,433 @@
+// FILE: cross_validation.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cross_validation.h"
+#include "frame.h"
+#include "feature_store.h"
+#include "data_utils.h"
+#include "metrics.h"
+#include "parallel.h"
+#include "logistic_regression.h"
+#include "linear_regression.h"
+#include "naive_bayes.h"
+#include "decision_tree.h"
+#include "random_forest.h"
+#include "gradient_boosting.h"
+#include "knn.h"
+
+// Every tunable parameter, the model it belongs to and its default values
+typedef struct {
+    CvModel model;
+    const char *name;
+    const char *defaults;
+} ParamSpec;
+
+static const ParamSpec PARAMS[] = {
+    { CV_LOGISTIC, "l2",            "0,0.0001,0.01" },
+    { CV_TREE,     "max_depth",     "4,6,8,10,12" },
+    { CV_TREE,     "n_bins",        "16" },
+    { CV_FOREST,   "n_trees",       "25,50" },
+    { CV_FOREST,   "max_depth",     "8,12" },
+    { CV_GBM,      "learning_rate", "0.05,0.1,0.2" },
+    { CV_GBM,      "max_depth",     "3,6" },
+    { CV_KNN,      "k",             "5,7,9,15" },
+    { CV_KNN,      "weighted",      "0,1" },
+    { CV_LINEAR,   "ridge",         "0,1,10" },
+};
+#define N_PARAMS (int)(sizeof(PARAMS) / sizeof(PARAMS[0]))
+
+static const char *MODEL_KEYS[CV_N_MODELS] = {
+    "logistic", "nb", "tree", "forest", "gbm", "knn", "linear"
+};
+static const char *MODEL_NAMES[CV_N_MODELS] = {
+    "Logistic Regression", "Gaussian Naive Bayes", "Decision Tree", "Random Forest",
+    "Gradient Boosting", "K-Nearest Neighbors", "Linear Regression"
+};
+
+// Comma separated numbers into out; returns how many, -1 if malformed
+static int parse_values(const char *s, double *out) {
+    int n = 0;
+    while (*s) {
+        char *end;
+        double v = strtod(s, &end);
+        if (end == s || n == CV_MAX_VALUES) return -1;
+        out[n++] = v;
+        s = end;
+        if (*s == ',') s++;
+        else if (*s) return -1;
+    }
+    return n > 0 ? n : -1;
+}
+
+static int model_of(const char *key, size_t len) {
+    for (int m = 0; m < CV_N_MODELS; m++)
+        if (strlen(MODEL_KEYS[m]) == len && strncmp(MODEL_KEYS[m], key, len) == 0) return m;
+    return -1;
+}
+
+void cv_grid_default(CvGrid *grid) {
+    for (int p = 0; p < N_PARAMS; p++)
+        grid->n_values[p] = parse_values(PARAMS[p].defaults, grid->values[p]);
+    for (int m = 0; m < CV_N_MODELS; m++) grid->use_model[m] = 1;
+}
+
+// Override values from "model.param=v1,v2;model.param=v1": e.g.
+// "knn.k=3,5,11;tree.max_depth=6". Returns -1 on an unknown name or value.
+int cv_grid_parse(CvGrid *grid, const char *spec) {
+    const char *s = spec;
+    while (*s) {
+        const char *item_end = strchr(s, ';');
+        size_t len = item_end ? (size_t)(item_end - s) : strlen(s);
+        char item[MAX_STR];
+        if (len >= sizeof(item)) {
+            fprintf(stderr, "Error: grid entry too long\n");
+            return -1;
+        }
+        memcpy(item, s, len);
+        item[len] = '\0';
+        s += len + (item_end ? 1 : 0);
+        if (len == 0) continue;
+
+        char *dot = strchr(item, '.'), *eq = strchr(item, '=');
+        int m = dot ? model_of(item, dot - item) : -1;
+        int p = -1;
+        if (m >= 0 && eq && eq > dot) {
+            *eq = '\0';
+            for (int q = 0; q < N_PARAMS; q++)
+                if ((int)PARAMS[q].model == m && strcmp(PARAMS[q].name, dot + 1) == 0) p = q;
+        }
+        if (p < 0) {
+            fprintf(stderr, "Error: unknown grid parameter %s\n", item);
+            return -1;
+        }
+        int n = parse_values(eq + 1, grid->values[p]);
+        if (n < 0) {
+            fprintf(stderr, "Error: bad values for grid parameter %s\n", item);
+            return -1;
+        }
+        grid->n_values[p] = n;
+    }
+    return 0;
+}
+
+// Keep only the models in a comma separated list of keys
+int cv_grid_models(CvGrid *grid, const char *list) {
+    for (int m = 0; m < CV_N_MODELS; m++) grid->use_model[m] = 0;
+    const char *s = list;
+    while (*s) {
+        size_t len = strcspn(s, ",");
+        int m = model_of(s, len);
+        if (m < 0) {
+            fprintf(stderr, "Error: unknown model %.*s\n", (int)len, s);
+            return -1;
+        }
+        grid->use_model[m] = 1;
+        s += len + (s[len] == ',');
+    }
+    return 0;
+}
+
+void cv_grid_usage(void) {
+    printf("Grid parameters (--grid model.param=v1,v2;... , defaults shown):\n");
+    for (int p = 0; p < N_PARAMS; p++)
+        printf("  %s.%s=%s\n", MODEL_KEYS[PARAMS[p].model], PARAMS[p].name, PARAMS[p].defaults);
+}
+
+// One point of the grid: values are stored by PARAMS index
+typedef struct {
+    CvModel model;
+    double p[CV_MAX_PARAMS];
+} CvConfig;
+
+static double param(const CvConfig *c, const char *name) {
+    for (int q = 0; q < N_PARAMS; q++)
+        if (PARAMS[q].model == c->model && strcmp(PARAMS[q].name, name) == 0) return c->p[q];
+    return 0.0;
+}
+
+// Every combination of the enabled models' values, model by model
+static int expand_grid(const CvGrid *grid, CvConfig **out) {
+    int n = 0, cap = 16;
+    CvConfig *configs = malloc(cap * sizeof(CvConfig));
+    for (int m = 0; m < CV_N_MODELS; m++) {
+        if (!grid->use_model[m]) continue;
+        int own[CV_MAX_PARAMS], n_own = 0;
+        for (int q = 0; q < N_PARAMS; q++)
+            if ((int)PARAMS[q].model == m) own[n_own++] = q;
+
+        int at[CV_MAX_PARAMS] = { 0 };
+        for (;;) {
+            if (n == cap) configs = realloc(configs, (cap *= 2) * sizeof(CvConfig));
+            CvConfig *c = &configs[n++];
+            memset(c, 0, sizeof(*c));
+            c->model = (CvModel)m;
+            for (int i = 0; i < n_own; i++) c->p[own[i]] = grid->values[own[i]][at[i]];
+
+            // next combination, last parameter fastest
+            int i = n_own - 1;
+            while (i >= 0 && ++at[i] == grid->n_values[own[i]]) at[i--] = 0;
+            if (i < 0) break;
+        }
+    }
+    *out = configs;
+    return n;
+}
+
+// One fold: row views into the shared frame, its targets, and feature
+// stores standardized with the fold's own training stats
+typedef struct {
+    SplitIndex split;
+    Frame Xtr, Xte;
+    double *ytr, *yte;
+    int *ytr_int, *yte_int;
+    FeatureStore Ftr, Fte;
+} CvFold;
+
+typedef struct {
+    Frame *X;
+    const double *y;
+    const EncodingInfo *encoding_info;
+    const int *fold_of;
+    CvFold *folds;
+    const CvConfig *configs;
+    int n_folds;
+    double *metric1;     // per (config, fold) job
+    double *metric2;
+} CvJob;
+
+static void fold_task(void *ctx, int task, int begin, int end) {
+    CvJob *job = ctx;
+    (void)task;
+    for (int f = begin; f < end; f++) {
+        CvFold *fd = &job->folds[f];
+        kfold_split(job->fold_of, job->X->rows, f, &fd->split);
+        frame_view(job->X, fd->split.train, fd->split.n_train, &fd->Xtr);
+        frame_view(job->X, fd->split.test, fd->split.n_test, &fd->Xte);
+
+        int ntr = fd->split.n_train, nte = fd->split.n_test;
+        fd->ytr = malloc((ntr > 0 ? ntr : 1) * sizeof(double));
+        fd->yte = malloc((nte > 0 ? nte : 1) * sizeof(double));
+        fd->ytr_int = malloc((ntr > 0 ? ntr : 1) * sizeof(int));
+        fd->yte_int = malloc((nte > 0 ? nte : 1) * sizeof(int));
+        gather_values(job->y, fd->split.train, ntr, fd->ytr);
+        gather_values(job->y, fd->split.test, nte, fd->yte);
+        for (int i = 0; i < ntr; i++) fd->ytr_int[i] = (int)fd->ytr[i];
+        for (int i = 0; i < nte; i++) fd->yte_int[i] = (int)fd->yte[i];
+
+        Stats S;
+        features_from_frame(&fd->Xtr, job->encoding_info, &fd->Ftr);
+        features_from_frame(&fd->Xte, job->encoding_info, &fd->Fte);
+        stats_fit(&fd->Xtr, &S);
+        features_standardize(&fd->Ftr, &S);
+        features_standardize(&fd->Fte, &S);
+        stats_free(&S);
+    }
+}
+
+static int is_regression(CvModel m) {
+    return m == CV_LINEAR;
+}
+
+// Train one config on one fold's training rows and score its test rows:
+// accuracy and macro F1, or RMSE and R² for regression
+static void evaluate(const CvConfig *c, CvFold *fd, double *m1, double *m2) {
+    int nte = fd->Xte.rows, cols = fd->Xtr.cols;
+    int *pred = malloc((nte > 0 ? nte : 1) * sizeof(int));
+
+    switch (c->model) {
+    case CV_LOGISTIC: {
+        LogRegOptions o;
+        logistic_regression_default_options(&o, LOGREG_NEWTON);
+        o.l2 = param(c, "l2");
+        double *w = malloc(cols * sizeof(double)), b;
+        logistic_regression_fit_fs_opts(&fd->Ftr, fd->ytr_int, &o, w, &b, NULL);
+        logistic_regression_predict_fs(&fd->Fte, w, b, pred);
+        free(w);
+        break;
+    }
+    case CV_NAIVE_BAYES: {
+        GNBModel model = naive_bayes_fit_fs(&fd->Ftr, fd->ytr_int);
+        naive_bayes_predict_fs(&model, &fd->Fte, pred);
+        naive_bayes_free(&model);
+        break;
+    }
+    case CV_TREE: {
+        Node *tree = decision_tree_fit(&fd->Xtr, fd->ytr_int, (int)param(c, "max_depth"),
+                                       10, (int)param(c, "n_bins"));
+        decision_tree_predict(tree, &fd->Xte, pred);
+        decision_tree_free(tree);
+        break;
+    }
+    case CV_FOREST: {
+        ForestOptions o;
+        random_forest_default_options(&o);
+        o.n_trees = (int)param(c, "n_trees");
+        o.max_depth = (int)param(c, "max_depth");
+        RandomForest forest;
+        random_forest_fit(&forest, &fd->Xtr, fd->ytr_int, &o);
+        random_forest_predict(&forest, &fd->Xte, pred);
+        random_forest_free(&forest);
+        break;
+    }
+    case CV_GBM: {
+        GbmOptions o;
+        gbm_default_options(&o, GBM_LOGISTIC);
+        o.learning_rate = param(c, "learning_rate");
+        o.max_depth = (int)param(c, "max_depth");
+        GbmModel gbm;
+        gbm_fit(&gbm, &fd->Xtr, fd->ytr, &o, NULL);
+        gbm_predict(&gbm, &fd->Xte, pred);
+        gbm_free(&gbm);
+        break;
+    }
+    case CV_KNN:
+        knn_predict_fs(&fd->Ftr, fd->ytr_int, &fd->Fte, (int)param(c, "k"), 1,
+                       (int)param(c, "weighted"), 0, 1e-6, 0, pred);
+        break;
+    case CV_LINEAR: {
+        double *w = malloc(cols * sizeof(double)), b;
+        double *out = malloc((nte > 0 ? nte : 1) * sizeof(double));
+        if (linear_regression_fit_cholesky_fs(&fd->Ftr, fd->ytr, param(c, "ridge"), w, &b) != 0)
+            linear_regression_fit_fs(&fd->Ftr, fd->ytr, w, &b);
+        linear_regression_predict_fs(&fd->Fte, w, b, out);
+        *m1 = rmse_double(fd->yte, out, nte);
+        *m2 = r2_double(fd->yte, out, nte);
+        free(out);
+        free(w);
+        free(pred);
+        return;
+    }
+    default:
+        break;
+    }
+
+    *m1 = accuracy_int(fd->yte_int, pred, nte);
+    *m2 = macro_f1_int(fd->yte_int, pred, nte);
+    free(pred);
+}
+
+// Job j is config j / n_folds on fold j % n_folds
+static void cv_task(void *ctx, int task, int begin, int end) {
+    CvJob *job = ctx;
+    (void)task;
+    for (int j = begin; j < end; j++)
+        evaluate(&job->configs[j / job->n_folds], &job->folds[j % job->n_folds],
+                 &job->metric1[j], &job->metric2[j]);
+}
+
+typedef struct {
+    char name[MAX_STR];
+    int regression;
+    int order;
+    double metric1, metric2;  // means over the folds
+} CvRow;
+
+// Classifiers by accuracy (best first), then regressors by RMSE
+static int cmp_rows(const void *a, const void *b) {
+    const CvRow *x = a, *y = b;
+    if (x->regression != y->regression) return x->regression - y->regression;
+    if (x->metric1 != y->metric1)
+        return x->regression ? (x->metric1 > y->metric1 ? 1 : -1)
+                             : (x->metric1 < y->metric1 ? 1 : -1);
+    return x->order - y->order;
+}
+
+static void row_name(const CvConfig *c, char *out) {
+    int len = snprintf(out, MAX_STR, "%s", MODEL_NAMES[c->model]);
+    int first = 1;
+    for (int q = 0; q < N_PARAMS && len < MAX_STR; q++) {
+        if (PARAMS[q].model != c->model) continue;
+        len += snprintf(out + len, MAX_STR - len, "%s%s=%g", first ? " (" : " ",
+                        PARAMS[q].name, c->p[q]);
+        first = 0;
+    }
+    if (!first && len < MAX_STR) snprintf(out + len, MAX_STR - len, ")");
+}
+
+// k-fold cross-validation of every grid config. Folds are prepared once and
+// shared read-only; (config, fold) fits run concurrently, one per free
+// thread. Mean fold metrics go to out_csv in the c_model_results.csv layout,
+// best first, and to stdout.
+void cv_run(Frame *X, const double *y, const EncodingInfo *encoding_info,
+            const CvGrid *grid, int folds, int shuffle, int stratify,
+            unsigned long long seed, const char *out_csv) {
+    int n = X->rows;
+    if (folds < 2) folds = 2;
+    if (folds > n) folds = n;
+
+    // gbm is fitted with logistic loss, which only fits a two-class target
+    CvGrid use = *grid;
+    if (use.use_model[CV_GBM] && !(encoding_info->target_is_categorical &&
+                                   encoding_info->target_classes.count == 2)) {
+        printf("Skipping gbm: the target is not a two-class label\n");
+        use.use_model[CV_GBM] = 0;
+    }
+
+    CvConfig *configs;
+    int n_configs = expand_grid(&use, &configs);
+    int n_jobs = n_configs * folds;
+    printf("Cross-validation: %d configs x %d folds = %d fits\n", n_configs, folds, n_jobs);
+
+    int *fold_of = malloc((n > 0 ? n : 1) * sizeof(int));
+    kfold_indices(n, stratify ? y : NULL, folds, shuffle, seed, fold_of);
+    CvJob job = { X, y, encoding_info, fold_of, calloc(folds, sizeof(CvFold)), configs, folds,
+                  malloc((n_jobs > 0 ? n_jobs : 1) * sizeof(double)),
+                  malloc((n_jobs > 0 ? n_jobs : 1) * sizeof(double)) };
+    parallel_run(folds, fold_task, &job);
+    parallel_run(n_jobs, cv_task, &job);
+
+    CvRow *rows = calloc(n_configs > 0 ? n_configs : 1, sizeof(CvRow));
+    for (int c = 0; c < n_configs; c++) {
+        row_name(&configs[c], rows[c].name);
+        rows[c].regression = is_regression(configs[c].model);
+        rows[c].order = c;
+        for (int f = 0; f < folds; f++) {
+            rows[c].metric1 += job.metric1[c * folds + f] / folds;
+            rows[c].metric2 += job.metric2[c * folds + f] / folds;
+        }
+    }
+    qsort(rows, n_configs, sizeof(CvRow), cmp_rows);
+
+    printf("\nLEADERBOARD (mean of %d folds)\n", folds);
+    printf("========================================\n");
+    for (int c = 0; c < n_configs; c++) {
+        if (rows[c].regression)
+            printf("%-52s | RMSE:%.4f | R²:%.4f\n", rows[c].name, rows[c].metric1, rows[c].metric2);
+        else
+            printf("%-52s | Acc:%.4f | F1:%.4f\n", rows[c].name, rows[c].metric1, rows[c].metric2);
+    }
+
+    FILE *fp = fopen(out_csv, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not create %s\n", out_csv);
+    } else {
+        fprintf(fp, "Model,Metric1_Name,Metric1_Value,Metric2_Name,Metric2_Value\n");
+        for (int c = 0; c < n_configs; c++) {
+            if (rows[c].regression)
+                fprintf(fp, "%s,RMSE,%.4f,R-Squared,%.4f\n", rows[c].name, rows[c].metric1, rows[c].metric2);
+            else
+                fprintf(fp, "%s,Accuracy,%.4f,F1-Score,%.4f\n", rows[c].name, rows[c].metric1, rows[c].metric2);
+        }
+        fclose(fp);
+        printf("\nLeaderboard saved to: %s\n", out_csv);
+    }
+
+    for (int f = 0; f < folds; f++) {
+        CvFold *fd = &job.folds[f];
+        features_free(&fd->Ftr);
+        features_free(&fd->Fte);
+        free(fd->ytr);
+        free(fd->yte);
+        free(fd->ytr_int);
+        free(fd->yte_int);
+        split_free(&fd->split);
+    }
+    free(job.folds);
+    free(job.metric1);
+    free(job.metric2);
+    free(fold_of);
+    free(configs);
+    free(rows);
+}
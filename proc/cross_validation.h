@@ -0,0 +1,38 @@
+// FILE: cross_validation.h
+
+#ifndef CROSS_VALIDATION_H
+#define CROSS_VALIDATION_H
+
+#include "data_types.h"
+
+#define CV_MAX_VALUES 16    // values per grid parameter
+#define CV_MAX_PARAMS 16    // grid parameters over all models
+
+typedef enum {
+    CV_LOGISTIC,
+    CV_NAIVE_BAYES,
+    CV_TREE,
+    CV_FOREST,
+    CV_GBM,
+    CV_KNN,
+    CV_LINEAR,
+    CV_N_MODELS
+} CvModel;
+
+// Values tried for every tunable parameter (see the table in
+// cross_validation.c) and which models take part
+typedef struct {
+    int n_values[CV_MAX_PARAMS];
+    double values[CV_MAX_PARAMS][CV_MAX_VALUES];
+    int use_model[CV_N_MODELS];
+} CvGrid;
+
+void cv_grid_default(CvGrid *grid);
+int cv_grid_parse(CvGrid *grid, const char *spec);
+int cv_grid_models(CvGrid *grid, const char *list);
+void cv_grid_usage(void);
+void cv_run(Frame *X, const double *y, const EncodingInfo *encoding_info,
+            const CvGrid *grid, int folds, int shuffle, int stratify,
+            unsigned long long seed, const char *out_csv);
+
+#endif
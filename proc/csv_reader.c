@@ -0,0 +1,171 @@
+// FILE: csv_reader.c
+
+#include <stdlib.h>
+#include <string.h>
+#include "csv_reader.h"
+
+// Pull the next block from the file, growing the buffer if it is full
+static void fill(CsvReader *r) {
+    if (r->eof) return;
+
+    // drop rows already handed out (their views die here)
+    if (!r->keep && r->pos > 0) {
+        memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+        r->len -= r->pos;
+        r->pos = 0;
+    }
+
+    if (r->cap - r->len < CSV_BLOCK / 2) {
+        size_t cap = r->cap * 2;
+        char *buf = realloc(r->buf, cap + 1);
+        if (!buf) {
+            fprintf(stderr, "Error: Out of memory reading CSV\n");
+            exit(1);
+        }
+        r->buf = buf;
+        r->cap = cap;
+    }
+
+    size_t got = fread(r->buf + r->len, 1, r->cap - r->len, r->fp);
+    r->len += got;
+    r->buf[r->len] = '\0';
+    if (got == 0) r->eof = 1;
+}
+
+// Find the newline ending the row that starts at pos (quotes may hide newlines)
+static int find_record_end(const CsvReader *r, size_t *end) {
+    const char *p = r->buf + r->pos;
+    const char *lim = r->buf + r->len;
+    int quoted = 0;
+
+    while (p < lim) {
+        if (!quoted) {
+            const char *nl = memchr(p, '\n', lim - p);
+            const char *q = memchr(p, '"', (nl ? nl : lim) - p);
+            if (!q) {
+                if (!nl) return 0;
+                *end = nl - r->buf;
+                return 1;
+            }
+            quoted = 1;
+            p = q + 1;
+        } else {
+            // an escaped "" simply closes and reopens the quote
+            const char *q = memchr(p, '"', lim - p);
+            if (!q) return 0;
+            quoted = 0;
+            p = q + 1;
+        }
+    }
+    return 0;
+}
+
+static void push_field(CsvReader *r, char *field) {
+    if (r->n_fields == r->cap_fields) {
+        r->cap_fields = r->cap_fields ? r->cap_fields * 2 : 64;
+        r->fields = realloc(r->fields, r->cap_fields * sizeof(char *));
+        if (!r->fields) {
+            fprintf(stderr, "Error: Out of memory reading CSV\n");
+            exit(1);
+        }
+    }
+    r->fields[r->n_fields++] = field;
+}
+
+// Split [s, e) on commas in place; *e is writable (newline or the spare NUL)
+static void split_record(CsvReader *r, char *s, char *e) {
+    r->n_fields = 0;
+    if (e > s && e[-1] == '\r') e--;
+
+    for (;;) {
+        while (s < e && *s == ' ') s++;
+        char *start = s;
+        char *w = s;
+
+        if (s < e && *s == '"') {
+            // quoted field: unescape "" while shifting the text left
+            s++;
+            while (s < e) {
+                if (*s == '"') {
+                    if (s + 1 < e && s[1] == '"') { *w++ = '"'; s += 2; continue; }
+                    s++;
+                    break;
+                }
+                *w++ = *s++;
+            }
+            while (s < e && *s != ',') *w++ = *s++;
+        } else {
+            while (s < e && *s != ',') s++;
+            w = s;
+        }
+
+        while (w > start && w[-1] == ' ') w--;
+        push_field(r, start);
+
+        if (s >= e) { *w = '\0'; break; }
+        s++;
+        *w = '\0';
+    }
+}
+
+int csv_open(CsvReader *r, const char *path, int keep) {
+    memset(r, 0, sizeof(*r));
+    r->fp = fopen(path, "rb");
+    if (!r->fp) return -1;
+    r->keep = keep;
+    r->cap = CSV_BLOCK;
+
+    // in keep mode size the buffer to the whole file so it is read in one go
+    if (keep && fseek(r->fp, 0, SEEK_END) == 0) {
+        long size = ftell(r->fp);
+        if (size > 0 && (size_t)size + CSV_BLOCK > r->cap) r->cap = (size_t)size + CSV_BLOCK;
+        rewind(r->fp);
+    }
+
+    r->buf = malloc(r->cap + 1);
+    if (!r->buf) {
+        fprintf(stderr, "Error: Out of memory reading %s\n", path);
+        exit(1);
+    }
+    r->buf[0] = '\0';
+
+    if (keep) {
+        while (!r->eof) fill(r);
+    } else {
+        fill(r);
+    }
+
+    // skip a UTF-8 byte order mark
+    if (r->len >= 3 && memcmp(r->buf, "\xEF\xBB\xBF", 3) == 0) r->pos = 3;
+    return 0;
+}
+
+// Returns the number of fields in the next non-blank row, or -1 at end of file
+int csv_next_row(CsvReader *r) {
+    for (;;) {
+        size_t end;
+        while (!find_record_end(r, &end)) {
+            if (r->eof) {
+                if (r->pos >= r->len) return -1;
+                end = r->len; // last row without a trailing newline
+                break;
+            }
+            fill(r);
+        }
+
+        char *s = r->buf + r->pos;
+        char *e = r->buf + end;
+        r->pos = end < r->len ? end + 1 : r->len;
+
+        if (e == s || (e - s == 1 && *s == '\r')) continue;
+        split_record(r, s, e);
+        return r->n_fields;
+    }
+}
+
+void csv_close(CsvReader *r) {
+    if (r->fp) fclose(r->fp);
+    free(r->buf);
+    free(r->fields);
+    memset(r, 0, sizeof(*r));
+}
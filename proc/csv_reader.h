@@ -0,0 +1,35 @@
+// FILE: csv_reader.h
+
+#ifndef CSV_READER_H
+#define CSV_READER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define CSV_BLOCK (1 << 20) // bytes pulled from the file per read
+
+// Streaming CSV tokenizer. Rows are split in place inside a block buffer:
+// every field is a NUL terminated view into that buffer (quotes removed,
+// surrounding spaces trimmed), so no per-cell copies are made.
+//
+// keep = 0: views stay valid until the next csv_next_row call.
+// keep = 1: the whole file is read up front and views stay valid until
+//           csv_close, so callers can hold on to every cell.
+typedef struct {
+    FILE *fp;
+    char *buf;
+    size_t cap;      // bytes allocated for buf (one extra for a NUL)
+    size_t len;      // bytes of file data in buf
+    size_t pos;      // start of the next unread row
+    int keep;
+    int eof;
+    char **fields;   // views for the current row
+    int n_fields;
+    int cap_fields;
+} CsvReader;
+
+int csv_open(CsvReader *r, const char *path, int keep);
+int csv_next_row(CsvReader *r);
+void csv_close(CsvReader *r);
+
+#endif
@@ -1,61 +1,275 @@
-
-// FILE: data_types.h
-
-
-#ifndef DATA_TYPES_H
-#define DATA_TYPES_H
-
-//for csv files rows and columns 
-#define MAX_ROWS 30000
-#define MAX_COLS 120  
-#define MAX_STR 128
-#define MAX_CATEGORIES 50
-
-typedef struct {
-    double data[MAX_ROWS][MAX_COLS];
-    char colnames[MAX_COLS][MAX_STR];
-    int rows;
-    int cols;
-} Frame;
-
-typedef struct {
-    double means[MAX_COLS];
-    double stds[MAX_COLS];
-    int numeric_cols[MAX_COLS];
-    int n_numeric;
-} Stats;
-
-typedef struct {
-    char name[MAX_STR];
-    int is_categorical;
-    int n_categories;
-    char categories[MAX_CATEGORIES][MAX_STR];
-} ColumnInfo;
-
-typedef struct {
-    ColumnInfo columns[MAX_COLS];
-    int n_cols;
-    char original_names[MAX_COLS][MAX_STR];
-    int original_to_encoded[MAX_COLS]; 
-    int n_encoded_cols;
-} EncodingInfo;
-
-typedef struct Node {
-    int leaf;
-    int label;
-    int feature;
-    int num_edges;
-    double *edges;
-    int num_children;
-    struct Node **children;
-} Node;
-
-typedef struct {
-    int num_classes;
-    int *classes;
-    double *priors;
-    double **means;
-    double **vars;
-} GNBModel;
-
-#endif
+
+// FILE: data_types.h
+
+
+#ifndef DATA_TYPES_H
+#define DATA_TYPES_H
+
+#include <stddef.h>
+
+//longest cell kept as a name (columns and rows are only limited by memory)
+#define MAX_STR 128
+
+// heap backed matrix, row-major: value (i, j) lives at data[i * cols + j].
+// A view (index != NULL) borrows another frame's data and colnames and has
+// row i at stored row index[i]; see frame_view. A frame loaded from the
+// dataset cache keeps data and colnames in a private file mapping instead.
+typedef struct {
+    double *data;
+    char (*colnames)[MAX_STR];
+    int rows;
+    int cols;
+    const int *index;
+    void *mapping;          // start of the mapping, NULL for heap frames
+    size_t mapping_size;
+} Frame;
+
+// Row indices of one train/test split (or one cross-validation fold),
+// ascending within each side
+typedef struct {
+    int *train;
+    int n_train;
+    int *test;
+    int n_test;
+} SplitIndex;
+
+typedef struct {
+    double *means;
+    double *stds;
+    int n_numeric;
+} Stats;
+
+// Column stats gathered over several frames (chunks of one stream)
+typedef struct {
+    int d;
+    long long n;        // rows so far
+    double *mean;
+    double *m2;         // summed squared deviations
+} StatsAcc;
+
+// interned strings: keys[code] is the string for each code, in first-seen order
+typedef struct {
+    char **keys;
+    unsigned int *hashes;
+    int count;
+    int cap;
+    int *slots;   // open addressing table of codes, -1 when empty
+    int n_slots;  // power of two
+} StrDict;
+
+typedef struct {
+    char name[MAX_STR];
+    int is_categorical;
+    StrDict categories; // category -> one hot column offset
+} ColumnInfo;
+
+// The per column arrays hold n_cols entries, see encoding_info_init
+typedef struct {
+    ColumnInfo *columns;
+    int n_cols;
+    char (*original_names)[MAX_STR];
+    int *original_to_encoded;
+    int n_encoded_cols;
+    int target_is_categorical;
+    StrDict target_classes; // class label -> y value
+} EncodingInfo;
+
+// Storage type of FeatureStore numeric values: float when built with
+// make PRECISION=float32, double otherwise. Kernels accumulate in double.
+#ifdef FEATURES_FLOAT32
+typedef float feat_t;
+#else
+typedef double feat_t;
+#endif
+
+// Mixed feature layout for one hot data: numeric columns stay dense, every
+// categorical column keeps one code per row (the encoded column of its hot
+// flag, or -1). Encoded one hot column j stands for (flag - shift[j]) / scale[j],
+// so kernels see exactly the values of the standardized dense Frame.
+typedef struct {
+    int rows;
+    int cols;          // width of the equivalent one hot Frame
+    int n_num;
+    int *num_cols;     // encoded column of each numeric feature
+    feat_t *num;       // rows x n_num, row-major
+    int n_cat;
+    int *cat_start;    // first encoded column of each categorical block
+    int *cat_size;
+    int *codes;        // rows x n_cat, row-major
+    double *shift;     // per encoded column, used by one hot columns
+    double *scale;
+} FeatureStore;
+
+typedef enum {
+    LOGREG_GD,      // full batch gradient descent
+    LOGREG_SGD,     // mini-batch SGD with momentum
+    LOGREG_ADAM,    // mini-batch Adam
+    LOGREG_LBFGS,
+    LOGREG_NEWTON   // IRLS: Newton steps on the weighted normal equations
+} LogRegOptimizer;
+
+typedef struct {
+    LogRegOptimizer optimizer;
+    double lr;          // step size (gd, sgd, adam)
+    int max_iter;       // epochs for gd, sgd and adam, iterations otherwise
+    double tol;         // stop once the loss moves by less than tol (relative)
+    double l2;          // penalty on the weights, not the intercept
+    int batch_size;     // sgd and adam
+    double momentum;    // sgd
+    unsigned long long seed; // mini-batch order
+} LogRegOptions;
+
+typedef struct {
+    int iterations;
+    double loss;        // mean log loss (plus penalty) at the returned weights
+    int converged;
+} FitReport;
+
+// Ball tree over the rows of a Frame. Points are copied in tree order so
+// every node owns the contiguous range [start, end) of points/index.
+typedef struct {
+    int n;
+    int d;
+    int use_euclidean;  // otherwise manhattan
+    double *points;     // n x d, reordered
+    int *index;         // source row of each reordered point
+    int n_nodes;
+    int cap_nodes;
+    int *start;
+    int *end;
+    int *left;          // child nodes, -1 for a leaf
+    int *right;
+    double *center;     // n_nodes x d, centroid of the node's points
+    double *radius;     // largest distance from the center to a point
+} BallTree;
+
+// Every feature binned once for tree training: codes[i * d + j] is the bin
+// of row i in column j. Column j has n_thresholds[j] (< n_bins) ascending
+// cut points stored at thresholds[j * (n_bins - 1)]; bin b holds the values
+// in (thresholds[b - 1], thresholds[b]].
+typedef struct {
+    int n;
+    int d;
+    int n_bins;
+    int *n_thresholds;
+    double *thresholds;
+    unsigned char *codes;
+} TreeBins;
+
+// Binary split: rows with x[feature] <= threshold go left
+typedef struct Node {
+    int leaf;
+    int label;
+    int feature;
+    double threshold;
+    struct Node *left;
+    struct Node *right;
+} Node;
+
+// A trained tree compiled to one array per field in breadth first order.
+// The children of node i are child[i] (x[feature[i]] <= threshold[i]) and
+// child[i] + 1. A leaf points back at itself with an infinite threshold, so
+// every row can take exactly depth steps without testing for leaves.
+typedef struct {
+    int n_nodes;
+    int depth;
+    int *feature;
+    double *threshold;
+    int *child;
+    int *label;
+} FlatTree;
+
+typedef struct {
+    int n_trees;
+    int max_depth;
+    int min_samples_split;
+    int n_bins;
+    int max_features;   // candidate features per split, 0 = sqrt(d)
+    unsigned long long seed; // bootstrap samples and feature draws
+} ForestOptions;
+
+// Bagged trees voting by majority. Tree leaves hold class indices into
+// labels; ties go to the lower class index.
+typedef struct {
+    int n_trees;
+    int n_classes;
+    int *labels;
+    FlatTree *trees;
+    double oob_accuracy; // vote of the trees that did not sample each row
+} RandomForest;
+
+typedef enum {
+    GBM_LOGISTIC,   // binary classifier on 0/1 targets, raw scores are logits
+    GBM_SQUARED     // regressor
+} GbmLoss;
+
+typedef struct {
+    GbmLoss loss;
+    int max_iter;       // boosting rounds
+    double learning_rate; // shrinkage on every leaf value
+    int max_depth;
+    int min_samples_leaf;
+    double l2;          // penalty on the leaf values
+    int n_bins;
+    double validation_fraction; // rows held out for early stopping, 0 = off
+    int n_iter_no_change; // rounds without a validation gain before stopping
+    double tol;         // smallest validation loss drop that counts as a gain
+    unsigned long long seed; // validation rows
+} GbmOptions;
+
+// Boosted regression trees sharing one node pool. Tree t starts at node
+// root[t] and is laid out like a FlatTree (breadth first, children adjacent,
+// leaves pointing at themselves) with a leaf value in place of a label; the
+// raw score of a row is base_score plus its leaf value in every tree.
+typedef struct {
+    GbmLoss loss;
+    double base_score;
+    int n_trees;
+    int cap_trees;
+    int *root;
+    int *depth;
+    int n_nodes;
+    int cap_nodes;
+    int *feature;
+    double *threshold;
+    int *child;
+    double *value;
+} GbmModel;
+
+// Gaussian naive Bayes. Fitting also tables, per class c and feature j,
+// lin[c * num_features + j] = mean / var and quad[...] = -0.5 / var, and in
+// log_const[c] the log prior plus every -0.5 log(2 pi var) - 0.5 mean^2 / var,
+// so a row scores log_const[c] + sum_j x_j (lin + x_j quad) with no logs.
+typedef struct {
+    int num_classes;
+    int num_features;
+    int *classes;
+    long long *counts;  // rows seen per class, for partial fits
+    double *priors;
+    double **means;
+    double **vars;
+    double *log_const;
+    double *lin;
+    double *quad;
+} GNBModel;
+
+// Everything needed to score new rows without retraining: the encoding and
+// stats fitted on the training split plus every trained model. KNN keeps no
+// model beyond its training rows, so it is not part of the bundle.
+typedef struct {
+    char target[MAX_STR];
+    EncodingInfo encoding;
+    Stats stats;
+    int n_features;     // encoded columns
+    double *w_log;
+    double b_log;
+    GNBModel nb;
+    FlatTree tree;
+    RandomForest forest;
+    GbmModel gbm;
+    double *w_lin;
+    double b_lin;
+    GbmModel gbr;
+} ModelBundle;
+
+#endif
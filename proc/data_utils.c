@@ -1,238 +1,674 @@
-// FILE: data_utils.c
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include <math.h>
-#include "data_utils.h"
-#include "preprocessing.h"
-
-
-
-void load_and_encode_csv(const char *path, const char *target_col,
-                        Frame *X, double *y, EncodingInfo *encoding_info) {
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        fprintf(stderr, "Error: Cannot open file %s\n", path);
-        exit(1);
-    }
-    
-    char line[8192];
-    if (!fgets(line, sizeof(line), f)) {
-        fprintf(stderr, "Error: Empty file\n");
-        fclose(f);
-        exit(1);
-    }
-
-    //headers parseing
-    line[strcspn(line, "\r\n")] = 0;
-    char headers[MAX_COLS][MAX_STR];
-    int col_count = 0;
-    
-    char *line_copy = strdup(line);
-    char *tok = strtok(line_copy, ",");
-    while (tok && col_count < MAX_COLS) {
-        while (*tok == ' ') tok++;
-        char *end = tok + strlen(tok) - 1;
-        while (end > tok && *end == ' ') end--;
-        *(end + 1) = '\0';
-        
-        strncpy(headers[col_count], tok, MAX_STR - 1);
-        headers[col_count][MAX_STR - 1] = '\0';
-        col_count++;
-        tok = strtok(NULL, ",");
-    }
-    free(line_copy);
-
-    if (col_count == 0) {
-        fprintf(stderr, "Error: No columns found\n");
-        fclose(f);
-        exit(1);
-    }
-
-    //findign target column
-    int target_index = -1;
-    for (int i = 0; i < col_count; i++) {
-        if (strcmp(headers[i], target_col) == 0) {
-            target_index = i;
-            break;
-        }
-    }
-    
-    if (target_index < 0) {
-        fprintf(stderr, "Error: Target column '%s' not found\n", target_col);
-        fprintf(stderr, "Available columns: ");
-        for (int i = 0; i < col_count; i++) {
-            fprintf(stderr, "'%s'%s", headers[i], i < col_count-1 ? ", " : "\n");
-        }
-        fclose(f);
-        exit(1);
-    }
-
-    //read all data as strings
-    char raw_data[MAX_ROWS][MAX_COLS][MAX_STR];
-    char raw_target[MAX_ROWS][MAX_STR];
-    int row = 0;
-    
-    while (fgets(line, sizeof(line), f) && row < MAX_ROWS) {
-        if (line[0] == '\n' || line[0] == '\r') continue;
-        line[strcspn(line, "\r\n")] = 0;
-        
-        char *row_copy = strdup(line);
-        int c = 0;
-        tok = strtok(row_copy, ",");
-        
-        while (tok && c < col_count) {
-            while (*tok == ' ') tok++;
-            char *end = tok + strlen(tok) - 1;
-            while (end > tok && *end == ' ') end--;
-            *(end + 1) = '\0';
-            
-            if (c == target_index) {
-                strncpy(raw_target[row], tok, MAX_STR - 1);
-                raw_target[row][MAX_STR - 1] = '\0';
-            } else {
-                int feature_idx = c < target_index ? c : c - 1;
-                strncpy(raw_data[row][feature_idx], tok, MAX_STR - 1);
-                raw_data[row][feature_idx][MAX_STR - 1] = '\0';
-            }
-            tok = strtok(NULL, ",");
-            c++;
-        }
-        free(row_copy);
-        
-        if (c == col_count) row++;
-    }
-    fclose(f);
-    
-    if (row == 0) {
-        fprintf(stderr, "Error: No data rows found\n");
-        exit(1);
-    }
-    
-    printf("Loaded %d rows from CSV\n", row);
-    
-    // Prepare feature headers
-    char feature_headers[MAX_COLS][MAX_STR];
-    int f_idx = 0;
-    for (int i = 0; i < col_count; i++) {
-        if (i != target_index) {
-            strncpy(feature_headers[f_idx], headers[i], MAX_STR - 1);
-            feature_headers[f_idx][MAX_STR - 1] = '\0';
-            f_idx++;
-        }
-    }
-    int n_feature_cols = f_idx;
-    
-    // detect column types and one hot encode
-    printf("Detecting column types and encoding...\n");
-    detect_column_types(raw_data, row, feature_headers, n_feature_cols, encoding_info);
-    one_hot_encode_data(raw_data, row, encoding_info, X);
-    
-    // process the target column
-    printf("Processing target column '%s'...\n", target_col);
-    
-    // check if target is numeric or categorical
-    int is_numeric_target = 1;
-    for (int i = 0; i < row && is_numeric_target; i++) {
-        char *endptr;
-        strtod(raw_target[i], &endptr);
-        if (*endptr != '\0' && *endptr != ' ') {
-            is_numeric_target = 0; 
-        }
-    }
-    
-    if (is_numeric_target) {
-        //numeric target for regression
-        for (int i = 0; i < row; i++) {
-            y[i] = atof(raw_target[i]);
-        }
-        printf("Target is numeric (regression)\n");
-    } else {
-        // categorical target for classification ands map unique strings to integers
-        char unique_vals[100][MAX_STR];
-        int n_unique = 0;
-        
-        for (int i = 0; i < row; i++) {
-            int found = 0;
-            for (int u = 0; u < n_unique; u++) {
-                if (strcmp(raw_target[i], unique_vals[u]) == 0) {
-                    y[i] = (double)u;
-                    found = 1;
-                    break;
-                }
-            }
-            if (!found) {
-                strcpy(unique_vals[n_unique], raw_target[i]);
-                y[i] = (double)n_unique;
-                n_unique++;
-            }
-        }
-        printf("Target is categorical with %d unique classes\n", n_unique);
-    }
-    
-    printf("Final dataset: %d rows, %d features\n", X->rows, X->cols);
-}
-
-
-void zscore(Frame *X, Stats *S) {
-    S->n_numeric = X->cols;
-    for (int c = 0; c < X->cols; c++) {
-        double sum = 0;
-        for (int r = 0; r < X->rows; r++) sum += X->data[r][c];
-        S->means[c] = sum / X->rows;
-
-        double sq = 0;
-        for (int r = 0; r < X->rows; r++) {
-            double d = X->data[r][c] - S->means[c];
-            sq += d * d;
-        }
-        S->stds[c] = sqrt(sq / X->rows);
-        if (S->stds[c] < 1e-10) S->stds[c] = 1.0;
-    }
-
-    for (int r = 0; r < X->rows; r++) {
-        for (int c = 0; c < X->cols; c++) {
-            X->data[r][c] = (X->data[r][c] - S->means[c]) / S->stds[c];
-        }
-    }
-}
-
-void apply_stats(Frame *X, Stats *S) {
-    for (int r = 0; r < X->rows; r++) {
-        for (int c = 0; c < X->cols; c++) {
-            X->data[r][c] = (X->data[r][c] - S->means[c]) / S->stds[c];
-        }
-    }
-}
-
-void train_test_split(Frame *X, double *y, Frame *Xtr, Frame *Xte,
-                      double *ytr, double *yte, double test_size) {
-    int n = X->rows;
-    int split = (int)(n * (1 - test_size));
-
-    Xtr->cols = X->cols;
-    Xte->cols = X->cols;
-
-    for (int c = 0; c < X->cols; c++) {
-        strcpy(Xtr->colnames[c], X->colnames[c]);
-        strcpy(Xte->colnames[c], X->colnames[c]);
-    }
-
-    for (int i = 0; i < split; i++) {
-        for (int c = 0; c < X->cols; c++)
-            Xtr->data[i][c] = X->data[i][c];
-        ytr[i] = y[i];
-    }
-    Xtr->rows = split;
-
-    int j = 0;
-    for (int i = split; i < n; i++) {
-        for (int c = 0; c < X->cols; c++)
-            Xte->data[j][c] = X->data[i][c];
-        yte[j] = y[i];
-        j++;
-    }
-    Xte->rows = j;
-}
\ No newline at end of file
+// FILE: data_utils.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "data_utils.h"
+#include "preprocessing.h"
+#include "frame.h"
+#include "csv_reader.h"
+#include "str_dict.h"
+#include "parallel.h"
+#include "rng.h"
+#include "dataset_cache.h"
+
+
+
+// Read the header row of an open CSV and find target_col there; returns the
+// column count. With headers_out set, *headers_out gets a heap copy of every
+// name (the caller frees it). Exits on an empty file, no columns or a
+// missing target, like the loaders it serves.
+int read_csv_header(CsvReader *csv, const char *target_col,
+                    char (**headers_out)[MAX_STR], int *target_index_out) {
+    if (csv_next_row(csv) < 0) {
+        fprintf(stderr, "Error: Empty file\n");
+        csv_close(csv);
+        exit(1);
+    }
+
+    //headers parseing
+    int col_count = csv->n_fields;
+    char (*headers)[MAX_STR] = calloc(col_count > 0 ? col_count : 1, MAX_STR);
+    if (!headers) {
+        fprintf(stderr, "Error: Out of memory for %d columns\n", col_count);
+        exit(1);
+    }
+    for (int i = 0; i < col_count; i++)
+        strncpy(headers[i], csv->fields[i], MAX_STR - 1);
+
+    if (col_count == 0) {
+        fprintf(stderr, "Error: No columns found\n");
+        csv_close(csv);
+        exit(1);
+    }
+
+    //findign target column
+    int target_index = -1;
+    for (int i = 0; i < col_count; i++) {
+        if (strcmp(headers[i], target_col) == 0) {
+            target_index = i;
+            break;
+        }
+    }
+    
+    if (target_index < 0) {
+        fprintf(stderr, "Error: Target column '%s' not found\n", target_col);
+        fprintf(stderr, "Available columns: ");
+        for (int i = 0; i < col_count; i++) {
+            fprintf(stderr, "'%s'%s", headers[i], i < col_count-1 ? ", " : "\n");
+        }
+        csv_close(csv);
+        exit(1);
+    }
+    *target_index_out = target_index;
+    if (headers_out) *headers_out = headers;
+    else free(headers);
+    return col_count;
+}
+
+void load_and_encode_csv(const char *path, const char *target_col,
+                        Frame *X, double **y_out, EncodingInfo *encoding_info) {
+    if (dataset_cache_load(path, target_col, X, y_out, encoding_info) == 0) return;
+
+    CsvReader csv;
+    if (csv_open(&csv, path, 1) != 0) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        exit(1);
+    }
+    
+    char (*headers)[MAX_STR];
+    int target_index;
+    int col_count = read_csv_header(&csv, target_col, &headers, &target_index);
+
+    //collect cell views into the file buffer, no copies are made
+    int n_feat = col_count - 1;
+    int cap_rows = 1024;
+    char **raw_data = malloc((size_t)cap_rows * n_feat * sizeof(char *));
+    char **raw_target = malloc((size_t)cap_rows * sizeof(char *));
+    if (!raw_data || !raw_target) {
+        fprintf(stderr, "Error: Out of memory reading %s\n", path);
+        exit(1);
+    }
+    int row = 0;
+    
+    int n_fields;
+    while ((n_fields = csv_next_row(&csv)) >= 0) {
+        if (n_fields < col_count) continue; // short row
+
+        if (row == cap_rows) {
+            cap_rows *= 2;
+            raw_data = realloc(raw_data, (size_t)cap_rows * n_feat * sizeof(char *));
+            raw_target = realloc(raw_target, (size_t)cap_rows * sizeof(char *));
+            if (!raw_data || !raw_target) {
+                fprintf(stderr, "Error: Out of memory reading %s\n", path);
+                exit(1);
+            }
+        }
+
+        char **cells = raw_data + (size_t)row * n_feat;
+        memcpy(cells, csv.fields, target_index * sizeof(char *));
+        memcpy(cells + target_index, csv.fields + target_index + 1,
+               (n_feat - target_index) * sizeof(char *));
+        raw_target[row] = csv.fields[target_index];
+        row++;
+    }
+    
+    if (row == 0) {
+        fprintf(stderr, "Error: No data rows found\n");
+        csv_close(&csv);
+        exit(1);
+    }
+    
+    printf("Loaded %d rows from CSV\n", row);
+    
+    // Prepare feature headers: drop the target's name
+    memmove(headers + target_index, headers + target_index + 1,
+            (size_t)(col_count - 1 - target_index) * MAX_STR);
+    int n_feature_cols = col_count - 1;
+    
+    // detect column types and one hot encode
+    printf("Detecting column types and encoding...\n");
+    int *codes = malloc((size_t)row * n_feature_cols * sizeof(int));
+    if (!codes) {
+        fprintf(stderr, "Error: Out of memory for category codes\n");
+        exit(1);
+    }
+    detect_column_types(raw_data, row, headers, n_feature_cols, encoding_info, codes);
+    free(headers);
+    one_hot_encode_data(raw_data, codes, row, encoding_info, X);
+    free(codes);
+    
+    // process the target column
+    printf("Processing target column '%s'...\n", target_col);
+    double *y = malloc((size_t)row * sizeof(double));
+    if (!y) {
+        fprintf(stderr, "Error: Out of memory for target column\n");
+        exit(1);
+    }
+    
+    // check if target is numeric or categorical
+    dict_init(&encoding_info->target_classes);
+    int is_numeric_target = 1;
+    for (int i = 0; i < row && is_numeric_target; i++) {
+        char *endptr;
+        strtod(raw_target[i], &endptr);
+        if (*endptr != '\0' && *endptr != ' ') {
+            is_numeric_target = 0; 
+        }
+    }
+    
+    if (is_numeric_target) {
+        //numeric target for regression
+        for (int i = 0; i < row; i++) {
+            y[i] = atof(raw_target[i]);
+        }
+        encoding_info->target_is_categorical = 0;
+        printf("Target is numeric (regression)\n");
+    } else {
+        // categorical target for classification ands map unique strings to integers
+        for (int i = 0; i < row; i++) {
+            y[i] = (double)dict_intern(&encoding_info->target_classes, raw_target[i]);
+        }
+        int n_unique = encoding_info->target_classes.count;
+        encoding_info->target_is_categorical = 1;
+        printf("Target is categorical with %d unique classes\n", n_unique);
+    }
+    
+    free(raw_data);
+    free(raw_target);
+    csv_close(&csv);
+
+    *y_out = y;
+    printf("Final dataset: %d rows, %d features\n", X->rows, X->cols);
+    dataset_cache_save(path, target_col, X, y, encoding_info);
+}
+
+// Fit the encoding load_and_encode_csv would build for path without keeping
+// the rows: one pass over the first rows settles the column types (the same
+// first 100 non-empty cells per column), a full pass interns the categories
+// and checks the target, and a target that turns out categorical only after
+// numeric looking rows takes one more pass so its classes keep the order of
+// first appearance. Returns the number of (complete) data rows.
+int encoding_scan(const char *path, const char *target_col, EncodingInfo *encoding_info) {
+    CsvReader csv;
+    if (csv_open(&csv, path, 0) != 0) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        exit(1);
+    }
+    char (*headers)[MAX_STR];
+    int target_index;
+    int col_count = read_csv_header(&csv, target_col, &headers, &target_index);
+    int n_cols = col_count - 1;
+
+    int *field_of = calloc(3 * (size_t)(n_cols > 0 ? n_cols : 1), sizeof(int));
+    if (!field_of) {
+        fprintf(stderr, "Error: Out of memory for %d columns\n", n_cols);
+        exit(1);
+    }
+    int *checked = field_of + n_cols, *numeric = checked + n_cols;
+    encoding_info_init(encoding_info, n_cols);
+    for (int i = 0, c = 0; i < col_count; i++) {
+        if (i == target_index) continue;
+        ColumnInfo *col = &encoding_info->columns[c];
+        strncpy(col->name, headers[i], MAX_STR - 1);
+        col->name[MAX_STR - 1] = '\0';
+        strncpy(encoding_info->original_names[c], headers[i], MAX_STR - 1);
+        dict_init(&col->categories);
+        field_of[c++] = i;
+    }
+    free(headers);
+    dict_init(&encoding_info->target_classes);
+
+    //column types from the first rows, stopping once every column is settled
+    int undecided = n_cols, n_fields;
+    while (undecided > 0 && (n_fields = csv_next_row(&csv)) >= 0) {
+        if (n_fields < col_count) continue; // short row
+        for (int c = 0; c < n_cols; c++) {
+            const char *cell = csv.fields[field_of[c]];
+            if (checked[c] == 100 || cell[0] == '\0') continue;
+            numeric[c] += is_numeric_string(cell);
+            if (++checked[c] == 100) undecided--;
+        }
+    }
+    for (int c = 0; c < n_cols; c++)
+        encoding_info->columns[c].is_categorical =
+            !(checked[c] > 0 && (double)numeric[c] / checked[c] > 0.8);
+
+    //categories and the target over every row
+    csv_close(&csv);
+    csv_open(&csv, path, 0);
+    csv_next_row(&csv);
+    int rows = 0, first_text = -1;
+    while ((n_fields = csv_next_row(&csv)) >= 0) {
+        if (n_fields < col_count) continue;
+        for (int c = 0; c < n_cols; c++) {
+            const char *cell = csv.fields[field_of[c]];
+            if (encoding_info->columns[c].is_categorical && cell[0] != '\0')
+                dict_intern(&encoding_info->columns[c].categories, cell);
+        }
+        const char *cell = csv.fields[target_index];
+        if (first_text < 0) {
+            char *endptr;
+            strtod(cell, &endptr);
+            if (*endptr != '\0' && *endptr != ' ') first_text = rows;
+        }
+        if (first_text >= 0) dict_intern(&encoding_info->target_classes, cell);
+        rows++;
+    }
+    csv_close(&csv);
+
+    if (rows == 0) {
+        fprintf(stderr, "Error: No data rows found\n");
+        exit(1);
+    }
+    if (first_text > 0) {
+        dict_free(&encoding_info->target_classes);
+        dict_init(&encoding_info->target_classes);
+        csv_open(&csv, path, 0);
+        csv_next_row(&csv);
+        while ((n_fields = csv_next_row(&csv)) >= 0)
+            if (n_fields >= col_count)
+                dict_intern(&encoding_info->target_classes, csv.fields[target_index]);
+        csv_close(&csv);
+    }
+    free(field_of);
+
+    encoding_layout(encoding_info);
+    encoding_info->target_is_categorical = first_text >= 0;
+    printf("Scanned %d rows from CSV\n", rows);
+    printf("one hot encoding: %d original columns -> %d encoded columns\n",
+           encoding_info->n_cols, encoding_info->n_encoded_cols);
+    if (encoding_info->target_is_categorical)
+        printf("Target is categorical with %d unique classes\n",
+               encoding_info->target_classes.count);
+    else
+        printf("Target is numeric (regression)\n");
+    return rows;
+}
+
+// Encode a new CSV with a fitted EncodingInfo: feature columns are found by
+// header name (extra columns are ignored) and a category or target class
+// never seen in training, like an empty cell, leaves its one hot block zero
+// (class -1). *y_out is NULL when the file has no target_col.
+void load_csv_with_encoding(const char *path, const char *target_col,
+                            const EncodingInfo *encoding_info, Frame *X, double **y_out) {
+    CsvReader csv;
+    if (csv_open(&csv, path, 0) != 0) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        exit(1);
+    }
+    if (csv_next_row(&csv) < 0) {
+        fprintf(stderr, "Error: Empty file\n");
+        csv_close(&csv);
+        exit(1);
+    }
+
+    int n_cols = encoding_info->n_cols;
+    int *field_of = malloc((size_t)(n_cols > 0 ? n_cols : 1) * sizeof(int));
+    const char **cells = malloc((size_t)(n_cols > 0 ? n_cols : 1) * sizeof(char *));
+    if (!field_of || !cells) {
+        fprintf(stderr, "Error: Out of memory reading %s\n", path);
+        exit(1);
+    }
+    int target_index = -1, n_needed = 0;
+    for (int c = 0; c < n_cols; c++) {
+        field_of[c] = -1;
+        for (int i = 0; i < csv.n_fields; i++)
+            if (strcmp(csv.fields[i], encoding_info->columns[c].name) == 0) field_of[c] = i;
+        if (field_of[c] < 0) {
+            fprintf(stderr, "Error: Column '%s' not found in %s\n",
+                    encoding_info->columns[c].name, path);
+            csv_close(&csv);
+            exit(1);
+        }
+        if (field_of[c] + 1 > n_needed) n_needed = field_of[c] + 1;
+    }
+    for (int i = 0; i < csv.n_fields; i++)
+        if (strcmp(csv.fields[i], target_col) == 0) target_index = i;
+    if (target_index + 1 > n_needed) n_needed = target_index + 1;
+
+    int d = encoding_info->n_encoded_cols;
+    int cap_rows = 1024, row = 0;
+    double *data = malloc((size_t)cap_rows * (d > 0 ? d : 1) * sizeof(double));
+    double *y = malloc((size_t)cap_rows * sizeof(double));
+    if (!data || !y) {
+        fprintf(stderr, "Error: Out of memory reading %s\n", path);
+        exit(1);
+    }
+
+    int n_fields;
+    while ((n_fields = csv_next_row(&csv)) >= 0) {
+        if (n_fields < n_needed) continue; // short row
+
+        if (row == cap_rows) {
+            cap_rows *= 2;
+            data = realloc(data, (size_t)cap_rows * (d > 0 ? d : 1) * sizeof(double));
+            y = realloc(y, (size_t)cap_rows * sizeof(double));
+            if (!data || !y) {
+                fprintf(stderr, "Error: Out of memory reading %s\n", path);
+                exit(1);
+            }
+        }
+
+        for (int c = 0; c < n_cols; c++) cells[c] = csv.fields[field_of[c]];
+        double *x = data + (size_t)row * d;
+        memset(x, 0, d * sizeof(double));
+        encode_cells(encoding_info, cells, x);
+        if (target_index >= 0) {
+            const char *cell = csv.fields[target_index];
+            y[row] = encoding_info->target_is_categorical
+                     ? (double)dict_find(&encoding_info->target_classes, cell) : atof(cell);
+        }
+        row++;
+    }
+    csv_close(&csv);
+    free(field_of);
+    free(cells);
+
+    X->data = data;
+    X->rows = row;
+    X->cols = d;
+    X->index = NULL;
+    X->mapping = NULL;
+    X->mapping_size = 0;
+    X->colnames = calloc(d > 0 ? d : 1, sizeof(*X->colnames));
+    if (!X->colnames) {
+        fprintf(stderr, "Error: Out of memory reading %s\n", path);
+        exit(1);
+    }
+    encoding_colnames(encoding_info, X->colnames);
+
+    if (target_index < 0) {
+        free(y);
+        y = NULL;
+    }
+    *y_out = y;
+    printf("Loaded %d rows from %s\n", row, path);
+}
+
+
+// Each task runs Welford over its rows for every column at once: rows are
+// read in storage order and the column loop is contiguous, so it vectorizes
+typedef struct {
+    const Frame *X;
+    double *mean;   // tasks x cols
+    double *m2;
+} StatsJob;
+
+static void stats_task(void *ctx, int task, int begin, int end) {
+    StatsJob *job = ctx;
+    int d = job->X->cols;
+    double *mean = job->mean + (size_t)task * d;
+    double *m2 = job->m2 + (size_t)task * d;
+    for (int r = begin; r < end; r++) {
+        const double *x = frame_row(job->X, r);
+        double inv_n = 1.0 / (double)(r - begin + 1);
+        for (int c = 0; c < d; c++) {
+            double delta = x[c] - mean[c];
+            mean[c] += delta * inv_n;
+            m2[c] += delta * (x[c] - mean[c]);
+        }
+    }
+}
+
+// Fold X into the running column means and squared deviations of A in one
+// parallel pass; the task results are merged pairwise (Chan) in task order,
+// so chunks added one after another give the stats of all their rows
+void stats_acc_add(StatsAcc *A, const Frame *X) {
+    int n = X->rows, d = A->d;
+    int tasks = parallel_tasks(n);
+    StatsJob job = { X, calloc((size_t)tasks * d + 1, sizeof(double)),
+                     calloc((size_t)tasks * d + 1, sizeof(double)) };
+    if (!job.mean || !job.m2) {
+        fprintf(stderr, "Error: Out of memory computing column stats\n");
+        exit(1);
+    }
+    parallel_for(n, stats_task, &job);
+
+    for (int t = 0; t < tasks; t++) {
+        long long nb = (int)((long long)n * (t + 1) / tasks) - (int)((long long)n * t / tasks);
+        if (nb == 0) continue;
+        long long na = A->n;
+        double nab = (double)(na + nb);
+        const double *mb = job.mean + (size_t)t * d, *sb = job.m2 + (size_t)t * d;
+        for (int c = 0; c < d; c++) {
+            double delta = mb[c] - A->mean[c];
+            A->mean[c] += delta * nb / nab;
+            A->m2[c] += sb[c] + delta * delta * ((double)na * nb / nab);
+        }
+        A->n = na + nb;
+    }
+
+    free(job.mean);
+    free(job.m2);
+}
+
+void stats_acc_init(StatsAcc *A, int d) {
+    A->d = d;
+    A->n = 0;
+    A->mean = calloc(d > 0 ? d : 1, sizeof(double));
+    A->m2 = calloc(d > 0 ? d : 1, sizeof(double));
+    if (!A->mean || !A->m2) {
+        fprintf(stderr, "Error: Out of memory computing column stats\n");
+        exit(1);
+    }
+}
+
+// Population stds from the accumulated rows; A's buffers move into S
+void stats_acc_finish(StatsAcc *A, Stats *S) {
+    S->n_numeric = A->d;
+    S->means = A->mean;
+    S->stds = A->m2;
+    for (int c = 0; c < A->d; c++) {
+        S->stds[c] = A->n > 0 ? sqrt(S->stds[c] / A->n) : 0.0;
+        if (S->stds[c] < 1e-10) S->stds[c] = 1.0;
+    }
+    A->mean = A->m2 = NULL;
+}
+
+// Column means and population stds of X; X is not modified
+void stats_fit(const Frame *X, Stats *S) {
+    StatsAcc A;
+    stats_acc_init(&A, X->cols);
+    stats_acc_add(&A, X);
+    stats_acc_finish(&A, S);
+}
+
+void zscore(Frame *X, Stats *S) {
+    stats_fit(X, S);
+    apply_stats(X, S);
+}
+
+typedef struct {
+    Frame *X;
+    const Stats *S;
+} ApplyJob;
+
+static void apply_task(void *ctx, int task, int begin, int end) {
+    ApplyJob *job = ctx;
+    const double *mean = job->S->means, *std = job->S->stds;
+    int d = job->X->cols;
+    (void)task;
+    for (int r = begin; r < end; r++) {
+        double *x = frame_row(job->X, r);
+        for (int c = 0; c < d; c++) x[c] = (x[c] - mean[c]) / std[c];
+    }
+}
+
+// Standardize X in place with S, rows split across the pool
+void apply_stats(Frame *X, Stats *S) {
+    ApplyJob job = { X, S };
+    parallel_for(X->rows, apply_task, &job);
+}
+
+void stats_free(Stats *S) {
+    free(S->means);
+    free(S->stds);
+    S->means = S->stds = NULL;
+    S->n_numeric = 0;
+}
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// A value and where it came from, sorted by value and then by position
+typedef struct {
+    double v;
+    int pos;
+} ValuePos;
+
+static int cmp_value_pos(const void *a, const void *b) {
+    const ValuePos *x = a, *y = b;
+    if (x->v != y->v) return x->v < y->v ? -1 : 1;
+    return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+// Rows 0..n-1, shuffled when asked, then (when y is given) grouped by class
+// in order of first appearance, keeping the shuffled order inside a class.
+// class_start[c] is where class c begins; returns the number of classes.
+static int ordered_rows(int n, const double *y, int shuffle, unsigned long long seed,
+                        int *order, int **class_start_out) {
+    for (int i = 0; i < n; i++) order[i] = i;
+    if (shuffle) {
+        Rng r;
+        rng_seed(&r, seed);
+        rng_shuffle(&r, order, n);
+    }
+
+    int k = 1;
+    int *start = malloc(2 * sizeof(int));
+    if (y) {
+        // one sort by label: each run of equal labels is a class and its
+        // first entry is where the class first appears
+        ValuePos *by_label = malloc((n > 0 ? n : 1) * sizeof(ValuePos));
+        ValuePos *firsts = malloc((n > 0 ? n : 1) * sizeof(ValuePos));
+        int *cls = malloc((n > 0 ? n : 1) * sizeof(int));
+        for (int i = 0; i < n; i++) by_label[i] = (ValuePos){ y[order[i]], i };
+        qsort(by_label, n, sizeof(ValuePos), cmp_value_pos);
+        k = 0;
+        for (int i = 0; i < n; i++) {
+            if (i == 0 || by_label[i].v != by_label[i - 1].v) {
+                firsts[k] = (ValuePos){ (double)by_label[i].pos, k };
+                k++;
+            }
+            cls[by_label[i].pos] = k - 1;
+        }
+        // renumber the classes by first appearance
+        qsort(firsts, k, sizeof(ValuePos), cmp_value_pos);
+        int *rank = malloc((k > 0 ? k : 1) * sizeof(int));
+        for (int c = 0; c < k; c++) rank[firsts[c].pos] = c;
+        for (int i = 0; i < n; i++) cls[i] = rank[cls[i]];
+        free(rank);
+        free(firsts);
+        free(by_label);
+        // counting sort by class keeps the order within each class
+        start = realloc(start, (k + 1) * sizeof(int));
+        int *grouped = malloc((n > 0 ? n : 1) * sizeof(int));
+        for (int c = 0; c <= k; c++) start[c] = 0;
+        for (int i = 0; i < n; i++) start[cls[i] + 1]++;
+        for (int c = 0; c < k; c++) start[c + 1] += start[c];
+        int *fill = malloc((k > 0 ? k : 1) * sizeof(int));
+        for (int c = 0; c < k; c++) fill[c] = start[c];
+        for (int i = 0; i < n; i++) grouped[fill[cls[i]]++] = order[i];
+        memcpy(order, grouped, n * sizeof(int));
+        free(fill);
+        free(grouped);
+        free(cls);
+    } else {
+        start[0] = 0;
+        start[1] = n;
+    }
+    *class_start_out = start;
+    return k;
+}
+
+// Train/test row indices: the last test_size share of rows, in file order
+// or after an optional seeded shuffle, goes to test. Passing y
+// stratifies: every class gives the test side its share of rows (largest
+// remainders settle the rounding), so class ratios match on both sides.
+void split_indices(int n, const double *y, double test_size, int shuffle,
+                   unsigned long long seed, SplitIndex *out) {
+    int n_train = (int)(n * (1 - test_size));
+    int *order = malloc((n > 0 ? n : 1) * sizeof(int));
+    int *start;
+    int k = ordered_rows(n, y, shuffle, seed, order, &start);
+
+    // test rows per class: floor of the share, then one more for the
+    // classes with the largest remainders (earlier class on ties) until the
+    // total is right
+    int *take = calloc(k, sizeof(int));
+    ValuePos *rem = malloc((k > 0 ? k : 1) * sizeof(ValuePos));
+    int n_test = n - n_train, given = 0;
+    for (int c = 0; c < k; c++) {
+        double want = (double)(start[c + 1] - start[c]) * n_test / (n > 0 ? n : 1);
+        take[c] = (int)want;
+        rem[c] = (ValuePos){ take[c] - want, c };
+        given += take[c];
+    }
+    qsort(rem, k, sizeof(ValuePos), cmp_value_pos);
+    for (int q = 0; q < k && given < n_test; q++, given++) take[rem[q].pos]++;
+
+    out->n_train = n_train;
+    out->n_test = n_test;
+    out->train = malloc((n_train > 0 ? n_train : 1) * sizeof(int));
+    out->test = malloc((n_test > 0 ? n_test : 1) * sizeof(int));
+    int a = 0, b = 0;
+    for (int c = 0; c < k; c++) {
+        int cut = start[c + 1] - take[c];
+        for (int i = start[c]; i < cut; i++) out->train[a++] = order[i];
+        for (int i = cut; i < start[c + 1]; i++) out->test[b++] = order[i];
+    }
+    qsort(out->train, n_train, sizeof(int), cmp_int);
+    qsort(out->test, n_test, sizeof(int), cmp_int);
+
+    free(take);
+    free(rem);
+    free(start);
+    free(order);
+}
+
+// Fold number (0..k-1) of every row. Without y the (optionally shuffled)
+// rows are cut into k contiguous blocks; with y each class is dealt out
+// round robin, so every fold gets its share of every class.
+void kfold_indices(int n, const double *y, int k, int shuffle,
+                   unsigned long long seed, int *fold_out) {
+    if (k < 2) k = 2;
+    int *order = malloc((n > 0 ? n : 1) * sizeof(int));
+    int *start;
+    ordered_rows(n, y, shuffle, seed, order, &start);
+    for (int i = 0; i < n; i++)
+        fold_out[order[i]] = y ? i % k : (int)((long long)i * k / n);
+    free(start);
+    free(order);
+}
+
+// Fold f as a split: its rows are the test side, the rest train
+void kfold_split(const int *fold, int n, int f, SplitIndex *out) {
+    int n_test = 0;
+    for (int i = 0; i < n; i++) n_test += fold[i] == f;
+    out->n_test = n_test;
+    out->n_train = n - n_test;
+    out->train = malloc((out->n_train > 0 ? out->n_train : 1) * sizeof(int));
+    out->test = malloc((n_test > 0 ? n_test : 1) * sizeof(int));
+    int a = 0, b = 0;
+    for (int i = 0; i < n; i++) {
+        if (fold[i] == f) out->test[b++] = i;
+        else out->train[a++] = i;
+    }
+}
+
+void split_free(SplitIndex *s) {
+    free(s->train);
+    free(s->test);
+    s->train = s->test = NULL;
+    s->n_train = s->n_test = 0;
+}
+
+// y[rows[i]] for each i
+void gather_values(const double *y, const int *rows, int n, double *out) {
+    for (int i = 0; i < n; i++) out[i] = y[rows[i]];
+}
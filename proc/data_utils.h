@@ -1,16 +1,32 @@
-// FILE: data_utils.h
-
-#ifndef DATA_UTILS_H
-#define DATA_UTILS_H
-
-#include "data_types.h"
-#include "preprocessing.h"
-
-void load_and_encode_csv(const char *path, const char *target_col,
-                         Frame *X, double *y, EncodingInfo *encoding_info);
-void zscore(Frame *X, Stats *S);
-void apply_stats(Frame *X, Stats *S);
-void train_test_split(Frame *X, double *y, Frame *Xtr, Frame *Xte,
-                      double *ytr, double *yte, double test_size);
-
+// FILE: data_utils.h
+
+#ifndef DATA_UTILS_H
+#define DATA_UTILS_H
+
+#include "data_types.h"
+#include "preprocessing.h"
+#include "csv_reader.h"
+
+int read_csv_header(CsvReader *csv, const char *target_col,
+                    char (**headers_out)[MAX_STR], int *target_index_out);
+void load_and_encode_csv(const char *path, const char *target_col,
+                         Frame *X, double **y_out, EncodingInfo *encoding_info);
+int encoding_scan(const char *path, const char *target_col, EncodingInfo *encoding_info);
+void load_csv_with_encoding(const char *path, const char *target_col,
+                            const EncodingInfo *encoding_info, Frame *X, double **y_out);
+void stats_fit(const Frame *X, Stats *S);
+void stats_acc_init(StatsAcc *A, int d);
+void stats_acc_add(StatsAcc *A, const Frame *X);
+void stats_acc_finish(StatsAcc *A, Stats *S);
+void zscore(Frame *X, Stats *S);
+void apply_stats(Frame *X, Stats *S);
+void stats_free(Stats *S);
+void split_indices(int n, const double *y, double test_size, int shuffle,
+                   unsigned long long seed, SplitIndex *out);
+void kfold_indices(int n, const double *y, int k, int shuffle,
+                   unsigned long long seed, int *fold_out);
+void kfold_split(const int *fold, int n, int f, SplitIndex *out);
+void split_free(SplitIndex *s);
+void gather_values(const double *y, const int *rows, int n, double *out);
+
 #endif
\ No newline at end of file
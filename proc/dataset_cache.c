@@ -0,0 +1,293 @@
+// FILE: dataset_cache.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dataset_cache.h"
+#include "frame.h"
+#include "model_io.h"
+#include "preprocessing.h"
+
+// Encoded datasets cached next to their CSV as <csv>.<target>.cache:
+//
+//   CacheHeader
+//   rows x cols doubles, the Frame's row-major data  (at data_offset, page aligned)
+//   rows doubles of targets                          (y_offset)
+//   cols colnames of MAX_STR bytes                   (colnames_offset)
+//   the EncodingInfo, as in model files              (encoding_offset)
+//
+// A cache only counts for the CSV with the same size, mtime and content hash
+// and the same target column. Loads map the file copy-on-write and point the
+// Frame straight into the mapping, so nothing is parsed or copied and every
+// process reading the same cache shares its pages until one writes to them.
+
+typedef struct {
+    char magic[8];
+    int version;
+    int byte_order;
+    int rows;
+    int cols;
+    char target[MAX_STR];
+    long long src_size;
+    long long src_mtime_sec;
+    long long src_mtime_nsec;
+    unsigned long long src_hash;
+    long long data_offset;
+    long long y_offset;
+    long long colnames_offset;
+    long long encoding_offset;
+    long long file_size;
+} CacheHeader;
+
+#define CACHE_BYTE_ORDER 0x01020304
+
+static int cache_on = 1;
+
+// Caching is on by default; ml_program --no-cache turns it off
+void dataset_cache_enable(int on) {
+    cache_on = on;
+}
+
+static void cache_path(const char *csv_path, const char *target_col, char *out, size_t cap) {
+    int len = snprintf(out, cap, "%s.", csv_path);
+    for (const char *t = target_col; *t && len + 7 < (int)cap; t++)
+        out[len++] = isalnum((unsigned char)*t) || *t == '.' || *t == '-' ? *t : '_';
+    snprintf(out + len, cap - len, ".cache");
+}
+
+// FNV-1a over 8 byte words (then the tail bytes): cheap enough to run on
+// every load, and any edit to the CSV changes it
+static int hash_file(const char *path, unsigned long long *out) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    unsigned long long h = 14695981039346656037ull;
+    size_t cap = 1 << 20, n;
+    unsigned char *buf = malloc(cap);
+    if (!buf) {
+        fclose(fp);
+        return -1;
+    }
+    while ((n = fread(buf, 1, cap, fp)) > 0) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            unsigned long long w;
+            memcpy(&w, buf + i, 8);
+            h = (h ^ w) * 1099511628211ull;
+        }
+        for (; i < n; i++) h = (h ^ buf[i]) * 1099511628211ull;
+    }
+    free(buf);
+    fclose(fp);
+    *out = h;
+    return 0;
+}
+
+// Header of the cache a CSV (as it is now) and target should have
+static int expected_header(const char *csv_path, const char *target_col, CacheHeader *H) {
+    struct stat st;
+    if (stat(csv_path, &st) != 0) return -1;
+    memset(H, 0, sizeof(*H));
+    memcpy(H->magic, CACHE_MAGIC, 8);
+    H->version = CACHE_VERSION;
+    H->byte_order = CACHE_BYTE_ORDER;
+    strncpy(H->target, target_col, MAX_STR - 1);
+    H->src_size = st.st_size;
+    H->src_mtime_sec = st.st_mtim.tv_sec;
+    H->src_mtime_nsec = st.st_mtim.tv_nsec;
+    return hash_file(csv_path, &H->src_hash);
+}
+
+// Open the cache of csv_path / target_col for reading, check it against the
+// CSV as it is now and read its encoding; L receives where the rows are.
+// Returns NULL, touching nothing, when caching is off or there is no valid cache.
+FILE *dataset_cache_open(const char *csv_path, const char *target_col,
+                         CacheLayout *L, EncodingInfo *encoding_info) {
+    if (!cache_on) return NULL;
+    char path[4096];
+    cache_path(csv_path, target_col, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    CacheHeader H, want;
+    struct stat st;
+    if (fread(&H, sizeof(H), 1, fp) != 1 || fstat(fileno(fp), &st) != 0 ||
+        expected_header(csv_path, target_col, &want) != 0 ||
+        memcmp(H.magic, want.magic, 8) != 0 || H.version != want.version ||
+        H.byte_order != want.byte_order || strncmp(H.target, want.target, MAX_STR) != 0 ||
+        H.src_size != want.src_size || H.src_mtime_sec != want.src_mtime_sec ||
+        H.src_mtime_nsec != want.src_mtime_nsec || H.src_hash != want.src_hash) {
+        fclose(fp);
+        return NULL;
+    }
+
+    // every section has to fit, in order, inside the file
+    long long data_bytes = (long long)H.rows * H.cols * sizeof(double);
+    if (H.rows <= 0 || H.cols <= 0 || H.file_size != st.st_size ||
+        H.data_offset % CACHE_ALIGN != 0 || H.data_offset < (long long)sizeof(H) ||
+        H.y_offset < H.data_offset + data_bytes ||
+        H.colnames_offset < H.y_offset + (long long)H.rows * (long long)sizeof(double) ||
+        H.encoding_offset < H.colnames_offset + (long long)H.cols * MAX_STR ||
+        H.encoding_offset > H.file_size) {
+        fclose(fp);
+        return NULL;
+    }
+
+    EncodingInfo E;
+    if (fseek(fp, H.encoding_offset, SEEK_SET) != 0 || encoding_read(fp, &E) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    if (E.n_encoded_cols != H.cols) {
+        encoding_info_free(&E);
+        fclose(fp);
+        return NULL;
+    }
+
+    L->rows = H.rows;
+    L->cols = H.cols;
+    L->data_offset = H.data_offset;
+    L->y_offset = H.y_offset;
+    L->colnames_offset = H.colnames_offset;
+    L->file_size = H.file_size;
+    *encoding_info = E;
+    return fp;
+}
+
+// Map the cache of csv_path / target_col into X, y and encoding_info.
+// Returns -1, touching nothing, when caching is off or there is no valid
+// cache for the file as it is now.
+int dataset_cache_load(const char *csv_path, const char *target_col,
+                       Frame *X, double **y_out, EncodingInfo *encoding_info) {
+    CacheLayout L;
+    EncodingInfo E;
+    FILE *fp = dataset_cache_open(csv_path, target_col, &L, &E);
+    if (!fp) return -1;
+
+    void *base = mmap(NULL, L.file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), 0);
+    fclose(fp);
+    if (base == MAP_FAILED) {
+        encoding_info_free(&E);
+        return -1;
+    }
+
+    double *y = malloc((size_t)L.rows * sizeof(double));
+    if (!y) {
+        fprintf(stderr, "Error: Out of memory for target column\n");
+        exit(1);
+    }
+    memcpy(y, (char *)base + L.y_offset, (size_t)L.rows * sizeof(double));
+
+    X->data = (double *)((char *)base + L.data_offset);
+    X->colnames = (char (*)[MAX_STR])((char *)base + L.colnames_offset);
+    X->rows = L.rows;
+    X->cols = L.cols;
+    X->index = NULL;
+    X->mapping = base;
+    X->mapping_size = L.file_size;
+    *encoding_info = E;
+    *y_out = y;
+
+    char path[4096];
+    cache_path(csv_path, target_col, path, sizeof(path));
+    printf("Loaded %d rows from cache %s\n", X->rows, path);
+    if (E.target_is_categorical)
+        printf("Target is categorical with %d unique classes\n", E.target_classes.count);
+    else
+        printf("Target is numeric (regression)\n");
+    printf("Final dataset: %d rows, %d features\n", X->rows, X->cols);
+    return 0;
+}
+
+static int write_at(FILE *fp, long long offset, const void *p, size_t bytes) {
+    return fseek(fp, offset, SEEK_SET) == 0 && fwrite(p, 1, bytes, fp) == bytes ? 0 : -1;
+}
+
+// Start the cache of csv_path / target_col for rows encoded rows shaped like
+// X (which only supplies the column count and names). Everything but the
+// rows goes in now; dataset_cache_append then adds rows in order and
+// dataset_cache_end publishes the file. The file is built under a temporary
+// name and renamed into place, so concurrent runs never see half a cache.
+// Returns -1 (with nothing left behind) when no cache is written.
+int dataset_cache_begin(CacheWriter *w, const char *csv_path, const char *target_col,
+                        int rows, const Frame *X, const EncodingInfo *encoding_info) {
+    w->fp = NULL;
+    if (!cache_on || rows <= 0 || X->cols <= 0) return -1;
+    cache_path(csv_path, target_col, w->path, sizeof(w->path));
+    snprintf(w->tmp, sizeof(w->tmp), "%s.%ld.tmp", w->path, (long)getpid());
+
+    CacheHeader H;
+    if (expected_header(csv_path, target_col, &H) != 0) return -1;
+    H.rows = rows;
+    H.cols = X->cols;
+    H.data_offset = ((long long)sizeof(H) + CACHE_ALIGN - 1) / CACHE_ALIGN * CACHE_ALIGN;
+    H.y_offset = H.data_offset + (long long)rows * X->cols * sizeof(double);
+    H.colnames_offset = H.y_offset + (long long)rows * sizeof(double);
+    H.encoding_offset = H.colnames_offset + (long long)X->cols * MAX_STR;
+
+    w->fp = fopen(w->tmp, "wb");
+    if (!w->fp) {
+        printf("Note: could not write dataset cache %s\n", w->path);
+        return -1;
+    }
+    w->layout.rows = rows;
+    w->layout.cols = X->cols;
+    w->layout.data_offset = H.data_offset;
+    w->layout.y_offset = H.y_offset;
+    w->layout.colnames_offset = H.colnames_offset;
+    w->rows_written = 0;
+    w->failed = write_at(w->fp, H.colnames_offset, X->colnames, (size_t)X->cols * MAX_STR) ||
+                encoding_write(w->fp, encoding_info) != 0;
+    H.file_size = ftell(w->fp);
+    w->layout.file_size = H.file_size;
+    w->failed = w->failed || write_at(w->fp, 0, &H, sizeof(H)) != 0;
+    return 0;
+}
+
+// Add the rows of X (a view is fine) and their targets after those written so far
+void dataset_cache_append(CacheWriter *w, const Frame *X, const double *y) {
+    if (!w->fp || w->failed) return;
+    if (X->cols != w->layout.cols || w->rows_written + X->rows > w->layout.rows) {
+        w->failed = 1;
+        return;
+    }
+    size_t row_bytes = (size_t)X->cols * sizeof(double);
+    long long at = w->layout.data_offset + (long long)w->rows_written * row_bytes;
+    if (X->index) {
+        for (int i = 0; i < X->rows && !w->failed; i++)
+            w->failed = write_at(w->fp, at + (long long)i * row_bytes, frame_row(X, i), row_bytes);
+    } else {
+        w->failed = write_at(w->fp, at, X->data, (size_t)X->rows * row_bytes);
+    }
+    w->failed = w->failed || write_at(w->fp, w->layout.y_offset + (long long)w->rows_written *
+                                      (long long)sizeof(double), y, (size_t)X->rows * sizeof(double));
+    w->rows_written += X->rows;
+}
+
+// Publish the cache if every row arrived, otherwise drop it. Failing to
+// write is only reported: the data itself was loaded fine.
+void dataset_cache_end(CacheWriter *w) {
+    if (!w->fp) return;
+    int failed = w->failed || w->rows_written != w->layout.rows;
+    failed = fclose(w->fp) != 0 || failed;
+    w->fp = NULL;
+    if (failed || rename(w->tmp, w->path) != 0) {
+        remove(w->tmp);
+        printf("Note: could not write dataset cache %s\n", w->path);
+        return;
+    }
+    printf("Dataset cached to %s\n", w->path);
+}
+
+// Write the cache for a freshly encoded X in one go
+void dataset_cache_save(const char *csv_path, const char *target_col,
+                        const Frame *X, const double *y, const EncodingInfo *encoding_info) {
+    CacheWriter w;
+    if (X->index || dataset_cache_begin(&w, csv_path, target_col, X->rows, X, encoding_info) != 0)
+        return;
+    dataset_cache_append(&w, X, y);
+    dataset_cache_end(&w);
+}
@@ -0,0 +1,45 @@
+// FILE: dataset_cache.h
+
+#ifndef DATASET_CACHE_H
+#define DATASET_CACHE_H
+
+#include <stdio.h>
+#include "data_types.h"
+
+#define CACHE_MAGIC "MLPCACHE"   // first 8 bytes of every cache file
+#define CACHE_VERSION 1          // bump whenever the layout changes
+#define CACHE_ALIGN 4096         // the matrix starts on a page boundary
+
+// Where the sections of a cache file start
+typedef struct {
+    int rows;
+    int cols;
+    long long data_offset;      // rows x cols doubles
+    long long y_offset;         // rows doubles
+    long long colnames_offset;
+    long long file_size;
+} CacheLayout;
+
+// A cache file being written a chunk of rows at a time
+typedef struct {
+    FILE *fp;
+    char path[4096];
+    char tmp[4200];
+    CacheLayout layout;
+    int rows_written;
+    int failed;
+} CacheWriter;
+
+void dataset_cache_enable(int on);
+FILE *dataset_cache_open(const char *csv_path, const char *target_col,
+                         CacheLayout *L, EncodingInfo *encoding_info);
+int dataset_cache_load(const char *csv_path, const char *target_col,
+                       Frame *X, double **y_out, EncodingInfo *encoding_info);
+void dataset_cache_save(const char *csv_path, const char *target_col,
+                        const Frame *X, const double *y, const EncodingInfo *encoding_info);
+int dataset_cache_begin(CacheWriter *w, const char *csv_path, const char *target_col,
+                        int rows, const Frame *X, const EncodingInfo *encoding_info);
+void dataset_cache_append(CacheWriter *w, const Frame *X, const double *y);
+void dataset_cache_end(CacheWriter *w);
+
+#endif
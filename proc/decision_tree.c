@@ -1,289 +1,710 @@
-// FILE: decision_tree.c
-
-#include <stdlib.h>
-#include <math.h>
-#include <string.h>
-#include "decision_tree.h"
-
-// Count unique integers and their frequencies
-static int *unique_int_counts(const int *arr, int n, int **vals_out,
-                               int **counts_out, int *m_out) {
-    int *vals = malloc(n * sizeof(int)); // unique values found
-    int *cnts = malloc(n * sizeof(int)); // count for each unique value
-    int m = 0; // number of unique values found
-
-    for (int i = 0; i < n; ++i) {
-        int v = arr[i];
-        int found = 0;
-        for (int j = 0; j < m; ++j) {
-            if (vals[j] == v) { cnts[j] += 1; found = 1; break; }
-        }
-        if (!found) { vals[m] = v; cnts[m] = 1; m++; }
-    }
-
-    *vals_out = vals;
-    *counts_out = cnts;
-    *m_out = m;
-    return NULL;
-}
-
-// Entropy calculation for classification impurity
-static double entropy(const int *y, int n) {
-    if (n == 0) return 0.0;
-
-    int *vals, *cnts, m;
-    unique_int_counts(y, n, &vals, &cnts, &m);
-
-    double H = 0.0;
-    for (int i = 0; i < m; ++i) {
-        double p = (double)cnts[i] / (double)n;
-        if (p > 0.0)
-            H -= p * (log(p + 1e-12) / log(2.0)); // base-2 log
-    }
-
-    free(vals);
-    free(cnts);
-    return H;
-}
-
-// Assign a continuous value to a bin index
-static int digitize_value(double x, const double *edges, int num_edges) {
-    if (x < edges[0]) return 0;
-    for (int i = 0; i < num_edges - 1; ++i) {
-        if (x >= edges[i] && x < edges[i+1]) return i;
-    }
-    return num_edges - 2;
-}
-
-// Convert a column into discrete bins (equal-width)
-static int *compute_bins_for_col(const double *col, int n, int n_bins,
-                                  double **edges_out) {
-    double minv = col[0];
-    double maxv = col[0];
-
-    // find min and max in column
-    for (int i = 1; i < n; ++i) {
-        if (col[i] < minv) minv = col[i];
-        if (col[i] > maxv) maxv = col[i];
-    }
-
-    if (minv == maxv) maxv = minv + 1e-6; // avoid zero range
-
-    int num_edges = n_bins + 1;
-    double *edges = malloc(num_edges * sizeof(double));
-
-    // evenly spaced bin split boundaries
-    for (int i = 0; i < num_edges; ++i)
-        edges[i] = minv + (maxv - minv) * ((double)i / (double)(num_edges - 1));
-
-    // assign each row to a bin
-    int *bins = malloc(n * sizeof(int));
-    for (int i = 0; i < n; ++i)
-        bins[i] = digitize_value(col[i], edges, num_edges);
-
-    *edges_out = edges;
-    return bins;
-}
-
-// Information Gain = parent entropy - weighted child entropy
-static double information_gain(const int *y, const int *x_col, int n) {
-    double H = entropy(y, n);
-
-    int *vals, *cnts, m;
-    unique_int_counts(x_col, n, &vals, &cnts, &m);
-
-    double cond = 0.0;
-
-    // compute conditional entropy
-    for (int i = 0; i < m; ++i) {
-        int v = vals[i];
-        int c = cnts[i];
-
-        int *y_sub = malloc(c * sizeof(int));
-        int idx = 0;
-
-        for (int j = 0; j < n; ++j)
-            if (x_col[j] == v) y_sub[idx++] = y[j];
-
-        cond += ((double)c / (double)n) * entropy(y_sub, c);
-        free(y_sub);
-    }
-
-    free(vals);
-    free(cnts);
-
-    double ig = H - cond;
-    return (ig < 0) ? 0.0 : ig;
-}
-
-// Most common label for leaf node prediction
-static int majority_label(const int *y, int n) {
-    int *vals, *cnts, m;
-    unique_int_counts(y, n, &vals, &cnts, &m);
-
-    if (m == 0) { free(vals); free(cnts); return 0; }
-
-    int best = 0;
-    for (int i = 1; i < m; ++i)
-        if (cnts[i] > cnts[best])
-            best = i;
-
-    int label = vals[best];
-    free(vals);
-    free(cnts);
-    return label;
-}
-
-// Recursive tree building (depth-first)
-static Node* build_tree(Frame *X, int *y, int depth, int max_depth,
-                        int min_samples_split, int n_bins) {
-    Node *node = malloc(sizeof(Node)); // allocate new tree node
-    node->leaf = 0;
-    node->label = 0;
-    node->feature = -1;
-    node->num_edges = 0;
-    node->edges = NULL;
-    node->num_children = 0;
-    node->children = NULL;
-
-    int n = X->rows;
-    int d = X->cols;
-
-    if (n == 0) { // empty = default leaf
-        node->leaf = 1;
-        node->label = 0;
-        return node;
-    }
-
-    // check if all labels are identical
-    int same = 1;
-    for (int i = 1; i < n; ++i)
-        if (y[i] != y[0]) { same = 0; break; }
-
-    // stop splitting if pure or too deep or too small
-    if (depth >= max_depth || same || n < min_samples_split) {
-        node->leaf = 1;
-        node->label = majority_label(y, n);
-        return node;
-    }
-
-    // find best feature by max info gain
-    int best_feat = -1;
-    double best_gain = 0.0;
-    double *best_edges = NULL;
-    int *best_bins = NULL;
-
-    for (int j = 0; j < d; ++j) {
-        double *col = malloc(n * sizeof(double));
-        for (int i = 0; i < n; ++i) col[i] = X->data[i][j];
-
-        double *edges = NULL;
-        int *bins = compute_bins_for_col(col, n, n_bins, &edges);
-        double g = information_gain(y, bins, n);
-
-        if (g > best_gain) {
-            if (best_edges) free(best_edges);
-            if (best_bins) free(best_bins);
-            best_gain = g;
-            best_feat = j;
-            best_edges = edges;
-            best_bins = bins;
-        } else {
-            free(edges);
-            free(bins);
-        }
-        free(col);
-    }
-
-    if (best_feat == -1 || best_edges == NULL) { // no gain = make leaf
-        node->leaf = 1;
-        node->label = majority_label(y, n);
-        if (best_edges) free(best_edges);
-        if (best_bins) free(best_bins);
-        return node;
-    }
-
-    // assign best feature split to node
-    node->feature = best_feat;
-    node->edges = best_edges;
-    node->num_edges = n_bins + 1;
-
-    // group by bin value for child branches
-    int *vals, *cnts, m;
-    unique_int_counts(best_bins, n, &vals, &cnts, &m);
-
-    node->num_children = m;
-    node->children = malloc(m * sizeof(Node*));
-
-    for (int k = 0; k < m; ++k) {
-        int bin_val = vals[k];
-        int cnt = cnts[k];
-
-        Frame X_sub;
-        X_sub.rows = cnt;
-        X_sub.cols = d;
-
-        int *y_sub = malloc(cnt * sizeof(int));
-        int idx = 0;
-
-        // extract samples that match this bin
-        for (int i = 0; i < n; ++i) {
-            if (best_bins[i] == bin_val) {
-                for (int j = 0; j < d; ++j)
-                    X_sub.data[idx][j] = X->data[i][j];
-                y_sub[idx] = y[i];
-                idx++;
-            }
-        }
-
-        // recurse into subtree
-        node->children[k] = build_tree(&X_sub, y_sub,
-                                       depth + 1, max_depth,
-                                       min_samples_split, n_bins);
-
-        free(y_sub);
-    }
-
-    free(best_bins);
-    free(vals);
-    free(cnts);
-    return node;
-}
-
-// User API: train decision tree
-Node* decision_tree_fit(Frame *X, int *y, int max_depth,
-                        int min_samples_split, int n_bins) {
-    return build_tree(X, y, 0, max_depth, min_samples_split, n_bins);
-}
-
-// Predict labels by traversing tree until leaf
-void decision_tree_predict(Node *tree, Frame *X, int *out) {
-    for (int i = 0; i < X->rows; i++) {
-        Node *node = tree;
-
-        while (!node->leaf && node->num_children > 0) {
-            int feat = node->feature;
-            double val = X->data[i][feat];
-            int bin = digitize_value(val, node->edges, node->num_edges);
-
-            if (bin >= 0 && bin < node->num_children)
-                node = node->children[bin];
-            else
-                node = node->children[0]; // fallback if unexpected bin
-        }
-
-        out[i] = node->label; // store prediction
-    }
-}
-
-// Free all memory allocated for tree recursively
-void decision_tree_free(Node *tree) {
-    if (!tree) return;
-    if (tree->edges) free(tree->edges);
-    if (tree->children) {
-        for (int i = 0; i < tree->num_children; i++)
-            decision_tree_free(tree->children[i]);
-        free(tree->children);
-    }
-    free(tree);
-}
+// FILE: decision_tree.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "decision_tree.h"
+#include "frame.h"
+#include "parallel.h"
+#include "rng.h"
+
+// Class index of every label (in order of first appearance); returns the
+// number of classes and hands back the label of each class index
+int tree_classes(const int *y, int n, int *cls, int **labels_out) {
+    int *labels = malloc((n > 0 ? n : 1) * sizeof(int));
+    int m = 0;
+    for (int i = 0; i < n; ++i) {
+        int c = 0;
+        while (c < m && labels[c] != y[i]) c++;
+        if (c == m) labels[m++] = y[i];
+        cls[i] = c;
+    }
+    *labels_out = labels;
+    return m;
+}
+
+// Entropy of a class count vector with n rows in total
+static double entropy_counts(const int *counts, int n_classes, int n) {
+    if (n == 0) return 0.0;
+
+    double H = 0.0;
+    for (int c = 0; c < n_classes; ++c) {
+        double p = (double)counts[c] / (double)n;
+        if (p > 0.0)
+            H -= p * (log(p + 1e-12) / log(2.0)); // base-2 log
+    }
+    return H;
+}
+
+// Bin of x given m ascending thresholds: the first threshold >= x, found by
+// binary search, so bin b holds thresholds[b - 1] < x <= thresholds[b]
+static int bin_of(double x, const double *thresholds, int m) {
+    int lo = 0, hi = m;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (thresholds[mid] < x) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Quantile (equal-frequency) thresholds of one column, at most n_bins - 1.
+// Columns with few distinct values (one hot flags) get a threshold between
+// each pair of neighbours; otherwise cuts sit at every 1/n_bins of the sorted
+// column, halfway to the next larger value, so a heavy value such as a zero
+// in capital.gain fills one bin instead of swallowing the rest.
+static int column_thresholds(double *col, int n, int n_bins, double *thr) {
+    double uniq[TREE_MAX_BINS + 1];
+    int m = 0;
+    for (int i = 0; i < n && m <= n_bins; ++i) {
+        int found = 0;
+        for (int k = 0; k < m; ++k)
+            if (uniq[k] == col[i]) { found = 1; break; }
+        if (!found) uniq[m++] = col[i];
+    }
+
+    int count = 0;
+    if (m <= n_bins) {
+        qsort(uniq, m, sizeof(double), cmp_double);
+        for (int k = 0; k + 1 < m; ++k) thr[count++] = 0.5 * (uniq[k] + uniq[k + 1]);
+        return count;
+    }
+
+    qsort(col, n, sizeof(double), cmp_double);
+    for (int q = 1; q < n_bins; ++q) {
+        double v = col[(size_t)q * n / n_bins - 1];
+        // first value above v
+        int lo = 0, hi = n;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (col[mid] <= v) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == n) break;
+        double t = 0.5 * (v + col[lo]);
+        if (count == 0 || t > thr[count - 1]) thr[count++] = t;
+    }
+    return count;
+}
+
+// Bin every feature once up front: split search and partitioning then only
+// touch the uint8 codes, never the Frame
+void tree_bins_build(TreeBins *B, const Frame *X, int n_bins) {
+    if (n_bins < 2) n_bins = 2;
+    if (n_bins > TREE_MAX_BINS) n_bins = TREE_MAX_BINS;
+    int n = X->rows, d = X->cols;
+    B->n = n;
+    B->d = d;
+    B->n_bins = n_bins;
+    B->n_thresholds = malloc(d * sizeof(int));
+    B->thresholds = malloc((size_t)d * (n_bins - 1) * sizeof(double));
+    B->codes = malloc((size_t)n * d);
+    double *col = malloc((n > 0 ? n : 1) * sizeof(double));
+    if (!B->n_thresholds || !B->thresholds || !B->codes || !col) {
+        fprintf(stderr, "Error: Out of memory binning features\n");
+        exit(1);
+    }
+
+    for (int j = 0; j < d; ++j) {
+        for (int i = 0; i < n; ++i) col[i] = frame_row(X, i)[j];
+        B->n_thresholds[j] = column_thresholds(col, n, n_bins,
+                                               B->thresholds + (size_t)j * (n_bins - 1));
+    }
+    free(col);
+
+    for (int i = 0; i < n; ++i) {
+        const double *x = frame_row(X, i);
+        unsigned char *code = B->codes + (size_t)i * d;
+        for (int j = 0; j < d; ++j)
+            code[j] = (unsigned char)bin_of(x[j], B->thresholds + (size_t)j * (n_bins - 1),
+                                            B->n_thresholds[j]);
+    }
+}
+
+void tree_bins_free(TreeBins *B) {
+    free(B->n_thresholds);
+    free(B->thresholds);
+    free(B->codes);
+    B->n_thresholds = NULL;
+    B->thresholds = NULL;
+    B->codes = NULL;
+}
+
+// Shared state of one tree build. A node owns the slice rows[begin, end) of
+// a single index array and is described by its class-count histogram
+// hist[feature][bin][class]; no rows are ever copied. With max_features set,
+// each split only looks at that many features drawn from rng, and histograms
+// of just those are scanned per node instead of kept for every feature.
+typedef struct {
+    const TreeBins *B;
+    const int *cls;      // class index of each row
+    const int *labels;   // label of each class index
+    int n_classes;
+    int max_depth;
+    int min_samples_split;
+    int *rows;
+    int *scratch;        // partition buffer, as long as rows
+    int *counts;         // class counts of the current node
+    int *left;           // class counts left and right of a candidate split
+    int *right;
+    int max_features;    // 0 = every feature at every split
+    int *features;       // feature permutation the split draws from
+    int *sample_hist;    // histogram of the drawn features
+    Rng rng;
+} TreeBuild;
+
+static size_t hist_size(const TreeBuild *T) {
+    return (size_t)T->B->d * T->B->n_bins * T->n_classes;
+}
+
+// Class counts per (feature, bin) over rows[begin, end)
+static void node_histogram(const TreeBuild *T, int begin, int end, int *hist) {
+    int d = T->B->d;
+    int stride = T->B->n_bins * T->n_classes;
+    memset(hist, 0, hist_size(T) * sizeof(int));
+
+    for (int r = begin; r < end; ++r) {
+        int i = T->rows[r];
+        const unsigned char *code = T->B->codes + (size_t)i * d;
+        int *h = hist + T->cls[i];
+        for (int j = 0; j < d; ++j)
+            h[(size_t)j * stride + code[j] * T->n_classes]++;
+    }
+}
+
+// Class counts per (drawn feature, bin) over rows[begin, end)
+static void sample_histogram(const TreeBuild *T, int begin, int end, int *hist) {
+    int d = T->B->d;
+    int stride = T->B->n_bins * T->n_classes;
+    memset(hist, 0, (size_t)T->max_features * stride * sizeof(int));
+
+    for (int r = begin; r < end; ++r) {
+        int i = T->rows[r];
+        const unsigned char *code = T->B->codes + (size_t)i * d;
+        int *h = hist + T->cls[i];
+        for (int f = 0; f < T->max_features; ++f)
+            h[(size_t)f * stride + code[T->features[f]] * T->n_classes]++;
+    }
+}
+
+// Best split "bin <= b" of feature j by info gain, from its class counts per
+// bin hj; best_* are only replaced by a strictly larger gain
+static void scan_feature(const int *hj, int n_thresholds, int j, const int *counts, int n,
+                         int nc, double H, int *left, int *right,
+                         double *best_gain, int *best_feat, int *best_bin) {
+    int nl = 0;
+    memset(left, 0, nc * sizeof(int));
+    for (int b = 0; b < n_thresholds; ++b) {
+        for (int c = 0; c < nc; ++c) {
+            left[c] += hj[b * nc + c];
+            nl += hj[b * nc + c];
+        }
+        if (nl == 0) continue;
+        if (nl == n) break;
+        for (int c = 0; c < nc; ++c) right[c] = counts[c] - left[c];
+        double cond = ((double)nl / n) * entropy_counts(left, nc, nl)
+                    + ((double)(n - nl) / n) * entropy_counts(right, nc, n - nl);
+        double g = H - cond;
+        if (g > *best_gain) {
+            *best_gain = g;
+            *best_feat = j;
+            *best_bin = b;
+        }
+    }
+}
+
+static Node *new_leaf(int label) {
+    Node *node = malloc(sizeof(Node)); // allocate new tree node
+    node->leaf = 1;
+    node->label = label;
+    node->feature = -1;
+    node->threshold = 0.0;
+    node->left = NULL;
+    node->right = NULL;
+    return node;
+}
+
+// Whether a node of n rows at depth may still split
+static int can_split(const TreeBuild *T, int n, int depth) {
+    return depth < T->max_depth && n >= T->min_samples_split;
+}
+
+// Recursive tree building (depth-first). hist describes rows[begin, end),
+// NULL when features are drawn per split or the node cannot split.
+static Node *build_node(TreeBuild *T, int begin, int end, const int *hist, int depth) {
+    int n = end - begin;
+    int nb = T->B->n_bins;
+    int nc = T->n_classes;
+    int stride = nb * nc;
+
+    // class totals, from the bins of feature 0 when the histogram is kept
+    int *counts = T->counts, *left = T->left, *right = T->right;
+    memset(counts, 0, nc * sizeof(int));
+    if (hist) {
+        for (int b = 0; b < nb; ++b)
+            for (int c = 0; c < nc; ++c) counts[c] += hist[b * nc + c];
+    } else {
+        for (int r = begin; r < end; ++r) counts[T->cls[T->rows[r]]]++;
+    }
+
+    int best_class = 0;
+    for (int c = 1; c < nc; ++c)
+        if (counts[c] > counts[best_class]) best_class = c;
+    int label = T->labels[best_class];
+
+    // stop splitting if pure or too deep or too small
+    if (depth >= T->max_depth || counts[best_class] == n || n < T->min_samples_split)
+        return new_leaf(label);
+
+    // best (feature, bin) by info gain of the split bin <= b, from running
+    // class counts over the histogram
+    double H = entropy_counts(counts, nc, n);
+    int best_feat = -1, best_bin = -1;
+    double best_gain = 0.0;
+
+    int n_feat = T->B->d;
+    if (!hist) {
+        // partial shuffle: the first max_features entries are the sample
+        n_feat = T->max_features;
+        for (int k = 0; k < n_feat; ++k) {
+            int r = k + rng_below(&T->rng, T->B->d - k);
+            int t = T->features[k]; T->features[k] = T->features[r]; T->features[r] = t;
+        }
+        sample_histogram(T, begin, end, T->sample_hist);
+    }
+
+    for (int f = 0; f < n_feat; ++f) {
+        int j = T->features[f];
+        const int *hj = hist ? hist + (size_t)j * stride : T->sample_hist + (size_t)f * stride;
+        scan_feature(hj, T->B->n_thresholds[j], j, counts, n, nc, H, left, right,
+                     &best_gain, &best_feat, &best_bin);
+    }
+
+    if (best_feat == -1) return new_leaf(label); // no gain = make leaf
+
+    // stable partition of the slice: bins <= best_bin first
+    int mid = begin, hi = end;
+    for (int r = begin; r < end; ++r) {
+        int i = T->rows[r];
+        if (T->B->codes[(size_t)i * T->B->d + best_feat] <= best_bin) T->rows[mid++] = i;
+        else T->scratch[--hi] = i;
+    }
+    for (int r = mid; r < end; ++r) T->rows[r] = T->scratch[end - 1 - (r - mid)];
+
+    Node *node = new_leaf(label);
+    node->leaf = 0;
+    node->feature = best_feat;
+    node->threshold = T->B->thresholds[(size_t)best_feat * (nb - 1) + best_bin];
+    if (!hist) {
+        node->left = build_node(T, begin, mid, NULL, depth + 1);
+        node->right = build_node(T, mid, end, NULL, depth + 1);
+        return node;
+    }
+
+    // a child that is too deep or too small becomes a leaf straight away and
+    // needs no histogram; when both split, scan the smaller child and take
+    // the larger one as the parent minus it
+    int need_l = can_split(T, mid - begin, depth + 1);
+    int need_r = can_split(T, end - mid, depth + 1);
+    if (!need_l && !need_r) {
+        node->left = build_node(T, begin, mid, NULL, depth + 1);
+        node->right = build_node(T, mid, end, NULL, depth + 1);
+        return node;
+    }
+
+    size_t hs = hist_size(T);
+    int *child_hist = malloc((need_l && need_r ? 2 : 1) * hs * sizeof(int));
+    int *left_hist = NULL, *right_hist = NULL;
+    if (need_l && need_r) {
+        int *small = child_hist, *big = child_hist + hs;
+        int left_small = mid - begin <= end - mid;
+        if (left_small) node_histogram(T, begin, mid, small);
+        else node_histogram(T, mid, end, small);
+        for (size_t q = 0; q < hs; ++q) big[q] = hist[q] - small[q];
+        left_hist = left_small ? small : big;
+        right_hist = left_small ? big : small;
+    } else if (need_l) {
+        left_hist = child_hist;
+        node_histogram(T, begin, mid, left_hist);
+    } else {
+        right_hist = child_hist;
+        node_histogram(T, mid, end, right_hist);
+    }
+
+    node->left = build_node(T, begin, mid, left_hist, depth + 1);
+    node->right = build_node(T, mid, end, right_hist, depth + 1);
+
+    free(child_hist);
+    return node;
+}
+
+// Grow a tree on pre-binned features from the rows listed in rows (repeats
+// allowed, e.g. a bootstrap sample). cls holds the class index of every row
+// of B and labels the value a leaf of each class predicts. max_features > 0
+// draws that many candidate features per split, seeded by seed.
+Node *decision_tree_fit_bins(const TreeBins *B, const int *cls, const int *labels,
+                             int n_classes, const int *rows, int n_rows,
+                             int max_depth, int min_samples_split,
+                             int max_features, unsigned long long seed) {
+    if (n_rows == 0 || n_classes == 0) return new_leaf(n_classes ? labels[0] : 0);
+    if (max_features >= B->d) max_features = 0;
+
+    TreeBuild T = { B, cls, labels, n_classes, max_depth, min_samples_split,
+                    malloc(n_rows * sizeof(int)), malloc(n_rows * sizeof(int)),
+                    malloc(n_classes * sizeof(int)), malloc(n_classes * sizeof(int)),
+                    malloc(n_classes * sizeof(int)), max_features,
+                    malloc((B->d > 0 ? B->d : 1) * sizeof(int)), NULL, { 0 } };
+    int *hist = NULL;
+    if (max_features > 0)
+        T.sample_hist = malloc((size_t)max_features * B->n_bins * n_classes * sizeof(int));
+    else
+        hist = malloc(hist_size(&T) * sizeof(int));
+    if (!T.rows || !T.scratch || !T.counts || !T.left || !T.right || !T.features
+        || (!hist && !T.sample_hist)) {
+        fprintf(stderr, "Error: Out of memory building tree\n");
+        exit(1);
+    }
+    memcpy(T.rows, rows, n_rows * sizeof(int));
+    for (int j = 0; j < B->d; ++j) T.features[j] = j;
+    rng_seed(&T.rng, seed);
+
+    if (hist) node_histogram(&T, 0, n_rows, hist);
+    Node *tree = build_node(&T, 0, n_rows, hist, 0);
+
+    free(hist);
+    free(T.sample_hist);
+    free(T.rows);
+    free(T.scratch);
+    free(T.counts);
+    free(T.left);
+    free(T.right);
+    free(T.features);
+    return tree;
+}
+
+// User API: train decision tree
+Node* decision_tree_fit(Frame *X, int *y, int max_depth,
+                        int min_samples_split, int n_bins) {
+    int n = X->rows;
+    int *cls = malloc((n > 0 ? n : 1) * sizeof(int));
+    int *labels;
+    int m = tree_classes(y, n, cls, &labels);
+
+    TreeBins B;
+    tree_bins_build(&B, X, n_bins);
+
+    int *rows = malloc((n > 0 ? n : 1) * sizeof(int));
+    for (int i = 0; i < n; ++i) rows[i] = i;
+    Node *tree = decision_tree_fit_bins(&B, cls, labels, m, rows, n,
+                                        max_depth, min_samples_split, 0, 0);
+
+    free(rows);
+    free(cls);
+    free(labels);
+    tree_bins_free(&B);
+    return tree;
+}
+
+// Out-of-core growth: the tree is built breadth first, one level per pass
+// over the data. tree_stream_chunk routes every row of a chunk down the
+// splits made so far and adds it to the class histogram of the open node it
+// reaches; tree_stream_level then settles every open node of the level the
+// way build_node would (same stopping rules, same split scan), so with the
+// same bins the tree matches decision_tree_fit. Bin thresholds come from a
+// sample of the training rows, as memory only holds one chunk.
+typedef struct {
+    const TreeStream *T;
+    const Frame *X;
+} StreamBinJob;
+
+static void stream_bin_task(void *ctx, int task, int begin, int end) {
+    StreamBinJob *job = ctx;
+    const TreeStream *T = job->T;
+    (void)task;
+    for (int i = begin; i < end; ++i) {
+        const double *x = frame_row(job->X, i);
+        unsigned char *code = T->codes + (size_t)i * T->d;
+        for (int j = 0; j < T->d; ++j)
+            code[j] = (unsigned char)bin_of(x[j], T->thresholds + (size_t)j * (T->n_bins - 1),
+                                            T->n_thresholds[j]);
+    }
+}
+
+static int stream_add_node(TreeStream *T, int open) {
+    if (T->n_nodes == T->cap_nodes) {
+        T->cap_nodes = T->cap_nodes ? 2 * T->cap_nodes : 64;
+        T->feature = realloc(T->feature, T->cap_nodes * sizeof(int));
+        T->bin = realloc(T->bin, T->cap_nodes * sizeof(int));
+        T->child = realloc(T->child, T->cap_nodes * sizeof(int));
+        T->label = realloc(T->label, T->cap_nodes * sizeof(int));
+        T->slot = realloc(T->slot, T->cap_nodes * sizeof(int));
+        if (!T->feature || !T->bin || !T->child || !T->label || !T->slot) {
+            fprintf(stderr, "Error: Out of memory building tree\n");
+            exit(1);
+        }
+    }
+    int k = T->n_nodes++;
+    T->feature[k] = -1;
+    T->bin[k] = 0;
+    T->child[k] = -1;
+    T->label[k] = 0;
+    T->slot[k] = open ? T->n_open++ : -1;
+    return k;
+}
+
+static void stream_reset_hist(TreeStream *T) {
+    size_t size = (size_t)T->n_open * T->d * T->n_bins * T->n_classes;
+    free(T->hist);
+    T->hist = calloc(size ? size : 1, sizeof(int));
+    if (!T->hist) {
+        fprintf(stderr, "Error: Out of memory for tree histograms\n");
+        exit(1);
+    }
+}
+
+// Bins from the sample rows, a root waiting for the first pass. Rows of a
+// chunk carry class indices 0..n_classes-1, which are also the leaf labels.
+void tree_stream_init(TreeStream *T, const Frame *sample, int n_classes, int max_depth,
+                      int min_samples_split, int n_bins, int max_rows) {
+    memset(T, 0, sizeof(*T));
+    TreeBins B;
+    tree_bins_build(&B, sample, n_bins);
+    free(B.codes);
+    T->d = B.d;
+    T->n_bins = B.n_bins;
+    T->n_thresholds = B.n_thresholds;
+    T->thresholds = B.thresholds;
+    T->n_classes = n_classes > 0 ? n_classes : 1;
+    T->max_depth = max_depth;
+    T->min_samples_split = min_samples_split;
+    T->max_rows = max_rows;
+    T->codes = malloc((size_t)(max_rows > 0 ? max_rows : 1) * (T->d > 0 ? T->d : 1));
+    if (!T->codes) {
+        fprintf(stderr, "Error: Out of memory binning features\n");
+        exit(1);
+    }
+    stream_add_node(T, 1);
+    stream_reset_hist(T);
+}
+
+// Add the rows of one chunk to the histograms of the open nodes they reach
+void tree_stream_chunk(TreeStream *T, const Frame *X, const int *cls) {
+    if (T->n_open == 0 || X->rows == 0) return;
+    if (X->rows > T->max_rows) {
+        fprintf(stderr, "Error: Chunk of %d rows is larger than the stream's %d\n",
+                X->rows, T->max_rows);
+        exit(1);
+    }
+    StreamBinJob job = { T, X };
+    parallel_for(X->rows, stream_bin_task, &job);
+
+    int d = T->d, nc = T->n_classes;
+    size_t stride = (size_t)T->n_bins * nc;
+    for (int i = 0; i < X->rows; ++i) {
+        if (cls[i] < 0 || cls[i] >= nc) continue;
+        const unsigned char *code = T->codes + (size_t)i * d;
+        int k = 0;
+        while (T->child[k] >= 0) k = T->child[k] + (code[T->feature[k]] > T->bin[k]);
+        if (T->slot[k] < 0) continue;
+        int *h = T->hist + (size_t)T->slot[k] * d * stride + cls[i];
+        for (int j = 0; j < d; ++j) h[(size_t)j * stride + code[j] * nc]++;
+    }
+}
+
+// Settle every open node of the current level from its histogram, opening
+// the children of each split; returns 1 once no node is left open
+int tree_stream_level(TreeStream *T) {
+    int d = T->d, nb = T->n_bins, nc = T->n_classes;
+    size_t stride = (size_t)nb * nc;
+    int *counts = malloc(nc * sizeof(int));
+    int *left = malloc(nc * sizeof(int));
+    int *right = malloc(nc * sizeof(int));
+    int *hist = T->hist;
+    T->hist = NULL;
+    int level_end = T->n_nodes;
+    T->n_open = 0;
+
+    for (int k = 0; k < level_end; ++k) {
+        int s = T->slot[k];
+        if (s < 0) continue;
+        T->slot[k] = -1;
+        const int *hk = hist + (size_t)s * d * stride;
+
+        int n = 0;
+        memset(counts, 0, nc * sizeof(int));
+        for (int b = 0; b < nb; ++b)
+            for (int c = 0; c < nc; ++c) counts[c] += hk[b * nc + c];
+        for (int c = 0; c < nc; ++c) n += counts[c];
+
+        int best_class = 0;
+        for (int c = 1; c < nc; ++c)
+            if (counts[c] > counts[best_class]) best_class = c;
+        T->label[k] = best_class;
+        if (T->level >= T->max_depth || counts[best_class] == n || n < T->min_samples_split)
+            continue;
+
+        double H = entropy_counts(counts, nc, n);
+        int best_feat = -1, best_bin = -1;
+        double best_gain = 0.0;
+        for (int j = 0; j < d; ++j)
+            scan_feature(hk + (size_t)j * stride, T->n_thresholds[j], j, counts, n, nc, H,
+                         left, right, &best_gain, &best_feat, &best_bin);
+        if (best_feat == -1) continue;
+
+        T->feature[k] = best_feat;
+        T->bin[k] = best_bin;
+        int l = stream_add_node(T, 1);
+        stream_add_node(T, 1);
+        T->child[k] = l;
+    }
+
+    free(hist);
+    free(counts);
+    free(left);
+    free(right);
+    T->level++;
+    if (T->n_open > 0) stream_reset_hist(T);
+    return T->n_open == 0;
+}
+
+static Node *stream_node(const TreeStream *T, int k) {
+    Node *node = new_leaf(T->label[k]);
+    if (T->child[k] >= 0) {
+        node->leaf = 0;
+        node->feature = T->feature[k];
+        node->threshold = T->thresholds[(size_t)T->feature[k] * (T->n_bins - 1) + T->bin[k]];
+        node->left = stream_node(T, T->child[k]);
+        node->right = stream_node(T, T->child[k] + 1);
+    }
+    return node;
+}
+
+// The grown tree (as decision_tree_fit returns it); frees the stream
+Node *tree_stream_finish(TreeStream *T) {
+    Node *tree = stream_node(T, 0);
+    free(T->n_thresholds);
+    free(T->thresholds);
+    free(T->codes);
+    free(T->hist);
+    free(T->feature);
+    free(T->bin);
+    free(T->child);
+    free(T->label);
+    free(T->slot);
+    memset(T, 0, sizeof(*T));
+    return tree;
+}
+
+static int count_nodes(const Node *tree) {
+    return tree->leaf ? 1 : 1 + count_nodes(tree->left) + count_nodes(tree->right);
+}
+
+static int tree_depth(const Node *tree) {
+    if (tree->leaf) return 0;
+    int l = tree_depth(tree->left), r = tree_depth(tree->right);
+    return 1 + (l > r ? l : r);
+}
+
+// Compile a trained tree into breadth first arrays. Both children are queued
+// together, so they always sit next to each other.
+void decision_tree_flatten(const Node *tree, FlatTree *F) {
+    int n = count_nodes(tree);
+    F->n_nodes = n;
+    F->depth = tree_depth(tree);
+    F->feature = malloc(n * sizeof(int));
+    F->threshold = malloc(n * sizeof(double));
+    F->child = malloc(n * sizeof(int));
+    F->label = malloc(n * sizeof(int));
+    const Node **queue = malloc(n * sizeof(Node *));
+    if (!F->feature || !F->threshold || !F->child || !F->label || !queue) {
+        fprintf(stderr, "Error: Out of memory flattening tree\n");
+        exit(1);
+    }
+
+    int next = 1;
+    queue[0] = tree;
+    for (int i = 0; i < n; i++) {
+        const Node *node = queue[i];
+        F->label[i] = node->label;
+        if (node->leaf) {
+            F->feature[i] = 0;
+            F->threshold[i] = INFINITY;
+            F->child[i] = i;
+        } else {
+            F->feature[i] = node->feature;
+            F->threshold[i] = node->threshold;
+            F->child[i] = next;
+            queue[next++] = node->left;
+            queue[next++] = node->right;
+        }
+    }
+    free(queue);
+}
+
+void flat_tree_free(FlatTree *F) {
+    free(F->feature);
+    free(F->threshold);
+    free(F->child);
+    free(F->label);
+    memset(F, 0, sizeof(*F));
+}
+
+typedef struct {
+    const FlatTree *F;
+    const Frame *X;
+    int *out;
+} PredictJob;
+
+// Walk FLAT_TREE_BATCH rows one level at a time: the compare becomes a 0/1
+// offset to the right child, and the independent loads of the batch overlap
+// instead of each row waiting on its own chain of cache misses
+static void predict_task(void *ctx, int task, int begin, int end) {
+    PredictJob *job = ctx;
+    const FlatTree *F = job->F;
+    const double *x[FLAT_TREE_BATCH];
+    int node[FLAT_TREE_BATCH];
+    (void)task;
+
+    for (int i = begin; i < end; i += FLAT_TREE_BATCH) {
+        int m = end - i < FLAT_TREE_BATCH ? end - i : FLAT_TREE_BATCH;
+        for (int r = 0; r < m; r++) {
+            x[r] = frame_row(job->X, i + r);
+            node[r] = 0;
+        }
+        for (int level = 0; level < F->depth; level++) {
+            for (int r = 0; r < m; r++) {
+                int k = node[r];
+                node[r] = F->child[k] + (x[r][F->feature[k]] > F->threshold[k]);
+            }
+        }
+        for (int r = 0; r < m; r++) job->out[i + r] = F->label[node[r]]; // store prediction
+    }
+}
+
+// Predict labels from a compiled tree, rows split across the pool
+void flat_tree_predict(const FlatTree *F, const Frame *X, int *out) {
+    PredictJob job = { F, X, out };
+    parallel_for(X->rows, predict_task, &job);
+}
+
+// Predict labels with a trained tree (flattened for the call)
+void decision_tree_predict(Node *tree, Frame *X, int *out) {
+    FlatTree F;
+    decision_tree_flatten(tree, &F);
+    flat_tree_predict(&F, X, out);
+    flat_tree_free(&F);
+}
+
+// Free all memory allocated for tree recursively
+void decision_tree_free(Node *tree) {
+    if (!tree) return;
+    decision_tree_free(tree->left);
+    decision_tree_free(tree->right);
+    free(tree);
+}
@@ -1,13 +1,63 @@
-// FILE: decision_tree.h
-
-#ifndef DECISION_TREE_H
-#define DECISION_TREE_H
-
-#include "data_types.h"
-
-Node* decision_tree_fit(Frame *X, int *y, int max_depth, 
-                        int min_samples_split, int n_bins);
-void decision_tree_predict(Node *tree, Frame *X, int *out);
-void decision_tree_free(Node *tree);
-
+// FILE: decision_tree.h
+
+#ifndef DECISION_TREE_H
+#define DECISION_TREE_H
+
+#include "data_types.h"
+
+#define TREE_MAX_BINS 255    // bin codes are stored as uint8
+#define FLAT_TREE_BATCH 16   // rows walked down the flat tree together
+
+// Tree grown one level per pass over a stream of chunks (see tree_stream_init)
+typedef struct {
+    int d;
+    int n_bins;
+    int n_classes;
+    int max_depth;
+    int min_samples_split;
+    int max_rows;          // largest chunk
+    int *n_thresholds;     // bins fitted on a sample
+    double *thresholds;
+    unsigned char *codes;  // bin codes of the current chunk
+    int n_nodes;
+    int cap_nodes;
+    int *feature;          // split of each node: code[feature] <= bin goes left
+    int *bin;
+    int *child;            // left child (right is next to it), -1 for a leaf
+    int *label;
+    int *slot;             // histogram of an open node, -1 once settled
+    int n_open;
+    int *hist;             // n_open x d x n_bins x n_classes
+    int level;
+} TreeStream;
+
+Node* decision_tree_fit(Frame *X, int *y, int max_depth, 
+                        int min_samples_split, int n_bins);
+void decision_tree_predict(Node *tree, Frame *X, int *out);
+void decision_tree_free(Node *tree);
+Node *decision_tree_fit_bins(const TreeBins *B, const int *cls, const int *labels,
+                             int n_classes, const int *rows, int n_rows,
+                             int max_depth, int min_samples_split,
+                             int max_features, unsigned long long seed);
+int tree_classes(const int *y, int n, int *cls, int **labels_out);
+void decision_tree_flatten(const Node *tree, FlatTree *F);
+void flat_tree_predict(const FlatTree *F, const Frame *X, int *out);
+void flat_tree_free(FlatTree *F);
+// Label of the leaf row x lands in
+static inline int flat_tree_label(const FlatTree *F, const double *x) {
+    int k = 0;
+    for (int level = 0; level < F->depth; level++)
+        k = F->child[k] + (x[F->feature[k]] > F->threshold[k]);
+    return F->label[k];
+}
+
+void tree_stream_init(TreeStream *T, const Frame *sample, int n_classes, int max_depth,
+                      int min_samples_split, int n_bins, int max_rows);
+void tree_stream_chunk(TreeStream *T, const Frame *X, const int *cls);
+int tree_stream_level(TreeStream *T);
+Node *tree_stream_finish(TreeStream *T);
+
+void tree_bins_build(TreeBins *B, const Frame *X, int n_bins);
+void tree_bins_free(TreeBins *B);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,143 @@
+// FILE: feature_store.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "feature_store.h"
+#include "frame.h"
+#include "parallel.h"
+
+static void *checked_calloc(size_t n, size_t size) {
+    void *p = calloc(n ? n : 1, size);
+    if (!p) {
+        fprintf(stderr, "Error: Out of memory building feature store\n");
+        exit(1);
+    }
+    return p;
+}
+
+// Build the mixed layout from a one hot Frame that has not been standardized yet
+void features_from_frame(const Frame *X, const EncodingInfo *encoding_info,
+                         FeatureStore *F) {
+    int n = X->rows;
+    F->rows = n;
+    F->cols = X->cols;
+    F->n_num = 0;
+    F->n_cat = 0;
+    for (int c = 0; c < encoding_info->n_cols; c++) {
+        if (encoding_info->columns[c].is_categorical) F->n_cat++;
+        else F->n_num++;
+    }
+
+    F->num_cols = checked_calloc(F->n_num, sizeof(int));
+    F->cat_start = checked_calloc(F->n_cat, sizeof(int));
+    F->cat_size = checked_calloc(F->n_cat, sizeof(int));
+    F->num = checked_calloc((size_t)n * F->n_num, sizeof(feat_t));
+    F->codes = checked_calloc((size_t)n * F->n_cat, sizeof(int));
+    F->shift = checked_calloc(F->cols, sizeof(double));
+    F->scale = checked_calloc(F->cols, sizeof(double));
+    for (int j = 0; j < F->cols; j++) F->scale[j] = 1.0;
+
+    int kn = 0, kc = 0;
+    for (int c = 0; c < encoding_info->n_cols; c++) {
+        const ColumnInfo *col = &encoding_info->columns[c];
+        if (col->is_categorical) {
+            F->cat_start[kc] = encoding_info->original_to_encoded[c];
+            F->cat_size[kc] = col->categories.count;
+            kc++;
+        } else {
+            F->num_cols[kn++] = encoding_info->original_to_encoded[c];
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        const double *x = frame_row(X, i);
+        feat_t *num = F->num + (size_t)i * F->n_num;
+        int *code = F->codes + (size_t)i * F->n_cat;
+
+        for (int k = 0; k < F->n_num; k++) num[k] = x[F->num_cols[k]];
+
+        // the hot flag of each block, -1 when the cell was empty
+        for (int k = 0; k < F->n_cat; k++) {
+            code[k] = -1;
+            for (int j = F->cat_start[k]; j < F->cat_start[k] + F->cat_size[k]; j++) {
+                if (x[j] != 0.0) { code[k] = j; break; }
+            }
+        }
+    }
+}
+
+typedef struct {
+    FeatureStore *F;
+    const Stats *S;
+} StandardizeJob;
+
+static void standardize_task(void *ctx, int task, int begin, int end) {
+    StandardizeJob *job = ctx;
+    FeatureStore *F = job->F;
+    (void)task;
+    for (int i = begin; i < end; i++) {
+        feat_t *num = F->num + (size_t)i * F->n_num;
+        for (int k = 0; k < F->n_num; k++) {
+            int j = F->num_cols[k];
+            num[k] = (feat_t)(((double)num[k] - job->S->means[j]) / job->S->stds[j]);
+        }
+    }
+}
+
+// Standardize numeric columns in place, rows split across the pool; one hot
+// columns only record mean/std
+void features_standardize(FeatureStore *F, const Stats *S) {
+    StandardizeJob job = { F, S };
+    parallel_for(F->rows, standardize_task, &job);
+    for (int j = 0; j < F->cols; j++) {
+        F->shift[j] = S->means[j];
+        F->scale[j] = S->stds[j];
+    }
+}
+
+void features_free(FeatureStore *F) {
+    free(F->num_cols);
+    free(F->cat_start);
+    free(F->cat_size);
+    free(F->num);
+    free(F->codes);
+    free(F->shift);
+    free(F->scale);
+    memset(F, 0, sizeof(*F));
+}
+
+// Fold the one hot shift/scale into the weights: fills w_cat (cols wide) and
+// returns the constant every row's dot product starts from
+double features_dot_prepare(const FeatureStore *F, const double *w, double *w_cat) {
+    double c0 = 0.0;
+    for (int k = 0; k < F->n_cat; k++) {
+        for (int j = F->cat_start[k]; j < F->cat_start[k] + F->cat_size[k]; j++) {
+            w_cat[j] = w[j] / F->scale[j];
+            c0 -= w[j] * F->shift[j] / F->scale[j];
+        }
+    }
+    return c0;
+}
+
+// Apply the deferred shift/scale to one hot gradient entries;
+// sum_coef is the sum of every coef passed to features_axpy
+void features_grad_finish(const FeatureStore *F, double *grad, double sum_coef) {
+    for (int k = 0; k < F->n_cat; k++) {
+        for (int j = F->cat_start[k]; j < F->cat_start[k] + F->cat_size[k]; j++)
+            grad[j] = (grad[j] - F->shift[j] * sum_coef) / F->scale[j];
+    }
+}
+
+// Write row i as the standardized one hot row it stands for (cols values)
+void features_densify_row(const FeatureStore *F, int i, double *out) {
+    const feat_t *x = features_num(F, i);
+    const int *code = features_codes(F, i);
+
+    for (int k = 0; k < F->n_num; k++) out[F->num_cols[k]] = x[k];
+    for (int k = 0; k < F->n_cat; k++) {
+        for (int j = F->cat_start[k]; j < F->cat_start[k] + F->cat_size[k]; j++)
+            out[j] = -F->shift[j] / F->scale[j];
+        if (code[k] >= 0) out[code[k]] = (1.0 - F->shift[code[k]]) / F->scale[code[k]];
+    }
+}
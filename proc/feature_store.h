@@ -0,0 +1,47 @@
+// FILE: feature_store.h
+
+#ifndef FEATURE_STORE_H
+#define FEATURE_STORE_H
+
+#include <stddef.h>
+#include "data_types.h"
+
+void features_from_frame(const Frame *X, const EncodingInfo *encoding_info,
+                         FeatureStore *F);
+void features_standardize(FeatureStore *F, const Stats *S);
+void features_free(FeatureStore *F);
+
+double features_dot_prepare(const FeatureStore *F, const double *w, double *w_cat);
+void features_grad_finish(const FeatureStore *F, double *grad, double sum_coef);
+void features_densify_row(const FeatureStore *F, int i, double *out);
+
+static inline const feat_t *features_num(const FeatureStore *F, int i) {
+    return F->num + (size_t)i * F->n_num;
+}
+
+static inline const int *features_codes(const FeatureStore *F, int i) {
+    return F->codes + (size_t)i * F->n_cat;
+}
+
+// w . x_i in the standardized one hot space; w_cat/c0 come from features_dot_prepare
+static inline double features_dot(const FeatureStore *F, int i, const double *w,
+                                  const double *w_cat, double c0) {
+    const feat_t *x = features_num(F, i);
+    const int *code = features_codes(F, i);
+    double s = c0;
+    for (int k = 0; k < F->n_num; k++) s += x[k] * w[F->num_cols[k]];
+    for (int k = 0; k < F->n_cat; k++)
+        if (code[k] >= 0) s += w_cat[code[k]];
+    return s;
+}
+
+// grad += coef * x_i, with one hot columns left raw until features_grad_finish
+static inline void features_axpy(const FeatureStore *F, int i, double coef, double *grad) {
+    const feat_t *x = features_num(F, i);
+    const int *code = features_codes(F, i);
+    for (int k = 0; k < F->n_num; k++) grad[F->num_cols[k]] += coef * x[k];
+    for (int k = 0; k < F->n_cat; k++)
+        if (code[k] >= 0) grad[code[k]] += coef;
+}
+
+#endif
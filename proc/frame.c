@@ -0,0 +1,53 @@
+// FILE: frame.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "frame.h"
+
+// Allocate a zeroed rows x cols frame on the heap
+void frame_init(Frame *X, int rows, int cols) {
+    X->rows = rows;
+    X->cols = cols;
+    X->data = calloc((size_t)(rows > 0 ? rows : 1) * (cols > 0 ? cols : 1), sizeof(double));
+    X->colnames = calloc(cols > 0 ? cols : 1, sizeof(*X->colnames));
+    X->index = NULL;
+    X->mapping = NULL;
+    X->mapping_size = 0;
+    if (!X->data || !X->colnames) {
+        fprintf(stderr, "Error: Out of memory allocating %d x %d frame\n", rows, cols);
+        exit(1);
+    }
+}
+
+// Frame over rows[0, n) of X without copying: data and colnames are shared,
+// so X (which must not be a view itself) and rows must outlive the view
+void frame_view(const Frame *X, const int *rows, int n, Frame *out) {
+    if (X->index) {
+        fprintf(stderr, "Error: Cannot take a view of a frame view\n");
+        exit(1);
+    }
+    out->data = X->data;
+    out->colnames = X->colnames;
+    out->rows = n;
+    out->cols = X->cols;
+    out->index = rows;
+    out->mapping = NULL;
+    out->mapping_size = 0;
+}
+
+// Views only forget what they borrowed
+void frame_free(Frame *X) {
+    if (X->mapping) {
+        munmap(X->mapping, X->mapping_size);
+    } else if (!X->index) {
+        free(X->data);
+        free(X->colnames);
+    }
+    X->index = NULL;
+    X->mapping = NULL;
+    X->mapping_size = 0;
+    X->data = NULL;
+    X->colnames = NULL;
+    X->rows = X->cols = 0;
+}
@@ -0,0 +1,19 @@
+// FILE: frame.h
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include "data_types.h"
+
+void frame_init(Frame *X, int rows, int cols);
+void frame_view(const Frame *X, const int *rows, int n, Frame *out);
+void frame_free(Frame *X);
+
+// Pointer to the first value of row i (each row is contiguous, cols wide)
+static inline double *frame_row(const Frame *X, int i) {
+    size_t r = X->index ? (size_t)X->index[i] : (size_t)i;
+    return X->data + r * X->cols;
+}
+
+#endif
@@ -0,0 +1,101 @@
+// FILE: gradient.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gradient.h"
+#include "feature_store.h"
+#include "parallel.h"
+
+// Sigmoid activation
+double sigmoid(double z) {
+    if (z < -500) z = -500; // avoid overflow
+    if (z > 500) z = 500;
+    return 1.0 / (1.0 + exp(-z));
+}
+
+// d loss / d z for one row, adding the row's loss to *loss
+static inline double row_error(double z, double y, Link link, double *loss) {
+    if (link == LINK_LOGISTIC) {
+        double p = sigmoid(z);
+        *loss -= y > 0.5 ? log(p + 1e-15) : log(1.0 - p + 1e-15);
+        return p - y;
+    }
+    double err = z - y;
+    *loss += 0.5 * err * err;
+    return err;
+}
+
+typedef struct {
+    GradEngine *g;
+    const FeatureStore *F;
+    const int *rows;  // NULL: rows 0..m-1
+    const double *y;
+    Link link;
+    const double *w;
+    double b;
+    double c0;
+} GradJob;
+
+static void fs_task(void *ctx, int task, int begin, int end) {
+    GradJob *job = ctx;
+    int d = job->g->d;
+    double *acc = job->g->acc + (size_t)task * (d + 2);
+    memset(acc, 0, (d + 2) * sizeof(double));
+
+    for (int k = begin; k < end; k++) {
+        int i = job->rows ? job->rows[k] : k;
+        double z = job->b + features_dot(job->F, i, job->w, job->g->w_cat, job->c0);
+        double err = row_error(z, job->y[i], job->link, &acc[d + 1]);
+        acc[d] += err;
+        features_axpy(job->F, i, err, acc);
+    }
+}
+
+// Sum the chunk accumulators of a pass over m rows in chunk order; returns the mean loss
+static double reduce(GradEngine *g, int m, double *grad_w, double *grad_b) {
+    int d = g->d;
+    double loss = 0.0;
+    *grad_b = 0.0;
+    for (int j = 0; j < d; j++) grad_w[j] = 0.0;
+
+    for (int t = 0; t < parallel_tasks(m); t++) {
+        const double *acc = g->acc + (size_t)t * (d + 2);
+        for (int j = 0; j < d; j++) grad_w[j] += acc[j];
+        *grad_b += acc[d];
+        loss += acc[d + 1];
+    }
+    return loss / m;
+}
+
+void grad_engine_init(GradEngine *g, int n, int d) {
+    g->d = d;
+    g->tasks = parallel_tasks(n);
+    g->acc = malloc((size_t)g->tasks * (d + 2) * sizeof(double));
+    g->w_cat = calloc(d > 0 ? d : 1, sizeof(double));
+    if (!g->acc || !g->w_cat) {
+        fprintf(stderr, "Error: Out of memory for gradient buffers\n");
+        exit(1);
+    }
+}
+
+void grad_engine_free(GradEngine *g) {
+    free(g->acc);
+    free(g->w_cat);
+    g->acc = g->w_cat = NULL;
+}
+
+// Summed (not averaged) gradients over the m rows listed in rows (every row
+// of F when rows is NULL, m ignored); returns the mean loss over those rows
+double grad_fs(GradEngine *g, const FeatureStore *F, const int *rows, int m,
+               const double *y, Link link, const double *w, double b,
+               double *grad_w, double *grad_b) {
+    if (!rows) m = F->rows;
+    GradJob job = { g, F, rows, y, link, w, b, 0.0 };
+    job.c0 = features_dot_prepare(F, w, g->w_cat);
+    parallel_for(m, fs_task, &job);
+    double loss = reduce(g, m, grad_w, grad_b);
+    features_grad_finish(F, grad_w, *grad_b);
+    return loss;
+}
@@ -0,0 +1,29 @@
+// FILE: gradient.h
+
+#ifndef GRADIENT_H
+#define GRADIENT_H
+
+#include "data_types.h"
+
+typedef enum { LINK_IDENTITY, LINK_LOGISTIC } Link;
+
+// Full batch gradient of a GLM loss (squared error for LINK_IDENTITY, log
+// loss for LINK_LOGISTIC). Rows are split across the parallel pool with one
+// accumulator per chunk, summed in chunk order, so a fixed thread count
+// always gives the same bits.
+typedef struct {
+    int d;
+    int tasks;     // chunks allocated for (a full pass over n rows)
+    double *acc;   // tasks x (d + 2): grad_w, grad_b, loss
+    double *w_cat; // feature store weights with one hot scale folded in
+} GradEngine;
+
+double sigmoid(double z);
+
+void grad_engine_init(GradEngine *g, int n, int d);
+void grad_engine_free(GradEngine *g);
+double grad_fs(GradEngine *g, const FeatureStore *F, const int *rows, int m,
+               const double *y, Link link, const double *w, double b,
+               double *grad_w, double *grad_b);
+
+#endif
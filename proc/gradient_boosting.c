@@ -0,0 +1,460 @@
+// FILE: gradient_boosting.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gradient_boosting.h"
+#include "decision_tree.h"
+#include "gradient.h"
+#include "frame.h"
+#include "parallel.h"
+#include "rng.h"
+
+void gbm_default_options(GbmOptions *o, GbmLoss loss) {
+    o->loss = loss;
+    o->max_iter = 200;
+    o->learning_rate = 0.1;
+    o->max_depth = 6;
+    o->min_samples_leaf = 20;
+    o->l2 = 1.0;
+    o->n_bins = 64;
+    o->validation_fraction = 0.1;
+    o->n_iter_no_change = 10;
+    o->tol = 1e-7;
+    o->seed = 42;
+}
+
+static void *gbm_alloc(void *p, size_t n, size_t size) {
+    p = realloc(p, (n ? n : 1) * size);
+    if (!p) {
+        fprintf(stderr, "Error: Out of memory for gradient boosting\n");
+        exit(1);
+    }
+    return p;
+}
+
+static int new_node(GbmModel *M) {
+    if (M->n_nodes == M->cap_nodes) {
+        int cap = M->cap_nodes ? M->cap_nodes * 2 : 256;
+        M->feature = gbm_alloc(M->feature, cap, sizeof(int));
+        M->threshold = gbm_alloc(M->threshold, cap, sizeof(double));
+        M->child = gbm_alloc(M->child, cap, sizeof(int));
+        M->value = gbm_alloc(M->value, cap, sizeof(double));
+        M->cap_nodes = cap;
+    }
+    return M->n_nodes++;
+}
+
+static void set_leaf(GbmModel *M, int k, double value) {
+    M->feature[k] = 0;
+    M->threshold[k] = INFINITY;
+    M->child[k] = k;
+    M->value[k] = value;
+}
+
+// Leaf value tree t gives row x
+static inline double tree_value(const GbmModel *M, int t, const double *x) {
+    int k = M->root[t];
+    for (int level = 0; level < M->depth[t]; level++)
+        k = M->child[k] + (x[M->feature[k]] > M->threshold[k]);
+    return M->value[k];
+}
+
+// Loss of one row: squared error, or log loss log(1 + e^raw) - y raw
+static double row_loss(GbmLoss loss, double y, double raw) {
+    if (loss == GBM_SQUARED) {
+        double e = raw - y;
+        return e * e;
+    }
+    return (raw > 0.0 ? raw + log1p(exp(-raw)) : log1p(exp(raw))) - y * raw;
+}
+
+// State of one boosting run. Histograms hold (gradient sum, hessian sum,
+// row count) per (feature, bin), hist[(j * n_bins + b) * 3 + field].
+typedef struct {
+    const TreeBins *B;
+    const GbmOptions *opts;
+    const double *y;
+    double *raw;         // current raw score of every row
+    double *grad;
+    double *hess;
+    int *rows;           // training rows, partitioned in place per tree
+    int n_rows;
+    size_t hist_len;
+    double *task_hist;   // one histogram per parallel task
+} GbmBuild;
+
+static double *new_hist(const GbmBuild *T) {
+    return gbm_alloc(NULL, T->hist_len, sizeof(double));
+}
+
+static void scan_rows(const GbmBuild *T, int begin, int end, double *hist) {
+    int d = T->B->d, nb = T->B->n_bins;
+    memset(hist, 0, T->hist_len * sizeof(double));
+    for (int r = begin; r < end; r++) {
+        int i = T->rows[r];
+        const unsigned char *code = T->B->codes + (size_t)i * d;
+        double g = T->grad[i], h = T->hess[i];
+        for (int j = 0; j < d; j++) {
+            double *e = hist + ((size_t)j * nb + code[j]) * 3;
+            e[0] += g;
+            e[1] += h;
+            e[2] += 1.0;
+        }
+    }
+}
+
+typedef struct {
+    const GbmBuild *T;
+    int begin;           // first row slot of the node
+    int tasks;           // chunks of the row pass
+    double *hist;
+} HistJob;
+
+// Row pass: each chunk fills its own histogram
+static void hist_task(void *ctx, int task, int begin, int end) {
+    HistJob *job = ctx;
+    scan_rows(job->T, job->begin + begin, job->begin + end,
+              job->T->task_hist + (size_t)task * job->T->hist_len);
+}
+
+// Feature pass: sum the chunk histograms of features [begin, end) in task
+// order, so a fixed thread count always gives the same bits
+static void reduce_task(void *ctx, int task, int begin, int end) {
+    HistJob *job = ctx;
+    size_t width = (size_t)job->T->B->n_bins * 3;
+    (void)task;
+    for (size_t q = begin * width; q < end * width; q++) {
+        double s = 0.0;
+        for (int t = 0; t < job->tasks; t++) s += job->T->task_hist[(size_t)t * job->T->hist_len + q];
+        job->hist[q] = s;
+    }
+}
+
+// Histogram of rows[begin, end): split across threads by rows, then merged
+// across threads by features. Small nodes are scanned inline.
+static void node_histogram(const GbmBuild *T, int begin, int end, double *hist) {
+    int n = end - begin;
+    int tasks = parallel_tasks(n);
+    if (n < GBM_PARALLEL_ROWS || tasks == 1) {
+        scan_rows(T, begin, end, hist);
+        return;
+    }
+    HistJob job = { T, begin, tasks, hist };
+    parallel_for(n, hist_task, &job);
+    parallel_for(T->B->d, reduce_task, &job);
+}
+
+typedef struct {
+    int feature;
+    int bin;             // rows with code <= bin go left
+    double gain;
+    double G_left, H_left;
+    int n_left;
+} Split;
+
+// Best split by the second order gain G_L^2/(H_L + l2) + G_R^2/(H_R + l2)
+// - G^2/(H + l2), honouring min_samples_leaf and GBM_MIN_HESSIAN
+static Split best_split(const GbmBuild *T, const double *hist, double G, double H, int n) {
+    Split s = { -1, -1, 0.0, 0.0, 0.0, 0 };
+    int nb = T->B->n_bins, min_leaf = T->opts->min_samples_leaf;
+    double l2 = T->opts->l2;
+    double parent = G * G / (H + l2);
+
+    for (int j = 0; j < T->B->d; j++) {
+        double gl = 0.0, hl = 0.0;
+        int nl = 0;
+        for (int b = 0; b < T->B->n_thresholds[j]; b++) {
+            const double *e = hist + ((size_t)j * nb + b) * 3;
+            gl += e[0];
+            hl += e[1];
+            nl += (int)e[2];
+            if (nl < min_leaf || hl < GBM_MIN_HESSIAN) continue;
+            if (n - nl < min_leaf || H - hl < GBM_MIN_HESSIAN) break;
+            double gr = G - gl, hr = H - hl;
+            double gain = gl * gl / (hl + l2) + gr * gr / (hr + l2) - parent;
+            if (gain > s.gain) {
+                s.feature = j;
+                s.bin = b;
+                s.gain = gain;
+                s.G_left = gl;
+                s.H_left = hl;
+                s.n_left = nl;
+            }
+        }
+    }
+    return s;
+}
+
+// A node waiting on the current level: rows[begin, end), its pool slot, its
+// gradient and hessian sums, and its histogram (NULL when it cannot split)
+typedef struct {
+    int begin, end;
+    int node;
+    double G, H;
+    double *hist;
+} Grow;
+
+static int can_split(const GbmBuild *T, int n, int depth) {
+    return depth < T->opts->max_depth && n >= 2 * T->opts->min_samples_leaf;
+}
+
+// Grow one tree level by level. Each level's children are appended in the
+// order of their parents, so the pool comes out breadth first with siblings
+// adjacent. A leaf adds its value to the raw score of its training rows.
+static void grow_tree(GbmModel *M, GbmBuild *T) {
+    int d = T->B->d, nb = T->B->n_bins;
+    double lr = T->opts->learning_rate, l2 = T->opts->l2;
+    int n = T->n_rows;
+    int cap = n > 0 ? n : 1;
+    Grow *level = gbm_alloc(NULL, cap, sizeof(Grow));
+    Grow *next = gbm_alloc(NULL, cap, sizeof(Grow));
+
+    if (M->n_trees == M->cap_trees) {
+        M->cap_trees = M->cap_trees ? M->cap_trees * 2 : 64;
+        M->root = gbm_alloc(M->root, M->cap_trees, sizeof(int));
+        M->depth = gbm_alloc(M->depth, M->cap_trees, sizeof(int));
+    }
+    int t = M->n_trees++;
+    M->root[t] = new_node(M);
+    M->depth[t] = 0;
+
+    Grow root = { 0, n, M->root[t], 0.0, 0.0, NULL };
+    for (int r = 0; r < n; r++) {
+        root.G += T->grad[T->rows[r]];
+        root.H += T->hess[T->rows[r]];
+    }
+    if (can_split(T, n, 0)) {
+        root.hist = new_hist(T);
+        node_histogram(T, 0, n, root.hist);
+    }
+    level[0] = root;
+    int n_level = 1;
+
+    for (int depth = 0; n_level > 0; depth++) {
+        int n_next = 0;
+        for (int q = 0; q < n_level; q++) {
+            Grow g = level[q];
+            Split s = { -1, -1, 0.0, 0.0, 0.0, 0 };
+            if (g.hist) s = best_split(T, g.hist, g.G, g.H, g.end - g.begin);
+
+            if (s.feature < 0) {
+                double value = -lr * g.G / (g.H + l2);
+                set_leaf(M, g.node, value);
+                for (int r = g.begin; r < g.end; r++) T->raw[T->rows[r]] += value;
+                free(g.hist);
+                continue;
+            }
+
+            // partition the slice: codes <= bin first
+            int lo = g.begin, hi = g.end - 1;
+            while (lo <= hi) {
+                if (T->B->codes[(size_t)T->rows[lo] * d + s.feature] <= s.bin) {
+                    lo++;
+                } else {
+                    int tmp = T->rows[lo]; T->rows[lo] = T->rows[hi]; T->rows[hi--] = tmp;
+                }
+            }
+            int mid = lo;
+
+            int c = new_node(M);
+            new_node(M);
+            M->feature[g.node] = s.feature;
+            M->threshold[g.node] = T->B->thresholds[(size_t)s.feature * (nb - 1) + s.bin];
+            M->child[g.node] = c;
+            M->value[g.node] = 0.0;
+            M->depth[t] = depth + 1;
+
+            Grow left = { g.begin, mid, c, s.G_left, s.H_left, NULL };
+            Grow right = { mid, g.end, c + 1, g.G - s.G_left, g.H - s.H_left, NULL };
+            int need_l = can_split(T, mid - g.begin, depth + 1);
+            int need_r = can_split(T, g.end - mid, depth + 1);
+
+            // scan the smaller child, the larger one is the parent minus it
+            if (need_l && need_r) {
+                Grow *small = mid - g.begin <= g.end - mid ? &left : &right;
+                Grow *big = small == &left ? &right : &left;
+                small->hist = new_hist(T);
+                node_histogram(T, small->begin, small->end, small->hist);
+                for (size_t k = 0; k < T->hist_len; k++) g.hist[k] -= small->hist[k];
+                big->hist = g.hist;
+            } else if (need_l || need_r) {
+                Grow *only = need_l ? &left : &right;
+                only->hist = g.hist;
+                node_histogram(T, only->begin, only->end, only->hist);
+            } else {
+                free(g.hist);
+            }
+            next[n_next++] = left;
+            next[n_next++] = right;
+        }
+
+        Grow *swap = level; level = next; next = swap;
+        n_level = n_next;
+    }
+
+    free(level);
+    free(next);
+}
+
+typedef struct {
+    GbmBuild *T;
+} GradJob;
+
+static void grad_task(void *ctx, int task, int begin, int end) {
+    GbmBuild *T = ((GradJob *)ctx)->T;
+    (void)task;
+    for (int r = begin; r < end; r++) {
+        int i = T->rows[r];
+        if (T->opts->loss == GBM_SQUARED) {
+            T->grad[i] = T->raw[i] - T->y[i];
+            T->hess[i] = 1.0;
+        } else {
+            double p = sigmoid(T->raw[i]);
+            T->grad[i] = p - T->y[i];
+            T->hess[i] = p * (1.0 - p);
+        }
+    }
+}
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Boost up to max_iter trees on X. A random validation_fraction of the rows
+// is held out; once its loss has not dropped by tol for n_iter_no_change
+// rounds, training stops and the model is cut back to its best round.
+// report gets the trees kept, the best validation (or last training) loss
+// and whether early stopping fired.
+void gbm_fit(GbmModel *M, Frame *X, const double *y, const GbmOptions *opts,
+             FitReport *report) {
+    memset(M, 0, sizeof(*M));
+    M->loss = opts->loss;
+    int n = X->rows;
+
+    int *order = gbm_alloc(NULL, n, sizeof(int));
+    for (int i = 0; i < n; i++) order[i] = i;
+    int n_val = opts->validation_fraction > 0.0 ? (int)(n * opts->validation_fraction) : 0;
+    if (n_val < 1 || n - n_val < 2) n_val = 0;
+    if (n_val > 0) {
+        Rng r;
+        rng_seed(&r, opts->seed);
+        rng_shuffle(&r, order, n);
+    }
+    const int *val = order;
+    int *rows = order + n_val;
+    int n_train = n - n_val;
+    qsort(rows, n_train, sizeof(int), cmp_int); // row order keeps code reads sequential
+
+    double mean = 0.0;
+    for (int r = 0; r < n_train; r++) mean += y[rows[r]];
+    mean = n_train > 0 ? mean / n_train : 0.0;
+    if (opts->loss == GBM_LOGISTIC) {
+        if (mean < 1e-6) mean = 1e-6;
+        if (mean > 1.0 - 1e-6) mean = 1.0 - 1e-6;
+        M->base_score = log(mean / (1.0 - mean));
+    } else {
+        M->base_score = mean;
+    }
+
+    TreeBins B;
+    tree_bins_build(&B, X, opts->n_bins);
+    GbmBuild T = { &B, opts, y, gbm_alloc(NULL, n, sizeof(double)),
+                   gbm_alloc(NULL, n, sizeof(double)), gbm_alloc(NULL, n, sizeof(double)),
+                   rows, n_train, (size_t)B.d * B.n_bins * 3, NULL };
+    T.task_hist = gbm_alloc(NULL, (size_t)parallel_threads() * T.hist_len, sizeof(double));
+    for (int i = 0; i < n; i++) T.raw[i] = M->base_score;
+
+    double best = INFINITY, loss = INFINITY;
+    int best_trees = 0, since = 0, stopped = 0;
+    GradJob job = { &T };
+    for (int it = 0; it < opts->max_iter; it++) {
+        parallel_for(n_train, grad_task, &job);
+        grow_tree(M, &T);
+
+        int t = M->n_trees - 1;
+        loss = 0.0;
+        if (n_val > 0) {
+            for (int v = 0; v < n_val; v++) {
+                int i = val[v];
+                T.raw[i] += tree_value(M, t, frame_row(X, i));
+                loss += row_loss(opts->loss, y[i], T.raw[i]);
+            }
+            loss /= n_val;
+        } else {
+            for (int r = 0; r < n_train; r++) loss += row_loss(opts->loss, y[rows[r]], T.raw[rows[r]]);
+            loss /= (n_train > 0 ? n_train : 1);
+        }
+
+        if (loss < best - opts->tol) {
+            best = loss;
+            best_trees = M->n_trees;
+            since = 0;
+        } else if (n_val > 0 && ++since >= opts->n_iter_no_change) {
+            stopped = 1;
+            break;
+        }
+    }
+
+    if (n_val > 0 && best_trees < M->n_trees) {
+        M->n_nodes = M->root[best_trees];
+        M->n_trees = best_trees;
+    }
+    if (report) {
+        report->iterations = M->n_trees;
+        report->loss = n_val > 0 ? best : loss;
+        report->converged = stopped;
+    }
+
+    free(T.raw);
+    free(T.grad);
+    free(T.hess);
+    free(T.task_hist);
+    free(order);
+    tree_bins_free(&B);
+}
+
+typedef struct {
+    const GbmModel *M;
+    const Frame *X;
+    double *raw;
+    int *labels;
+} PredictJob;
+
+static void predict_task(void *ctx, int task, int begin, int end) {
+    PredictJob *job = ctx;
+    const GbmModel *M = job->M;
+    (void)task;
+    for (int i = begin; i < end; i++) {
+        const double *x = frame_row(job->X, i);
+        double s = M->base_score;
+        for (int t = 0; t < M->n_trees; t++) s += tree_value(M, t, x);
+        if (job->raw) job->raw[i] = s;
+        if (job->labels)
+            job->labels[i] = M->loss == GBM_LOGISTIC ? (s >= 0.0) : (int)lround(s);
+    }
+}
+
+// Raw scores: predictions for GBM_SQUARED, logits for GBM_LOGISTIC
+void gbm_predict_raw(const GbmModel *M, Frame *X, double *out) {
+    PredictJob job = { M, X, out, NULL };
+    parallel_for(X->rows, predict_task, &job);
+}
+
+// 0/1 labels for GBM_LOGISTIC (logit >= 0), rounded scores for GBM_SQUARED
+void gbm_predict(const GbmModel *M, Frame *X, int *out) {
+    PredictJob job = { M, X, NULL, out };
+    parallel_for(X->rows, predict_task, &job);
+}
+
+void gbm_free(GbmModel *M) {
+    free(M->root);
+    free(M->depth);
+    free(M->feature);
+    free(M->threshold);
+    free(M->child);
+    free(M->value);
+    memset(M, 0, sizeof(*M));
+}
@@ -0,0 +1,18 @@
+// FILE: gradient_boosting.h
+
+#ifndef GRADIENT_BOOSTING_H
+#define GRADIENT_BOOSTING_H
+
+#include "data_types.h"
+
+#define GBM_MIN_HESSIAN 1e-3     // smallest hessian sum a leaf may have
+#define GBM_PARALLEL_ROWS 4096   // nodes this small build histograms inline
+
+void gbm_default_options(GbmOptions *o, GbmLoss loss);
+void gbm_fit(GbmModel *M, Frame *X, const double *y, const GbmOptions *opts,
+             FitReport *report);
+void gbm_predict_raw(const GbmModel *M, Frame *X, double *out);
+void gbm_predict(const GbmModel *M, Frame *X, int *out);
+void gbm_free(GbmModel *M);
+
+#endif
@@ -1,176 +1,440 @@
-// FILE: knn.c
-
-#include <stdlib.h>
-#include <math.h>
-#include "knn.h"
-
-static double euclidean_distance(double *a, double *b, int d) {
-    double s = 0.0;
-    // Sum the squared differences for each dimension
-    for (int i = 0; i < d; i++) {
-        double v = a[i] - b[i];
-        s += v * v;
-    }
-    // Return the square root of the sum
-    return sqrt(s);
-}
-
-
-static double manhattan_distance(double *a, double *b, int d) {
-    double s = 0.0;
-    // Sum the absolute differences for each dimension
-    for (int i = 0; i < d; i++) {
-        double v = a[i] - b[i];
-        s += (v >= 0 ? v : -v);
-    }
-    return s;
-}
-
-
-void knn_predict(Frame *Xtr, int *ytr, Frame *Xte, int k,
-                 int use_euclidean, int weighted, int tie_smallest,
-                 double eps, int max_train_samples, int *pred_out) {
-    int n_train = Xtr->rows;
-    int n_test = Xte->rows;
-    int d = Xtr->cols;
-    
-    // Use sampling if max_train_samples is less than total training data
-    int actual_train = (max_train_samples > 0 && max_train_samples < n_train) 
-                       ? max_train_samples : n_train;
-    
-    // Process each test sample
-    for (int t = 0; t < n_test; t++) {
-        // Allocate memory for distances and sample indices
-        double *dist = malloc(actual_train * sizeof(double));
-        int *sampled_idx = malloc(actual_train * sizeof(int));
-        
-        // Sample training points if needed
-        if (actual_train < n_train) {
-            // Random sampling with replacement
-            for (int i = 0; i < actual_train; i++) {
-                sampled_idx[i] = rand() % n_train;
-            }
-        } else {
-            // Use all training points
-            for (int i = 0; i < actual_train; i++) {
-                sampled_idx[i] = i;
-            }
-        }
-        
-        // Compute distances for sampled points
-        for (int i = 0; i < actual_train; i++) {
-            if (use_euclidean)
-                dist[i] = euclidean_distance(Xte->data[t], Xtr->data[sampled_idx[i]], d);
-            else
-                dist[i] = manhattan_distance(Xte->data[t], Xtr->data[sampled_idx[i]], d);
-        }
-
-        // Initialize index array for sorting
-        int *idx = malloc(actual_train * sizeof(int));
-        for (int i = 0; i < actual_train; i++) idx[i] = i;
-
-        // Find k nearest neighbors using selection sort
-        int effective_k = (k < actual_train) ? k : actual_train;
-        for (int i = 0; i < effective_k; i++) {
-            // Find the minimum distance in the remaining unsorted portion
-            int min_idx = i;
-            for (int j = i + 1; j < actual_train; j++) {
-                if (dist[j] < dist[min_idx]) {
-                    min_idx = j;
-                }
-            }
-            // Swap to place minimum at position i
-            if (min_idx != i) {
-                double td = dist[i]; dist[i] = dist[min_idx]; dist[min_idx] = td;
-                int ti = idx[i]; idx[i] = idx[min_idx]; idx[min_idx] = ti;
-            }
-        }
-
-        // Extract labels and distances for k nearest neighbors
-        int *labels = malloc(effective_k * sizeof(int));
-        double *dists = malloc(effective_k * sizeof(double));
-        for (int i = 0; i < effective_k; i++) {
-            labels[i] = ytr[sampled_idx[idx[i]]];
-            dists[i] = dist[idx[i]];
-        }
-
-        // Find unique labels among k nearest neighbors
-        int unique[1000];
-        int unique_count = 0;
-        for (int i = 0; i < effective_k; i++) {
-            int exists = 0;
-            for (int j = 0; j < unique_count; j++)
-                if (unique[j] == labels[i]) { exists = 1; break; }
-            if (!exists) unique[unique_count++] = labels[i];
-        }
-
-        // Calculate scores for each unique label
-        double *scores = calloc(unique_count, sizeof(double));
-
-        if (weighted) {
-            // Weighted voting: closer neighbors have more influence
-            for (int i = 0; i < effective_k; i++) {
-                double w = 1.0 / (dists[i] + eps);
-                for (int j = 0; j < unique_count; j++)
-                    if (labels[i] == unique[j]) scores[j] += w;
-            }
-        } else {
-            // Uniform voting: each neighbor has equal weight
-            for (int i = 0; i < effective_k; i++) {
-                for (int j = 0; j < unique_count; j++)
-                    if (labels[i] == unique[j]) scores[j] += 1.0;
-            }
-        }
-
-        // Find the label(s) with maximum score
-        double maxv = scores[0];
-        int max_indices[1000];
-        int mcount = 1;
-        max_indices[0] = 0;
-
-        for (int j = 1; j < unique_count; j++) {
-            if (scores[j] > maxv) {
-                // New maximum found
-                maxv = scores[j];
-                mcount = 1;
-                max_indices[0] = j;
-            } else if (scores[j] == maxv) {
-                // Tie with current maximum
-                max_indices[mcount++] = j;
-            }
-        }
-
-        // Handle ties and select final prediction
-        int chosen;
-        if (mcount == 1) {
-            // No tie, choose the only maximum
-            chosen = unique[max_indices[0]];
-        } else {
-            // Multiple labels tied for maximum
-            if (tie_smallest) {
-                // Break tie by choosing smallest label
-                int min_label = unique[max_indices[0]];
-                for (int i = 1; i < mcount; i++) {
-                    int lab = unique[max_indices[i]];
-                    if (lab < min_label) min_label = lab;
-                }
-                chosen = min_label;
-            } else {
-                // Break tie randomly
-                int r = rand() % mcount;
-                chosen = unique[max_indices[r]];
-            }
-        }
-
-        // Store prediction for this test sample
-        pred_out[t] = chosen;
-
-        // Free allocated memory for this test sample
-        free(dist);
-        free(idx);
-        free(sampled_idx);
-        free(labels);
-        free(dists);
-        free(scores);
-    }
-}
+// FILE: knn.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "knn.h"
+#include "frame.h"
+#include "feature_store.h"
+#include "knn_heap.h"
+#include "ball_tree.h"
+#include "parallel.h"
+#include "rng.h"
+
+// Vote on the labels of the chosen neighbours (ordered nearest first)
+static int vote_labels(const int *labels, const double *dists, int n_nb,
+                       int weighted, int tie_smallest, double eps, Rng *rng) {
+    // Find unique labels among k nearest neighbors
+    int unique[1000];
+    int unique_count = 0;
+    for (int i = 0; i < n_nb; i++) {
+        int exists = 0;
+        for (int j = 0; j < unique_count; j++)
+            if (unique[j] == labels[i]) { exists = 1; break; }
+        if (!exists) unique[unique_count++] = labels[i];
+    }
+
+    // Calculate scores for each unique label
+    double scores[1000] = {0};
+
+    if (weighted) {
+        // Weighted voting: closer neighbors have more influence
+        for (int i = 0; i < n_nb; i++) {
+            double w = 1.0 / (dists[i] + eps);
+            for (int j = 0; j < unique_count; j++)
+                if (labels[i] == unique[j]) scores[j] += w;
+        }
+    } else {
+        // Uniform voting: each neighbor has equal weight
+        for (int i = 0; i < n_nb; i++) {
+            for (int j = 0; j < unique_count; j++)
+                if (labels[i] == unique[j]) scores[j] += 1.0;
+        }
+    }
+
+    // Find the label(s) with maximum score
+    double maxv = scores[0];
+    int max_indices[1000];
+    int mcount = 1;
+    max_indices[0] = 0;
+
+    for (int j = 1; j < unique_count; j++) {
+        if (scores[j] > maxv) {
+            // New maximum found
+            maxv = scores[j];
+            mcount = 1;
+            max_indices[0] = j;
+        } else if (scores[j] == maxv) {
+            // Tie with current maximum
+            max_indices[mcount++] = j;
+        }
+    }
+
+    // Handle ties and select final prediction
+    int chosen;
+    if (mcount == 1) {
+        // No tie, choose the only maximum
+        chosen = unique[max_indices[0]];
+    } else {
+        // Multiple labels tied for maximum
+        if (tie_smallest) {
+            // Break tie by choosing smallest label
+            int min_label = unique[max_indices[0]];
+            for (int i = 1; i < mcount; i++) {
+                int lab = unique[max_indices[i]];
+                if (lab < min_label) min_label = lab;
+            }
+            chosen = min_label;
+        } else {
+            // Break tie randomly
+            int r = rng_below(rng, mcount);
+            chosen = unique[max_indices[r]];
+        }
+    }
+    return chosen;
+}
+
+// Pick the k nearest of n_cand candidates and vote on their labels. The
+// caller's scratch holds idx (n_cand) and labels/dists (min(k, n_cand)).
+static int knn_vote(double *dist, const int *sampled_idx, int n_cand, const int *ytr,
+                    int k, int weighted, int tie_smallest, double eps, Rng *rng,
+                    int *idx, int *labels, double *dists) {
+    // Initialize index array for sorting
+    for (int i = 0; i < n_cand; i++) idx[i] = i;
+
+    // Find k nearest neighbors using selection sort
+    int effective_k = (k < n_cand) ? k : n_cand;
+    for (int i = 0; i < effective_k; i++) {
+        // Find the minimum distance in the remaining unsorted portion
+        int min_idx = i;
+        for (int j = i + 1; j < n_cand; j++) {
+            if (dist[j] < dist[min_idx]) {
+                min_idx = j;
+            }
+        }
+        // Swap to place minimum at position i
+        if (min_idx != i) {
+            double td = dist[i]; dist[i] = dist[min_idx]; dist[min_idx] = td;
+            int ti = idx[i]; idx[i] = idx[min_idx]; idx[min_idx] = ti;
+        }
+    }
+
+    // Extract labels and distances for k nearest neighbors
+    for (int i = 0; i < effective_k; i++) {
+        labels[i] = ytr[sampled_idx[idx[i]]];
+        dists[i] = dist[i];
+    }
+
+    return vote_labels(labels, dists, effective_k, weighted, tie_smallest, eps, rng);
+}
+
+// Indices of the training rows a query is compared against
+static void sample_train(int *sampled_idx, int actual_train, int n_train, Rng *rng) {
+    if (actual_train < n_train) {
+        // Random sampling with replacement
+        for (int i = 0; i < actual_train; i++) {
+            sampled_idx[i] = rng_below(rng, n_train);
+        }
+    } else {
+        // Use all training points
+        for (int i = 0; i < actual_train; i++) {
+            sampled_idx[i] = i;
+        }
+    }
+}
+
+// Distance between standardized rows a of A and b of B. Within a one hot block
+// rows that share a code contribute 0; otherwise each set flag contributes
+// cat_w[j] (1/scale^2 for euclidean, 1/scale for manhattan).
+static double features_distance(const FeatureStore *A, int a, const FeatureStore *B, int b,
+                                const double *cat_w, int use_euclidean) {
+    const feat_t *xa = features_num(A, a);
+    const feat_t *xb = features_num(B, b);
+    const int *ca = features_codes(A, a);
+    const int *cb = features_codes(B, b);
+    double s = 0.0;
+
+    for (int k = 0; k < A->n_num; k++) {
+        double v = (double)xa[k] - xb[k];
+        s += use_euclidean ? v * v : (v >= 0 ? v : -v);
+    }
+    for (int k = 0; k < A->n_cat; k++) {
+        if (ca[k] == cb[k]) continue;
+        if (ca[k] >= 0) s += cat_w[ca[k]];
+        if (cb[k] >= 0) s += cat_w[cb[k]];
+    }
+    return use_euclidean ? sqrt(s) : s;
+}
+
+
+// Exact search over every training row. Training rows are packed once into
+// column-major tiles of KNN_TILE rows so each query scores a whole tile with
+// contiguous, vectorizable loops: the dense values add their squared (or
+// absolute) differences, one hot blocks add their weight wherever the codes
+// differ. The k best are kept in a max-heap of squared distances, so the only
+// sqrt calls are for the k winners of a weighted vote.
+typedef struct {
+    int n;             // training rows
+    int n_tiles;
+    int width;         // numeric values per row
+    int n_cat;         // one hot blocks
+    int use_euclidean;
+    feat_t *vals;      // per tile: width x KNN_TILE, stored like the feature store
+    int *codes;        // per tile: n_cat x KNN_TILE
+    double *code_w;    // per tile: n_cat x KNN_TILE, cat_w of each code
+} TrainTiles;
+
+// Order the kept neighbours nearest first and vote; sqrt only here
+static int heap_vote(KnnHeap *h, const int *ytr, int use_euclidean, int weighted,
+                     int tie_smallest, double eps, Rng *rng, int *labels, double *dists) {
+    heap_sort(h);
+    for (int a = 0; a < h->count; a++) {
+        labels[a] = ytr[h->idx[a]];
+        dists[a] = weighted && use_euclidean ? sqrt(h->dist[a]) : h->dist[a];
+    }
+    return vote_labels(labels, dists, h->count, weighted, tie_smallest, eps, rng);
+}
+
+static void *knn_alloc(size_t n, size_t size) {
+    void *p = calloc(n ? n : 1, size);
+    if (!p) {
+        fprintf(stderr, "Error: Out of memory for KNN\n");
+        exit(1);
+    }
+    return p;
+}
+
+// Pack the numeric values and codes of the training rows
+static void tiles_build(TrainTiles *T, const FeatureStore *F, const double *cat_w,
+                        int use_euclidean) {
+    T->n = F->rows;
+    T->n_tiles = (T->n + KNN_TILE - 1) / KNN_TILE;
+    T->width = F->n_num;
+    T->n_cat = F->n_cat;
+    T->use_euclidean = use_euclidean;
+
+    size_t slots = (size_t)T->n_tiles * KNN_TILE;
+    T->vals = knn_alloc(slots * T->width, sizeof(feat_t));
+    T->codes = knn_alloc(slots * T->n_cat, sizeof(int));
+    T->code_w = knn_alloc(slots * T->n_cat, sizeof(double));
+
+    for (int i = 0; i < T->n; i++) {
+        int tile = i / KNN_TILE, r = i % KNN_TILE;
+        feat_t *v = T->vals + (size_t)tile * T->width * KNN_TILE;
+        const feat_t *x = features_num(F, i);
+        for (int j = 0; j < T->width; j++) v[(size_t)j * KNN_TILE + r] = x[j];
+
+        const int *code = features_codes(F, i);
+        int *c = T->codes + (size_t)tile * T->n_cat * KNN_TILE;
+        double *w = T->code_w + (size_t)tile * T->n_cat * KNN_TILE;
+        for (int k = 0; k < T->n_cat; k++) {
+            c[(size_t)k * KNN_TILE + r] = code[k];
+            w[(size_t)k * KNN_TILE + r] = code[k] >= 0 ? cat_w[code[k]] : 0.0;
+        }
+    }
+}
+
+static void tiles_free(TrainTiles *T) {
+    free(T->vals);
+    free(T->codes);
+    free(T->code_w);
+}
+
+// Distances (squared for euclidean) from query a to the KNN_TILE rows of a tile
+static void tile_distances(const TrainTiles *T, int tile, const double *a,
+                           const int *a_code, const double *a_w, double *out) {
+    const feat_t *v = T->vals + (size_t)tile * T->width * KNN_TILE;
+    double acc[KNN_TILE] = {0};
+
+    if (T->use_euclidean) {
+        for (int j = 0; j < T->width; j++) {
+            double aj = a[j];
+            const feat_t *col = v + (size_t)j * KNN_TILE;
+            for (int c = 0; c < KNN_TILE; c++) {
+                double diff = aj - col[c];
+                acc[c] += diff * diff;
+            }
+        }
+    } else {
+        for (int j = 0; j < T->width; j++) {
+            double aj = a[j];
+            const feat_t *col = v + (size_t)j * KNN_TILE;
+            for (int c = 0; c < KNN_TILE; c++) acc[c] += fabs(aj - col[c]);
+        }
+    }
+
+    const int *codes = T->codes + (size_t)tile * T->n_cat * KNN_TILE;
+    const double *cw = T->code_w + (size_t)tile * T->n_cat * KNN_TILE;
+    for (int k = 0; k < T->n_cat; k++) {
+        int ac = a_code[k];
+        double aw = a_w[k];
+        const int *ck = codes + (size_t)k * KNN_TILE;
+        const double *wk = cw + (size_t)k * KNN_TILE;
+        for (int c = 0; c < KNN_TILE; c++) acc[c] += (double)(ck[c] != ac) * (aw + wk[c]);
+    }
+
+    for (int c = 0; c < KNN_TILE; c++) out[c] = acc[c];
+}
+
+// One prediction call. Test rows are split across the parallel pool and each
+// row draws its tie breaks (and training sample) from its own seeded stream,
+// so predictions do not depend on the thread count.
+typedef struct {
+    const Frame *Xte;         // ball tree search
+    const FeatureStore *Ftr;
+    const FeatureStore *Fte;
+    const TrainTiles *tiles;  // exact search
+    const BallTree *tree;     // ball tree search
+    const double *cat_w;
+    const int *ytr;
+    int k;
+    int use_euclidean;
+    int weighted;
+    int tie_smallest;
+    double eps;
+    int n_sample;             // sampled search
+    int *pred_out;
+} KnnJob;
+
+// Exact predictions for test rows [begin, end). Queries go KNN_QUERY_BLOCK at
+// a time so each packed tile is reused while it is still in cache; every
+// buffer is allocated once up front.
+static void exact_task(void *ctx, int task, int begin, int end) {
+    KnnJob *job = ctx;
+    const TrainTiles *T = job->tiles;
+    const FeatureStore *Fte = job->Fte;
+    int kk = job->k < T->n ? job->k : T->n;
+    (void)task;
+    double *heap_d = knn_alloc((size_t)KNN_QUERY_BLOCK * kk, sizeof(double));
+    int *heap_i = knn_alloc((size_t)KNN_QUERY_BLOCK * kk, sizeof(int));
+    double *q_w = knn_alloc((size_t)KNN_QUERY_BLOCK * T->n_cat, sizeof(double));
+    double *q_vals = knn_alloc((size_t)KNN_QUERY_BLOCK * T->width, sizeof(double));
+    int *labels = knn_alloc(kk, sizeof(int));
+    double *dists = knn_alloc(kk, sizeof(double));
+    KnnHeap heaps[KNN_QUERY_BLOCK];
+    double dist[KNN_TILE];
+
+    for (int q0 = begin; q0 < end; q0 += KNN_QUERY_BLOCK) {
+        int nq = end - q0 < KNN_QUERY_BLOCK ? end - q0 : KNN_QUERY_BLOCK;
+
+        for (int q = 0; q < nq; q++) {
+            double *a = q_vals + (size_t)q * T->width;
+            const feat_t *x = features_num(Fte, q0 + q);
+            for (int j = 0; j < T->width; j++) a[j] = x[j];
+            for (int c = 0; c < T->n_cat; c++) {
+                int code = features_codes(Fte, q0 + q)[c];
+                q_w[(size_t)q * T->n_cat + c] = code >= 0 ? job->cat_w[code] : 0.0;
+            }
+            heaps[q] = (KnnHeap){ kk, 0, heap_d + (size_t)q * kk, heap_i + (size_t)q * kk };
+        }
+
+        for (int tile = 0; tile < T->n_tiles; tile++) {
+            int base = tile * KNN_TILE;
+            int m = T->n - base < KNN_TILE ? T->n - base : KNN_TILE;
+            for (int q = 0; q < nq; q++) {
+                const double *a = q_vals + (size_t)q * T->width;
+                const int *a_code = T->n_cat ? features_codes(Fte, q0 + q) : NULL;
+                tile_distances(T, tile, a, a_code, q_w + (size_t)q * T->n_cat, dist);
+                for (int c = 0; c < m; c++) heap_push(&heaps[q], dist[c], base + c);
+            }
+        }
+
+        for (int q = 0; q < nq; q++) {
+            Rng rng;
+            rng_stream(&rng, KNN_SEED, q0 + q);
+            job->pred_out[q0 + q] = heap_vote(&heaps[q], job->ytr, T->use_euclidean, job->weighted,
+                                              job->tie_smallest, job->eps, &rng, labels, dists);
+        }
+    }
+
+    free(heap_d);
+    free(heap_i);
+    free(q_w);
+    free(q_vals);
+    free(labels);
+    free(dists);
+}
+
+// Each query compares against n_sample training rows drawn with replacement
+static void sampled_task(void *ctx, int task, int begin, int end) {
+    KnnJob *job = ctx;
+    int n_train = job->Ftr->rows;
+    int m = job->n_sample;
+    int kk = job->k < m ? job->k : m;
+    double *dist = knn_alloc(m, sizeof(double));
+    int *sampled_idx = knn_alloc(m, sizeof(int));
+    int *idx = knn_alloc(m, sizeof(int));
+    int *labels = knn_alloc(kk, sizeof(int));
+    double *dists = knn_alloc(kk, sizeof(double));
+    (void)task;
+
+    for (int t = begin; t < end; t++) {
+        Rng rng;
+        rng_stream(&rng, KNN_SEED, t);
+        sample_train(sampled_idx, m, n_train, &rng);
+
+        // Compute distances for sampled points
+        for (int i = 0; i < m; i++)
+            dist[i] = features_distance(job->Fte, t, job->Ftr, sampled_idx[i],
+                                        job->cat_w, job->use_euclidean);
+
+        job->pred_out[t] = knn_vote(dist, sampled_idx, m, job->ytr, job->k,
+                                    job->weighted, job->tie_smallest, job->eps, &rng,
+                                    idx, labels, dists);
+    }
+
+    free(dist);
+    free(sampled_idx);
+    free(idx);
+    free(labels);
+    free(dists);
+}
+
+static void tree_task(void *ctx, int task, int begin, int end) {
+    KnnJob *job = ctx;
+    const BallTree *T = job->tree;
+    int kk = job->k < T->n ? job->k : T->n;
+    int *nb = knn_alloc(kk, sizeof(int));
+    int *labels = knn_alloc(kk, sizeof(int));
+    double *dists = knn_alloc(kk, sizeof(double));
+    (void)task;
+
+    for (int t = begin; t < end; t++) {
+        Rng rng;
+        rng_stream(&rng, KNN_SEED, t);
+        int found = ball_tree_query(T, frame_row(job->Xte, t), kk, nb, dists);
+        for (int i = 0; i < found; i++) labels[i] = job->ytr[nb[i]];
+        job->pred_out[t] = vote_labels(labels, dists, found, job->weighted,
+                                       job->tie_smallest, job->eps, &rng);
+    }
+
+    free(nb);
+    free(labels);
+    free(dists);
+}
+
+// Label of every test row by its k nearest training rows, from the exact
+// tiled scan or the sampled search
+void knn_predict_fs(FeatureStore *Ftr, int *ytr, FeatureStore *Fte, int k,
+                    int use_euclidean, int weighted, int tie_smallest,
+                    double eps, int max_train_samples, int *pred_out) {
+    int n_train = Ftr->rows;
+    int actual_train = (max_train_samples > 0 && max_train_samples < n_train)
+                       ? max_train_samples : n_train;
+
+    double *cat_w = knn_alloc(Ftr->cols, sizeof(double));
+    for (int j = 0; j < Ftr->cols; j++)
+        cat_w[j] = use_euclidean ? 1.0 / (Ftr->scale[j] * Ftr->scale[j]) : 1.0 / Ftr->scale[j];
+
+    KnnJob job = { NULL, Ftr, Fte, NULL, NULL, cat_w, ytr, k, use_euclidean,
+                   weighted, tie_smallest, eps, actual_train, pred_out };
+    if (actual_train < n_train) {
+        parallel_for(Fte->rows, sampled_task, &job);
+    } else {
+        TrainTiles T;
+        tiles_build(&T, Ftr, cat_w, use_euclidean);
+        job.tiles = &T;
+        parallel_for(Fte->rows, exact_task, &job);
+        tiles_free(&T);
+    }
+    free(cat_w);
+}
+
+// knn_predict_fs against a prebuilt ball tree (its metric decides the
+// distance), so one index can serve any number of test batches
+void knn_predict_tree(const BallTree *T, int *ytr, Frame *Xte, int k,
+                      int weighted, int tie_smallest, double eps, int *pred_out) {
+    KnnJob job = { Xte, NULL, NULL, NULL, T, NULL, ytr, k, T->use_euclidean,
+                   weighted, tie_smallest, eps, 0, pred_out };
+    parallel_for(Xte->rows, tree_task, &job);
+}
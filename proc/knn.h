@@ -1,12 +1,21 @@
-// FILE: knn.h
-
-#ifndef KNN_H
-#define KNN_H
-
-#include "data_types.h"
-
-void knn_predict(Frame *Xtr, int *ytr, Frame *Xte, int k, 
-                 int use_euclidean, int weighted, int tie_smallest, 
-                 double eps, int max_train_samples, int *pred_out);
-
+// FILE: knn.h
+
+#ifndef KNN_H
+#define KNN_H
+
+#include "data_types.h"
+
+#define KNN_TILE 32         // training rows per packed distance tile
+#define KNN_QUERY_BLOCK 8   // test rows scored against each tile in turn
+#define KNN_SEED 42         // random tie breaks and training samples
+
+// max_train_samples > 0 compares each test row with that many training rows
+// drawn with replacement; 0 (or >= the training size) runs the exact search.
+
+void knn_predict_fs(FeatureStore *Ftr, int *ytr, FeatureStore *Fte, int k,
+                    int use_euclidean, int weighted, int tie_smallest,
+                    double eps, int max_train_samples, int *pred_out);
+void knn_predict_tree(const BallTree *T, int *ytr, Frame *Xte, int k,
+                      int weighted, int tie_smallest, double eps, int *pred_out);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,63 @@
+// FILE: knn_heap.h
+
+#ifndef KNN_HEAP_H
+#define KNN_HEAP_H
+
+// Bounded max-heap of the k best (distance, row) pairs seen so far. The root
+// is the worst pair kept, so a candidate costs one compare unless it wins.
+typedef struct {
+    int k;
+    int count;
+    double *dist;      // max-heap on (dist, idx): root is the worst kept
+    int *idx;
+} KnnHeap;
+
+// Entry (da, ia) is further than (db, ib); equal distances keep the lower index
+static inline int heap_after(double da, int ia, double db, int ib) {
+    return da > db || (da == db && ia > ib);
+}
+
+static inline void heap_push(KnnHeap *h, double d, int i) {
+    int pos;
+    if (h->count < h->k) {
+        pos = h->count++;
+        while (pos > 0) {
+            int parent = (pos - 1) / 2;
+            if (!heap_after(d, i, h->dist[parent], h->idx[parent])) break;
+            h->dist[pos] = h->dist[parent];
+            h->idx[pos] = h->idx[parent];
+            pos = parent;
+        }
+    } else {
+        if (!heap_after(h->dist[0], h->idx[0], d, i)) return;
+        pos = 0;
+        for (;;) {
+            int c = 2 * pos + 1;
+            if (c >= h->count) break;
+            if (c + 1 < h->count && heap_after(h->dist[c + 1], h->idx[c + 1], h->dist[c], h->idx[c])) c++;
+            if (!heap_after(h->dist[c], h->idx[c], d, i)) break;
+            h->dist[pos] = h->dist[c];
+            h->idx[pos] = h->idx[c];
+            pos = c;
+        }
+    }
+    h->dist[pos] = d;
+    h->idx[pos] = i;
+}
+
+// Sort the kept pairs nearest first (k is small, insertion sort is enough)
+static inline void heap_sort(KnnHeap *h) {
+    for (int a = 1; a < h->count; a++) {
+        double d = h->dist[a];
+        int i = h->idx[a];
+        int b = a;
+        for (; b > 0 && heap_after(h->dist[b - 1], h->idx[b - 1], d, i); b--) {
+            h->dist[b] = h->dist[b - 1];
+            h->idx[b] = h->idx[b - 1];
+        }
+        h->dist[b] = d;
+        h->idx[b] = i;
+    }
+}
+
+#endif
@@ -0,0 +1,173 @@
+// FILE: linalg.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "linalg.h"
+#include "feature_store.h"
+#include "parallel.h"
+
+// Solve A x = rhs for symmetric positive definite A (n x n, row-major).
+// A is overwritten by its Cholesky factor and rhs by x. Returns -1 if A is
+// not positive definite.
+int cholesky_solve(double *A, double *rhs, int n) {
+    for (int j = 0; j < n; j++) {
+        double *Aj = A + (size_t)j * n;
+        double s = Aj[j];
+        for (int k = 0; k < j; k++) s -= Aj[k] * Aj[k];
+        if (!(s > 0.0)) return -1;
+        double ljj = sqrt(s);
+        Aj[j] = ljj;
+
+        for (int i = j + 1; i < n; i++) {
+            double *Ai = A + (size_t)i * n;
+            double t = Ai[j];
+            for (int k = 0; k < j; k++) t -= Ai[k] * Aj[k];
+            Ai[j] = t / ljj;
+        }
+    }
+
+    // forward solve L u = rhs, then back solve L^T x = u
+    for (int i = 0; i < n; i++) {
+        const double *Ai = A + (size_t)i * n;
+        double t = rhs[i];
+        for (int k = 0; k < i; k++) t -= Ai[k] * rhs[k];
+        rhs[i] = t / Ai[i];
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        double t = rhs[i];
+        for (int k = i + 1; k < n; k++) t -= A[(size_t)k * n + i] * rhs[k];
+        rhs[i] = t / A[(size_t)i * n + i];
+    }
+    return 0;
+}
+
+// Solve (A + ridge I) out = rhs for a (d + 1) system whose last unknown is the
+// intercept, which is not penalised. One hot blocks make A singular next to
+// the intercept, so if the factorization fails a jitter growing from 1e-12 of
+// the largest diagonal entry is added.
+int ridge_solve(const double *A, const double *rhs, int d, double ridge, double *out) {
+    int d1 = d + 1;
+    double *L = malloc((size_t)d1 * d1 * sizeof(double));
+    double *x = malloc(d1 * sizeof(double));
+
+    double max_diag = 0.0;
+    for (int j = 0; j < d1; j++)
+        if (A[(size_t)j * d1 + j] > max_diag) max_diag = A[(size_t)j * d1 + j];
+
+    int ok = -1;
+    for (double jitter = 0.0; jitter <= 1e-4 * max_diag;
+         jitter = jitter > 0.0 ? jitter * 100.0 : 1e-12 * max_diag) {
+        memcpy(L, A, (size_t)d1 * d1 * sizeof(double));
+        memcpy(x, rhs, d1 * sizeof(double));
+        for (int j = 0; j < d; j++) L[(size_t)j * d1 + j] += ridge + jitter;
+        L[(size_t)d * d1 + d] += jitter;
+
+        if (cholesky_solve(L, x, d1) == 0) {
+            memcpy(out, x, d1 * sizeof(double));
+            ok = 0;
+            break;
+        }
+        if (max_diag <= 0.0) break;
+    }
+
+    free(L);
+    free(x);
+    return ok;
+}
+
+// Normal equations over rows augmented with a trailing 1 for the intercept:
+// A = sum sw_i x_i x_i^T and rhs = sum sw_i z_i x_i (sw NULL means all ones).
+// Rows are densified GRAM_TILE at a time into column-major tiles so every
+// entry of A is updated with one contiguous dot product per tile.
+typedef struct {
+    const FeatureStore *F;
+    const double *sw;
+    const double *z;
+    int d1;           // features + intercept
+    double *acc;      // tasks x (d1 * d1 + d1)
+} GramJob;
+
+static void gram_task(void *ctx, int task, int begin, int end) {
+    GramJob *job = ctx;
+    int d1 = job->d1;
+    int d = d1 - 1;
+    double *A = job->acc + (size_t)task * (d1 * d1 + d1);
+    double *rhs = A + (size_t)d1 * d1;
+    memset(A, 0, (size_t)(d1 * d1 + d1) * sizeof(double));
+
+    double *U = malloc((size_t)d1 * GRAM_TILE * sizeof(double)); // x, column-major
+    double *V = malloc((size_t)d1 * GRAM_TILE * sizeof(double)); // sw * x
+    double *row = malloc(d1 * sizeof(double));
+    double zw[GRAM_TILE];
+
+    for (int r0 = begin; r0 < end; r0 += GRAM_TILE) {
+        int m = end - r0 < GRAM_TILE ? end - r0 : GRAM_TILE;
+
+        for (int r = 0; r < m; r++) {
+            int i = r0 + r;
+            const double *x = row;
+            features_densify_row(job->F, i, row);
+            double w = job->sw ? job->sw[i] : 1.0;
+            for (int j = 0; j < d; j++) {
+                U[(size_t)j * GRAM_TILE + r] = x[j];
+                V[(size_t)j * GRAM_TILE + r] = w * x[j];
+            }
+            U[(size_t)d * GRAM_TILE + r] = 1.0;
+            V[(size_t)d * GRAM_TILE + r] = w;
+            zw[r] = w * job->z[i];
+        }
+
+        for (int j = 0; j < d1; j++) {
+            const double *Vj = V + (size_t)j * GRAM_TILE;
+            const double *Uj = U + (size_t)j * GRAM_TILE;
+            double *Aj = A + (size_t)j * d1;
+            for (int k = j; k < d1; k++) {
+                const double *Uk = U + (size_t)k * GRAM_TILE;
+                double s = 0.0;
+                for (int r = 0; r < m; r++) s += Vj[r] * Uk[r];
+                Aj[k] += s;
+            }
+            double s = 0.0;
+            for (int r = 0; r < m; r++) s += Uj[r] * zw[r];
+            rhs[j] += s;
+        }
+    }
+
+    free(U);
+    free(V);
+    free(row);
+}
+
+static void gram_run(GramJob *job, int n, double *A, double *rhs) {
+    int d1 = job->d1;
+    int tasks = parallel_tasks(n);
+    job->acc = malloc((size_t)tasks * (d1 * d1 + d1) * sizeof(double));
+    if (!job->acc) {
+        fprintf(stderr, "Error: Out of memory for normal equations\n");
+        exit(1);
+    }
+
+    parallel_for(n, gram_task, job);
+
+    // reduce in task order, then mirror the upper triangle
+    memset(A, 0, (size_t)d1 * d1 * sizeof(double));
+    memset(rhs, 0, d1 * sizeof(double));
+    for (int t = 0; t < tasks; t++) {
+        const double *At = job->acc + (size_t)t * (d1 * d1 + d1);
+        for (int j = 0; j < d1 * d1; j++) A[j] += At[j];
+        for (int j = 0; j < d1; j++) rhs[j] += At[d1 * d1 + j];
+    }
+    for (int j = 0; j < d1; j++)
+        for (int k = j + 1; k < d1; k++) A[(size_t)k * d1 + j] = A[(size_t)j * d1 + k];
+
+    free(job->acc);
+}
+
+// A is (cols + 1)^2 and rhs cols + 1; the last row/column is the intercept
+void gram_fs(const FeatureStore *F, const double *sw, const double *z,
+             double *A, double *rhs) {
+    GramJob job = { F, sw, z, F->cols + 1, NULL };
+    gram_run(&job, F->rows, A, rhs);
+}
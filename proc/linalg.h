@@ -0,0 +1,15 @@
+// FILE: linalg.h
+
+#ifndef LINALG_H
+#define LINALG_H
+
+#include "data_types.h"
+
+#define GRAM_TILE 32 // rows per block when accumulating X^T X
+
+int cholesky_solve(double *A, double *rhs, int n);
+int ridge_solve(const double *A, const double *rhs, int d, double ridge, double *out);
+void gram_fs(const FeatureStore *F, const double *sw, const double *z,
+             double *A, double *rhs);
+
+#endif
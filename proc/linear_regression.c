@@ -1,43 +1,83 @@
-// FILE: linear_regression.c
-
-#include <stdlib.h>
-#include "linear_regression.h"
-
-// Train linear regression using gradient descent
-void linear_regression_fit(Frame *X, double *y, double *w_out, double *b_out) {
-    int n = X->rows;
-    int d = X->cols;
-    double lr = 0.01;
-    int epochs = 1000;
-
-    for (int j = 0; j < d; j++) w_out[j] = 0.0;
-    *b_out = 0.0;
-
-    for (int epoch = 0; epoch < epochs; epoch++) {
-        double *grad_w = calloc(d, sizeof(double));
-        double grad_b = 0.0;
-
-        for (int i = 0; i < n; i++) {
-            double pred = *b_out;
-            for (int j = 0; j < d; j++) pred += X->data[i][j] * w_out[j];
-            double err = pred - y[i];
-
-            grad_b += err;
-            for (int j = 0; j < d; j++) grad_w[j] += err * X->data[i][j];
-        }
-
-        *b_out -= lr * grad_b / n;
-        for (int j = 0; j < d; j++) w_out[j] -= lr * grad_w[j] / n;
-
-        free(grad_w);
-    }
-}
-
-// Predict values based on learned weights and bias
-void linear_regression_predict(Frame *X, double *w, double b, double *out) {
-    for (int i = 0; i < X->rows; i++) {
-        double s = b;
-        for (int j = 0; j < X->cols; j++) s += X->data[i][j] * w[j];
-        out[i] = s;
-    }
-}
+// FILE: linear_regression.c
+
+#include <stdlib.h>
+#include "linear_regression.h"
+#include "feature_store.h"
+#include "gradient.h"
+#include "linalg.h"
+#include "parallel.h"
+
+// Predict values based on learned weights and bias
+// Rows are scored in parallel chunks; each row only writes its own output
+typedef struct {
+    const FeatureStore *F;
+    const double *w;
+    const double *w_cat;
+    double c0;
+    double b;
+    double *out;
+} PredictJob;
+
+static void predict_task(void *ctx, int task, int begin, int end) {
+    PredictJob *job = ctx;
+    (void)task;
+    for (int i = begin; i < end; i++)
+        job->out[i] = job->b + features_dot(job->F, i, job->w, job->w_cat, job->c0);
+}
+
+// Train linear regression using gradient descent
+void linear_regression_fit_fs(FeatureStore *F, double *y, double *w_out, double *b_out) {
+    int n = F->rows;
+    int d = F->cols;
+    double lr = 0.01;
+    int epochs = 1000;
+
+    for (int j = 0; j < d; j++) w_out[j] = 0.0;
+    *b_out = 0.0;
+
+    double *grad_w = malloc(d * sizeof(double));
+    GradEngine g;
+    grad_engine_init(&g, n, d);
+
+    for (int epoch = 0; epoch < epochs; epoch++) {
+        double grad_b;
+        grad_fs(&g, F, NULL, 0, y, LINK_IDENTITY, w_out, *b_out, grad_w, &grad_b);
+
+        *b_out -= lr * grad_b / n;
+        for (int j = 0; j < d; j++) w_out[j] -= lr * grad_w[j] / n;
+    }
+
+    grad_engine_free(&g);
+    free(grad_w);
+}
+
+void linear_regression_predict_fs(FeatureStore *F, double *w, double b, double *out) {
+    double *w_cat = calloc(F->cols, sizeof(double));
+    PredictJob job = { F, w, w_cat, 0.0, b, out };
+    job.c0 = features_dot_prepare(F, w, w_cat);
+    parallel_for(F->rows, predict_task, &job);
+    free(w_cat);
+}
+
+// Exact least squares fit from one blocked pass that builds X^T X and X^T y.
+// Returns -1 (leaving w/b untouched) if the system cannot be factored, in
+// which case linear_regression_fit_fs is the fallback.
+int linear_regression_fit_cholesky_fs(FeatureStore *F, double *y, double ridge,
+                                      double *w_out, double *b_out) {
+    int d1 = F->cols + 1;
+    double *A = malloc((size_t)d1 * d1 * sizeof(double));
+    double *rhs = malloc(d1 * sizeof(double));
+    double *x = malloc(d1 * sizeof(double));
+
+    gram_fs(F, NULL, y, A, rhs);
+    int ok = ridge_solve(A, rhs, F->cols, ridge, x);
+    if (ok == 0) {
+        for (int j = 0; j < F->cols; j++) w_out[j] = x[j];
+        *b_out = x[F->cols];
+    }
+
+    free(A);
+    free(rhs);
+    free(x);
+    return ok;
+}
@@ -1,11 +1,13 @@
-//File:Linear_regresion.h
-
-#ifndef LINEAR_REGRESSION_H
-#define LINEAR_REGRESSION_H
-
-#include "data_types.h"
-
-void linear_regression_fit(Frame *X, double *y, double *w_out, double *b_out);
-void linear_regression_predict(Frame *X, double *w, double b, double *out);
-
+//File:Linear_regresion.h
+
+#ifndef LINEAR_REGRESSION_H
+#define LINEAR_REGRESSION_H
+
+#include "data_types.h"
+
+void linear_regression_fit_fs(FeatureStore *F, double *y, double *w_out, double *b_out);
+void linear_regression_predict_fs(FeatureStore *F, double *w, double b, double *out);
+int linear_regression_fit_cholesky_fs(FeatureStore *F, double *y, double ridge,
+                                      double *w_out, double *b_out);
+
 #endif
\ No newline at end of file
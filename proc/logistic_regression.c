@@ -1,51 +1,463 @@
-// FILE: logistic_regression.c
-
-#include <math.h>
-#include <stdlib.h>
-#include "logistic_regression.h"
-
-// Sigmoid activation
-static double sigmoid(double z) {
-    if (z < -500) z = -500; // avoid overflow
-    if (z > 500) z = 500;
-    return 1.0 / (1.0 + exp(-z));
-}
-
-void logistic_regression_fit(Frame *X, int *y, double *w_out, double *b_out) {
-    int n = X->rows;    // samples
-    int d = X->cols;    // features
-    double lr = 0.1;    // learning rate
-    int epochs = 300;   // training loops
-    
-    for (int j = 0; j < d; j++) w_out[j] = 0.0;
-    *b_out = 0.0;
-    
-    for (int epoch = 0; epoch < epochs; epoch++) {
-        double *grad_w = calloc(d, sizeof(double));
-        double grad_b = 0.0;
-        
-        for (int i = 0; i < n; i++) {
-            double z = *b_out;
-            for (int j = 0; j < d; j++) z += X->data[i][j] * w_out[j];
-            
-            double pred = sigmoid(z);
-            double err = pred - y[i];
-            
-            grad_b += err;
-            for (int j = 0; j < d; j++) grad_w[j] += err * X->data[i][j];
-        }
-        
-        *b_out -= lr * grad_b / n;
-        for (int j = 0; j < d; j++) w_out[j] -= lr * grad_w[j] / n;
-        
-        free(grad_w);
-    }
-}
-
-void logistic_regression_predict(Frame *X, double *w, double b, int *out) {
-    for (int i = 0; i < X->rows; i++) {
-        double z = b;
-        for (int j = 0; j < X->cols; j++) z += X->data[i][j] * w[j];
-        out[i] = (sigmoid(z) >= 0.5) ? 1 : 0; // threshold for prediction
-    }
-}
+// FILE: logistic_regression.c
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logistic_regression.h"
+#include "feature_store.h"
+#include "gradient.h"
+#include "linalg.h"
+#include "parallel.h"
+#include "rng.h"
+
+#define LBFGS_MEMORY 10
+
+// Training rows and labels. Weights travel as one vector theta of d + 1
+// entries with the intercept last.
+typedef struct {
+    const FeatureStore *F;
+    double *y;
+    int n;
+    int d;
+    double l2;
+    GradEngine g;
+} Problem;
+
+static double *labels_to_double(const int *y, int n) {
+    double *yd = malloc(n * sizeof(double));
+    for (int i = 0; i < n; i++) yd[i] = (double)y[i];
+    return yd;
+}
+
+static void *xcalloc(size_t n, size_t size) {
+    void *p = calloc(n ? n : 1, size);
+    if (!p) {
+        fprintf(stderr, "Error: Out of memory for logistic regression\n");
+        exit(1);
+    }
+    return p;
+}
+
+// Mean log loss plus penalty over the m rows listed in rows (all rows when
+// rows is NULL); grad receives the matching mean gradient
+static double objective(Problem *P, const int *rows, int m, const double *theta, double *grad) {
+    int d = P->d;
+    double loss = grad_fs(&P->g, P->F, rows, m, P->y, LINK_LOGISTIC, theta, theta[d],
+                          grad, &grad[d]);
+    if (!rows) m = P->n;
+
+    for (int j = 0; j <= d; j++) grad[j] /= m;
+    if (P->l2 > 0.0) {
+        for (int j = 0; j < d; j++) {
+            loss += 0.5 * P->l2 * theta[j] * theta[j];
+            grad[j] += P->l2 * theta[j];
+        }
+    }
+    return loss;
+}
+
+static int small_change(double prev, double cur, double tol) {
+    return isfinite(prev) && fabs(prev - cur) <= tol * fmax(1.0, fabs(prev));
+}
+
+static double dot(const double *a, const double *b, int n) {
+    double s = 0.0;
+    for (int j = 0; j < n; j++) s += a[j] * b[j];
+    return s;
+}
+
+// Backtracking (Armijo) search along dir starting from step t. On success
+// theta, grad and *f move to the accepted point and the step is returned;
+// 0 means no step decreased the loss and nothing was changed.
+static double line_search(Problem *P, double *theta, double *grad, double *f,
+                          const double *dir, double t, double *trial, double *trial_grad) {
+    int d1 = P->d + 1;
+    double slope = dot(grad, dir, d1);
+
+    for (; t > 1e-10; t *= 0.5) {
+        for (int j = 0; j < d1; j++) trial[j] = theta[j] + t * dir[j];
+        double ft = objective(P, NULL, 0, trial, trial_grad);
+        if (ft <= *f + 1e-4 * t * slope) {
+            memcpy(theta, trial, d1 * sizeof(double));
+            memcpy(grad, trial_grad, d1 * sizeof(double));
+            *f = ft;
+            return t;
+        }
+    }
+    return 0.0;
+}
+
+// Plain full batch descent, the original trainer
+static void fit_gd(Problem *P, const LogRegOptions *o, double *theta, FitReport *rep) {
+    int d1 = P->d + 1;
+    double *grad = xcalloc(d1, sizeof(double));
+    double prev = INFINITY;
+
+    for (int it = 0; it < o->max_iter; it++) {
+        double f = objective(P, NULL, 0, theta, grad);
+        for (int j = 0; j < d1; j++) theta[j] -= o->lr * grad[j];
+        rep->iterations = it + 1;
+        if (o->tol > 0.0 && small_change(prev, f, o->tol)) { rep->converged = 1; break; }
+        prev = f;
+    }
+    free(grad);
+}
+
+// One epoch of mini-batch steps (SGD with momentum or Adam) over the rows
+// of P in the order of perm, reshuffled first from rng. m1/m2 and *step
+// carry the optimizer state between epochs. Returns the summed batch losses.
+static double minibatch_epoch(Problem *P, const LogRegOptions *o, Rng *rng, int *perm,
+                              double *theta, double *grad, double *m1, double *m2, long *step) {
+    int n = P->n;
+    int d1 = P->d + 1;
+    int bs = o->batch_size > 0 && o->batch_size < n ? o->batch_size : n;
+    const double beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+    double loss = 0.0;
+
+    rng_shuffle(rng, perm, n);
+    for (int start = 0; start < n; start += bs) {
+        int m = start + bs <= n ? bs : n - start;
+        loss += m * objective(P, perm + start, m, theta, grad);
+        (*step)++;
+
+        if (o->optimizer == LOGREG_ADAM) {
+            double c1 = 1.0 - pow(beta1, (double)*step);
+            double c2 = 1.0 - pow(beta2, (double)*step);
+            for (int j = 0; j < d1; j++) {
+                m1[j] = beta1 * m1[j] + (1.0 - beta1) * grad[j];
+                m2[j] = beta2 * m2[j] + (1.0 - beta2) * grad[j] * grad[j];
+                theta[j] -= o->lr * (m1[j] / c1) / (sqrt(m2[j] / c2) + eps);
+            }
+        } else {
+            for (int j = 0; j < d1; j++) {
+                m1[j] = o->momentum * m1[j] - o->lr * grad[j];
+                theta[j] += m1[j];
+            }
+        }
+    }
+    return loss;
+}
+
+// Mini-batch SGD with momentum or Adam. Rows are reshuffled every epoch from
+// a seeded generator; convergence is judged on the mean loss of each epoch.
+static void fit_minibatch(Problem *P, const LogRegOptions *o, double *theta, FitReport *rep) {
+    int n = P->n;
+    int d1 = P->d + 1;
+
+    double *grad = xcalloc(d1, sizeof(double));
+    double *m1 = xcalloc(d1, sizeof(double)); // momentum velocity or Adam first moment
+    double *m2 = xcalloc(d1, sizeof(double)); // Adam second moment
+    int *perm = xcalloc(n, sizeof(int));
+    for (int i = 0; i < n; i++) perm[i] = i;
+
+    Rng rng;
+    rng_seed(&rng, o->seed);
+    double prev = INFINITY;
+    long step = 0;
+
+    for (int epoch = 0; epoch < o->max_iter; epoch++) {
+        double epoch_loss = minibatch_epoch(P, o, &rng, perm, theta, grad, m1, m2, &step) / n;
+        rep->iterations = epoch + 1;
+        if (o->tol > 0.0 && small_change(prev, epoch_loss, o->tol)) { rep->converged = 1; break; }
+        prev = epoch_loss;
+    }
+
+    free(grad);
+    free(m1);
+    free(m2);
+    free(perm);
+}
+
+// L-BFGS with the standard two loop recursion over the last LBFGS_MEMORY
+// curvature pairs
+static void fit_lbfgs(Problem *P, const LogRegOptions *o, double *theta, FitReport *rep) {
+    int d1 = P->d + 1;
+    double *grad = xcalloc(d1, sizeof(double));
+    double *dir = xcalloc(d1, sizeof(double));
+    double *trial = xcalloc(d1, sizeof(double));
+    double *trial_grad = xcalloc(d1, sizeof(double));
+    double *S = xcalloc((size_t)LBFGS_MEMORY * d1, sizeof(double));
+    double *Y = xcalloc((size_t)LBFGS_MEMORY * d1, sizeof(double));
+    double rho[LBFGS_MEMORY], alpha[LBFGS_MEMORY];
+    int count = 0, head = 0; // stored pairs, slot of the next pair
+
+    double f = objective(P, NULL, 0, theta, grad);
+
+    for (int it = 0; it < o->max_iter; it++) {
+        // dir = -H grad
+        for (int j = 0; j < d1; j++) dir[j] = -grad[j];
+        for (int k = 0; k < count; k++) {
+            int s = (head - 1 - k + LBFGS_MEMORY) % LBFGS_MEMORY;
+            alpha[s] = rho[s] * dot(S + (size_t)s * d1, dir, d1);
+            for (int j = 0; j < d1; j++) dir[j] -= alpha[s] * Y[(size_t)s * d1 + j];
+        }
+        if (count > 0) {
+            int s = (head - 1 + LBFGS_MEMORY) % LBFGS_MEMORY;
+            const double *ys = Y + (size_t)s * d1;
+            double gamma = 1.0 / (rho[s] * dot(ys, ys, d1));
+            for (int j = 0; j < d1; j++) dir[j] *= gamma;
+        }
+        for (int k = count - 1; k >= 0; k--) {
+            int s = (head - 1 - k + LBFGS_MEMORY) % LBFGS_MEMORY;
+            double beta = rho[s] * dot(Y + (size_t)s * d1, dir, d1);
+            for (int j = 0; j < d1; j++) dir[j] += (alpha[s] - beta) * S[(size_t)s * d1 + j];
+        }
+        if (dot(dir, grad, d1) >= 0.0) {
+            // lost descent: restart from steepest descent
+            for (int j = 0; j < d1; j++) dir[j] = -grad[j];
+            count = 0;
+        }
+
+        // the first step is scaled so it moves theta by at most 1
+        double t0 = 1.0;
+        if (count == 0) t0 = fmin(1.0, 1.0 / sqrt(dot(grad, grad, d1) + 1e-300));
+
+        double *s_new = S + (size_t)head * d1;
+        double *y_new = Y + (size_t)head * d1;
+        memcpy(s_new, theta, d1 * sizeof(double));
+        memcpy(y_new, grad, d1 * sizeof(double));
+
+        double f_prev = f;
+        double t = line_search(P, theta, grad, &f, dir, t0, trial, trial_grad);
+        rep->iterations = it + 1;
+        if (t == 0.0) break;
+
+        for (int j = 0; j < d1; j++) {
+            s_new[j] = theta[j] - s_new[j];
+            y_new[j] = grad[j] - y_new[j];
+        }
+        double sy = dot(s_new, y_new, d1);
+        if (sy > 1e-12) {
+            rho[head] = 1.0 / sy;
+            head = (head + 1) % LBFGS_MEMORY;
+            if (count < LBFGS_MEMORY) count++;
+        } else if (count == LBFGS_MEMORY) {
+            count--; // the oldest pair's slot was reused above
+        }
+
+        double gmax = 0.0;
+        for (int j = 0; j < d1; j++) gmax = fmax(gmax, fabs(grad[j]));
+        if (small_change(f_prev, f, o->tol) || gmax <= o->tol) { rep->converged = 1; break; }
+    }
+
+    free(grad);
+    free(dir);
+    free(trial);
+    free(trial_grad);
+    free(S);
+    free(Y);
+}
+
+// Linear scores b + x.w for every training row
+static void margins(Problem *P, const double *theta, double *z) {
+    int d = P->d;
+    double *w_cat = xcalloc(d, sizeof(double));
+    double c0 = features_dot_prepare(P->F, theta, w_cat);
+    for (int i = 0; i < P->n; i++) z[i] = theta[d] + features_dot(P->F, i, theta, w_cat, c0);
+    free(w_cat);
+}
+
+// IRLS: each Newton step solves (X^T W X + n l2) step = -n grad with
+// W = p (1 - p), reusing the weighted Gram kernels and the jittered solver
+// of the normal equations, then backtracks if the full step overshoots.
+static void fit_newton(Problem *P, const LogRegOptions *o, double *theta, FitReport *rep) {
+    int n = P->n;
+    int d = P->d;
+    int d1 = d + 1;
+    double *grad = xcalloc(d1, sizeof(double));
+    double *step = xcalloc(d1, sizeof(double));
+    double *trial = xcalloc(d1, sizeof(double));
+    double *trial_grad = xcalloc(d1, sizeof(double));
+    double *A = xcalloc((size_t)d1 * d1, sizeof(double));
+    double *rhs = xcalloc(d1, sizeof(double));
+    double *sw = xcalloc(n, sizeof(double));
+    double *z = xcalloc(n, sizeof(double));
+
+    double f = objective(P, NULL, 0, theta, grad);
+
+    for (int it = 0; it < o->max_iter; it++) {
+        margins(P, theta, z);
+        for (int i = 0; i < n; i++) {
+            double p = sigmoid(z[i]);
+            sw[i] = fmax(p * (1.0 - p), 1e-10);
+            z[i] = (P->y[i] - p) / sw[i]; // so that sum sw z x = -sum grad
+        }
+        gram_fs(P->F, sw, z, A, rhs);
+        for (int j = 0; j < d; j++) rhs[j] -= n * P->l2 * theta[j];
+
+        rep->iterations = it + 1;
+        if (ridge_solve(A, rhs, d, n * P->l2, step) != 0) break;
+
+        double f_prev = f;
+        if (line_search(P, theta, grad, &f, step, 1.0, trial, trial_grad) == 0.0) break;
+        if (small_change(f_prev, f, o->tol)) { rep->converged = 1; break; }
+    }
+
+    free(grad);
+    free(step);
+    free(trial);
+    free(trial_grad);
+    free(A);
+    free(rhs);
+    free(sw);
+    free(z);
+}
+
+static void fit_problem(Problem *P, int *y, const LogRegOptions *o,
+                        double *w_out, double *b_out, FitReport *report) {
+    int d = P->d;
+    P->y = labels_to_double(y, P->n);
+    P->l2 = o->l2;
+    grad_engine_init(&P->g, P->n, d);
+
+    double *theta = xcalloc(d + 1, sizeof(double));
+    double *grad = xcalloc(d + 1, sizeof(double));
+    FitReport rep = { 0, 0.0, 0 };
+
+    switch (o->optimizer) {
+    case LOGREG_SGD:
+    case LOGREG_ADAM:   fit_minibatch(P, o, theta, &rep); break;
+    case LOGREG_LBFGS:  fit_lbfgs(P, o, theta, &rep); break;
+    case LOGREG_NEWTON: fit_newton(P, o, theta, &rep); break;
+    default:            fit_gd(P, o, theta, &rep); break;
+    }
+    if (report) {
+        rep.loss = objective(P, NULL, 0, theta, grad);
+        *report = rep;
+    }
+
+    memcpy(w_out, theta, d * sizeof(double));
+    *b_out = theta[d];
+
+    grad_engine_free(&P->g);
+    free(theta);
+    free(grad);
+    free(P->y);
+}
+
+// Sensible starting settings for each optimizer
+void logistic_regression_default_options(LogRegOptions *o, LogRegOptimizer optimizer) {
+    o->optimizer = optimizer;
+    o->lr = 0.1;
+    o->max_iter = 300;
+    o->tol = 1e-6;
+    o->l2 = 0.0;
+    o->batch_size = 256;
+    o->momentum = 0.9;
+    o->seed = 42;
+
+    switch (optimizer) {
+    case LOGREG_SGD:    o->lr = 0.01; o->max_iter = 50; o->tol = 1e-4; break;
+    case LOGREG_ADAM:   o->lr = 0.001; o->max_iter = 50; o->tol = 1e-4; break;
+    case LOGREG_LBFGS:  o->max_iter = 100; break;
+    case LOGREG_NEWTON: o->max_iter = 25; break;
+    default: break;
+    }
+}
+
+// Fit with the optimizer and settings of opts; report (optional) gets the
+// iterations, final loss and whether the tolerance was met
+void logistic_regression_fit_fs_opts(FeatureStore *F, int *y, const LogRegOptions *opts,
+                                     double *w_out, double *b_out, FitReport *report) {
+    Problem P = { F, NULL, F->rows, F->cols, 0.0, { 0 } };
+    fit_problem(&P, y, opts, w_out, b_out, report);
+}
+
+// Rows are scored in parallel chunks; each row only writes its own output
+typedef struct {
+    const FeatureStore *F;
+    const double *w;
+    const double *w_cat;
+    double c0;
+    double b;
+    int *out;
+} PredictJob;
+
+static void predict_task(void *ctx, int task, int begin, int end) {
+    PredictJob *job = ctx;
+    (void)task;
+    for (int i = begin; i < end; i++) {
+        double z = job->b + features_dot(job->F, i, job->w, job->w_cat, job->c0);
+        job->out[i] = (sigmoid(z) >= 0.5) ? 1 : 0; // threshold for prediction
+    }
+}
+
+// One hot blocks cost a single weight lookup per row
+void logistic_regression_predict_fs(FeatureStore *F, double *w, double b, int *out) {
+    double *w_cat = calloc(F->cols, sizeof(double));
+    PredictJob job = { F, w, w_cat, 0.0, b, out };
+    job.c0 = features_dot_prepare(F, w, w_cat);
+    parallel_for(F->rows, predict_task, &job);
+    free(w_cat);
+}
+
+// Out-of-core training: logistic_regression_stream_chunk runs the mini-batch
+// steps of fit_minibatch over one chunk at a time (rows shuffled within the
+// chunk) with the optimizer state carried from chunk to chunk, and
+// logistic_regression_stream_epoch closes each pass over the data. gd, lbfgs
+// and newton need every row per step, so they train with Adam here.
+void logistic_regression_stream_init(LogRegStream *s, int d, int max_rows,
+                                     const LogRegOptions *opts) {
+    s->o = *opts;
+    if (s->o.optimizer != LOGREG_SGD && s->o.optimizer != LOGREG_ADAM)
+        s->o.optimizer = LOGREG_ADAM;
+    s->d = d;
+    s->max_rows = max_rows;
+    s->theta = xcalloc(d + 1, sizeof(double));
+    s->grad = xcalloc(d + 1, sizeof(double));
+    s->m1 = xcalloc(d + 1, sizeof(double));
+    s->m2 = xcalloc(d + 1, sizeof(double));
+    s->perm = xcalloc(max_rows, sizeof(int));
+    s->step = 0;
+    rng_seed(&s->rng, s->o.seed);
+    s->loss = 0.0;
+    s->loss_rows = 0;
+    s->prev = INFINITY;
+    s->report.iterations = 0;
+    s->report.loss = 0.0;
+    s->report.converged = 0;
+}
+
+// Train on the rows of one chunk (y holds 0/1 labels as doubles)
+void logistic_regression_stream_chunk(LogRegStream *s, FeatureStore *F, double *y) {
+    Problem P = { F, y, F->rows, s->d, s->o.l2, { 0 } };
+    if (F->rows == 0) return;
+    if (F->rows > s->max_rows) {
+        fprintf(stderr, "Error: Chunk of %d rows is larger than the stream's %d\n",
+                F->rows, s->max_rows);
+        exit(1);
+    }
+    grad_engine_init(&P.g, P.n, P.d);
+    for (int i = 0; i < P.n; i++) s->perm[i] = i;
+    s->loss += minibatch_epoch(&P, &s->o, &s->rng, s->perm, s->theta, s->grad,
+                               s->m1, s->m2, &s->step);
+    s->loss_rows += P.n;
+    grad_engine_free(&P.g);
+}
+
+// End a pass over the data; returns 1 once training is done (converged or
+// out of epochs), after which the weights are final
+int logistic_regression_stream_epoch(LogRegStream *s) {
+    double epoch_loss = s->loss_rows > 0 ? s->loss / s->loss_rows : 0.0;
+    s->report.iterations++;
+    s->report.loss = epoch_loss;
+    s->loss = 0.0;
+    s->loss_rows = 0;
+    if (s->o.tol > 0.0 && small_change(s->prev, epoch_loss, s->o.tol)) s->report.converged = 1;
+    s->prev = epoch_loss;
+    return s->report.converged || s->report.iterations >= s->o.max_iter;
+}
+
+// Hand over the weights and free the rest
+void logistic_regression_stream_finish(LogRegStream *s, double *w_out, double *b_out,
+                                       FitReport *report) {
+    memcpy(w_out, s->theta, s->d * sizeof(double));
+    *b_out = s->theta[s->d];
+    if (report) *report = s->report;
+    free(s->theta);
+    free(s->grad);
+    free(s->m1);
+    free(s->m2);
+    free(s->perm);
+}
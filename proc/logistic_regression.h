@@ -1,11 +1,38 @@
-// FILE: logistic_regression.h
-
-#ifndef LOGISTIC_REGRESSION_H
-#define LOGISTIC_REGRESSION_H
-
-#include "data_types.h"
-
-void logistic_regression_fit(Frame *X, int *y, double *w_out, double *b_out);
-void logistic_regression_predict(Frame *X, double *w, double b, int *out);
-
+// FILE: logistic_regression.h
+
+#ifndef LOGISTIC_REGRESSION_H
+#define LOGISTIC_REGRESSION_H
+
+#include "data_types.h"
+#include "rng.h"
+
+// Mini-batch training state carried across the chunks of a stream
+typedef struct {
+    LogRegOptions o;
+    int d;
+    int max_rows;       // largest chunk
+    double *theta;      // weights, intercept last
+    double *grad;
+    double *m1;         // momentum velocity or Adam first moment
+    double *m2;         // Adam second moment
+    int *perm;
+    long step;
+    Rng rng;
+    double loss;        // summed batch losses of the current pass
+    long long loss_rows;
+    double prev;        // mean loss of the previous pass
+    FitReport report;
+} LogRegStream;
+
+void logistic_regression_default_options(LogRegOptions *o, LogRegOptimizer optimizer);
+void logistic_regression_fit_fs_opts(FeatureStore *F, int *y, const LogRegOptions *opts,
+                                     double *w_out, double *b_out, FitReport *report);
+void logistic_regression_predict_fs(FeatureStore *F, double *w, double b, int *out);
+void logistic_regression_stream_init(LogRegStream *s, int d, int max_rows,
+                                     const LogRegOptions *opts);
+void logistic_regression_stream_chunk(LogRegStream *s, FeatureStore *F, double *y);
+int logistic_regression_stream_epoch(LogRegStream *s);
+void logistic_regression_stream_finish(LogRegStream *s, double *w_out, double *b_out,
+                                       FitReport *report);
+
 #endif
\ No newline at end of file
@@ -1,206 +1,702 @@
-// FILE: main.c
-
-#include <stdio.h>
-#include <stdlib.h>
-#include "data_types.h"
-#include "data_utils.h"
-#include "preprocessing.h"
-#include "metrics.h"
-#include "logistic_regression.h"
-#include "linear_regression.h"
-#include "knn.h"
-#include "decision_tree.h"
-#include "naive_bayes.h"
-
-
-
-
-/*
-====================================================================================================
-
-SUPER IMPORTANT INFO for professor morales
-If your trying to run only the C code you have to type this in the terminal before running ./ml_program
-
-ulimit -s unlimited
-
-example:
-
-make
-ulimit -s unlimited
-./ml_program  
-
-if u want to test different csv or target or tst size
-
-./ml_program file.csv hours.per.week 0.40
-
-=====================================================================================================
-*/
-
-
-
-//puts result into csv file for menu to read
-void save_results_to_csv(const char *filename, 
-                         double acc_log, double f1_log,
-                         double acc_nb, double f1_nb,
-                         double acc_tree, double f1_tree,
-                         double rmse_lin, double r2_lin,
-                         double acc_knn, double f1_knn) {
-    FILE *fp = fopen(filename, "w");
-    if (!fp) {
-        fprintf(stderr, "Error: Could not create %s\n", filename);
-        return;
-    }
-    
-    fprintf(fp, "Model,Metric1_Name,Metric1_Value,Metric2_Name,Metric2_Value\n");
-    fprintf(fp, "Logistic Regression,Accuracy,%.4f,F1-Score,%.4f\n", acc_log, f1_log);
-    fprintf(fp, "Gaussian Naive Bayes,Accuracy,%.4f,F1-Score,%.4f\n", acc_nb, f1_nb);
-    fprintf(fp, "Decision Tree (ID3),Accuracy,%.4f,F1-Score,%.4f\n", acc_tree, f1_tree);
-    fprintf(fp, "Linear Regression,RMSE,%.4f,R-Squared,%.4f\n", rmse_lin, r2_lin);
-    fprintf(fp, "K-Nearest Neighbors (k=7),Accuracy,%.4f,F1-Score,%.4f\n", acc_knn, f1_knn);
-    
-    fclose(fp);
-    printf("\nResults saved to: %s\n", filename);
-}
-
-
-void print_usage(const char *program_name) {
-    printf("Usage: %s [csv_file] [target_column] [test_size]\n\n", program_name);
-    printf("Arguments:\n");
-    printf("  csv_file    - Path to CSV file (default: adult_income_cleaned.csv)\n");
-    printf("  target_col  - Name of target column (default: income)\n");
-    printf("  test_size   - Fraction for test set (default: 0.3)\n\n");
-    printf("Examples:\n");
-    printf("  %s\n", program_name);
-    printf("  %s adult_income_cleaned.csv income 0.3\n", program_name);
-}
-
-int main(int argc, char *argv[]) {
-    const char *csv_path = "adult_income_cleaned.csv";
-    const char *target_col = "income";
-    double test_size = 0.3;
-    
-    if (argc >= 2) csv_path = argv[1];
-    if (argc >= 3) target_col = argv[2];
-    if (argc >= 4) test_size = atof(argv[3]);
-    
-    if (test_size <= 0.0 || test_size >= 1.0) {
-        printf("Error: test_size must be between 0.0 and 1.0\n");
-        return 1;
-    }
-    
-    printf("CSV file: %s\n", csv_path);
-    printf("Target column: %s\n", target_col);
-    printf("Test size: %.2f\n\n", test_size);
-    
-    //call data loading and preprocessing
-    Frame X, Xtr, Xte;
-    double y[MAX_ROWS], ytr[MAX_ROWS], yte[MAX_ROWS];
-    EncodingInfo encoding_info;
-    load_and_encode_csv(csv_path, target_col, &X, y, &encoding_info);
-    
-    if (X.rows == 0 || X.cols == 0) {
-        fprintf(stderr, "Error: No data loaded\n");
-        return 1;
-    }
-    
-    //for test size 
-    train_test_split(&X, y, &Xtr, &Xte, ytr, yte, test_size);
-    printf("Training: %d samples\n", Xtr.rows);
-    printf("Test: %d samples\n", Xte.rows);
-    Stats S;
-    zscore(&Xtr, &S);
-    apply_stats(&Xte, &S);
-
-    
-    int ytr_int[MAX_ROWS], yte_int[MAX_ROWS];
-    for (int i = 0; i < Xtr.rows; i++) ytr_int[i] = (int)ytr[i];
-    for (int i = 0; i < Xte.rows; i++) yte_int[i] = (int)yte[i];
-    
-
-    double acc_log, f1_log, acc_nb, f1_nb, acc_tree, f1_tree, acc_knn, f1_knn;
-    double rmse_lin, r2_lin;
-    
-    printf("Running Alogirtms\n");
-    printf("========================================\n\n");
-    
-    //Logistic Regression
-    printf("Logistic Regression\n");
-    printf("Training...");
-    fflush(stdout);
-    double w_log[MAX_COLS], b_log;
-    logistic_regression_fit(&Xtr, ytr_int, w_log, &b_log);
-    int pred_log[MAX_ROWS];
-    logistic_regression_predict(&Xte, w_log, b_log, pred_log);
-    acc_log = accuracy_int(yte_int, pred_log, Xte.rows);
-    f1_log = macro_f1_int(yte_int, pred_log, Xte.rows);
-    printf(" Finish with logistic!\n");
-    
-    // Naive Bayes
-    printf("Gaussian Naive Bayes\n");
-    printf("Training...");
-    fflush(stdout);
-    GNBModel nb_model = naive_bayes_fit(&Xtr, ytr_int);
-    int pred_nb[MAX_ROWS];
-    naive_bayes_predict(&nb_model, &Xte, pred_nb);
-    acc_nb = accuracy_int(yte_int, pred_nb, Xte.rows);
-    f1_nb = macro_f1_int(yte_int, pred_nb, Xte.rows);
-    printf(" finish with NB!\n");
-    naive_bayes_free(&nb_model);
-    
-    //Decision Tree 
-    printf("Decision Tree (ID3)\n");
-    printf("Training...");
-    fflush(stdout);
-    Node *tree = decision_tree_fit(&Xtr, ytr_int, 5, 10, 16);
-    int pred_tree[MAX_ROWS];
-    decision_tree_predict(tree, &Xte, pred_tree);
-    acc_tree = accuracy_int(yte_int, pred_tree, Xte.rows);
-    f1_tree = macro_f1_int(yte_int, pred_tree, Xte.rows);
-    printf(" finish with DT!\n");
-    decision_tree_free(tree);
-    
-    //Linear Regression 
-    printf("Linear Regression\n");
-    printf("Training...");
-    fflush(stdout);
-    double w_lin[MAX_COLS], b_lin;
-    linear_regression_fit(&Xtr, ytr, w_lin, &b_lin);
-    double pred_lin[MAX_ROWS];
-    linear_regression_predict(&Xte, w_lin, b_lin, pred_lin);
-    rmse_lin = rmse_double(yte, pred_lin, Xte.rows);
-    r2_lin = r2_double(yte, pred_lin, Xte.rows);
-    printf(" finish with linear!\n");
-    
-    
-
-    // Knn 
-    printf("K-Nearest Neighbors (k=7)\n");
-    printf("Training...");
-    fflush(stdout);
-    int pred_knn[MAX_ROWS];
-    knn_predict(&Xtr, ytr_int, &Xte, 7, 1, 0, 0, 1e-6, 5000, pred_knn);
-    acc_knn = accuracy_int(yte_int, pred_knn, Xte.rows);
-    f1_knn = macro_f1_int(yte_int, pred_knn, Xte.rows);
-    printf(" finish with KNN!\n\n");
-
-    
- 
- 
-    printf("\nRESULTS\n");
-    printf("========================================\n");
-    printf("Model                       | Metric 1  | Metric 2\n");
-    printf("----------------------------|-----------|----------\n");
-    printf("Logistic Regression         | Acc:%.4f | F1:%.4f\n", acc_log, f1_log);
-    printf("Gaussian Naive Bayes        | Acc:%.4f | F1:%.4f\n", acc_nb, f1_nb);
-    printf("Decision Tree (ID3)         | Acc:%.4f | F1:%.4f\n", acc_tree, f1_tree);
-    printf("Linear Regression           | RMSE:%.4f| R²:%.4f\n", rmse_lin, r2_lin);
-    printf("K-Nearest Neighbors (k=7)   | Acc:%.4f | F1:%.4f\n", acc_knn, f1_knn); 
- 
-    save_results_to_csv("c_model_results.csv", 
-                        acc_log, f1_log,
-                        acc_nb, f1_nb,
-                        acc_tree, f1_tree,
-                        rmse_lin, r2_lin,
-                        acc_knn, f1_knn);
-    return 0;
-}
+// FILE: main.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "data_types.h"
+#include "frame.h"
+#include "feature_store.h"
+#include "data_utils.h"
+#include "preprocessing.h"
+#include "metrics.h"
+#include "logistic_regression.h"
+#include "linear_regression.h"
+#include "knn.h"
+#include "ball_tree.h"
+#include "decision_tree.h"
+#include "random_forest.h"
+#include "gradient_boosting.h"
+#include "naive_bayes.h"
+#include "parallel.h"
+#include "cross_validation.h"
+#include "model_io.h"
+#include "dataset_cache.h"
+#include "server.h"
+#include "stream_train.h"
+
+
+
+
+/*
+====================================================================================================
+
+How to run only the C code:
+
+make
+./ml_program  
+
+if u want to test different csv or target or tst size
+
+./ml_program file.csv hours.per.week 0.40
+
+linear regression is solved exactly with cholesky, add --lin-solver gd for gradient descent
+
+logistic regression trains with newton (IRLS) until the loss settles, pick another optimizer with
+
+./ml_program file.csv income 0.3 --log-opt lbfgs --tol 1e-8
+
+training and scoring use every core by default, pin the thread count with
+
+./ml_program file.csv income 0.3 --threads 8
+
+results are bit for bit repeatable for a given thread count
+
+the split keeps file order by default; for a sorted csv shuffle it, and keep
+the class ratios on both sides, with
+
+./ml_program file.csv income 0.3 --shuffle --stratify --seed 7
+
+to tune instead, cross-validate a grid of settings for every model and write
+a leaderboard to c_cv_leaderboard.csv (the test size is ignored)
+
+./ml_program file.csv income 0.3 --cv 5 --shuffle --grid "knn.k=5,9;tree.max_depth=6,10"
+
+keep the fitted encoding, scaling and models, then score new data with them
+later without training (predictions go to c_predictions.csv)
+
+./ml_program file.csv income 0.3 --save-model income.model
+./ml_program predict income.model new_rows.csv
+
+or keep them loaded in a scoring server on a unix socket (one csv or json row
+per line in, one prediction per line out), and try it with the bundled client
+
+./ml_program serve income.model /tmp/ml.sock
+./ml_program client /tmp/ml.sock rows.txt
+
+All frames live on the heap and are sized to the CSV, so no ulimit changes are needed.
+
+the features the gradient, knn and naive bayes kernels read are doubles; build
+with float32 storage to halve their memory traffic (sums stay double)
+
+make clean && make PRECISION=float32
+
+for a csv too big for memory, train out of core a chunk of rows at a time
+(logistic regression, naive bayes, decision tree and linear regression; the
+test side is the tail of the file)
+
+./ml_program big.csv income 0.3 --chunk-rows 100000
+
+the first run on a csv caches the encoded data next to it (file.csv.income.cache)
+and later runs map that instead of parsing; the cache is rebuilt whenever the
+csv changes, and --no-cache skips it
+
+=====================================================================================================
+*/
+
+
+//puts result into csv file for menu to read
+void save_results_to_csv(const char *filename, 
+                         double acc_log, double f1_log,
+                         double acc_nb, double f1_nb,
+                         double acc_tree, double f1_tree,
+                         double acc_rf, double f1_rf,
+                         double acc_gbm, double f1_gbm,
+                         double rmse_lin, double r2_lin,
+                         double rmse_gbr, double r2_gbr,
+                         double acc_knn, double f1_knn) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not create %s\n", filename);
+        return;
+    }
+    
+    fprintf(fp, "Model,Metric1_Name,Metric1_Value,Metric2_Name,Metric2_Value\n");
+    fprintf(fp, "Logistic Regression,Accuracy,%.4f,F1-Score,%.4f\n", acc_log, f1_log);
+    fprintf(fp, "Gaussian Naive Bayes,Accuracy,%.4f,F1-Score,%.4f\n", acc_nb, f1_nb);
+    fprintf(fp, "Decision Tree (ID3),Accuracy,%.4f,F1-Score,%.4f\n", acc_tree, f1_tree);
+    fprintf(fp, "Random Forest,Accuracy,%.4f,F1-Score,%.4f\n", acc_rf, f1_rf);
+    if (isnan(acc_gbm))
+        fprintf(fp, "Gradient Boosting,Accuracy,n/a,F1-Score,n/a\n");
+    else
+        fprintf(fp, "Gradient Boosting,Accuracy,%.4f,F1-Score,%.4f\n", acc_gbm, f1_gbm);
+    fprintf(fp, "Linear Regression,RMSE,%.4f,R-Squared,%.4f\n", rmse_lin, r2_lin);
+    fprintf(fp, "Gradient Boosting Regressor,RMSE,%.4f,R-Squared,%.4f\n", rmse_gbr, r2_gbr);
+    fprintf(fp, "K-Nearest Neighbors (k=7),Accuracy,%.4f,F1-Score,%.4f\n", acc_knn, f1_knn);
+    
+    fclose(fp);
+    printf("\nResults saved to: %s\n", filename);
+}
+
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [csv_file] [target_column] [test_size] [options]\n\n", program_name);
+    printf("Arguments:\n");
+    printf("  csv_file    - Path to CSV file (default: adult_income_cleaned.csv)\n");
+    printf("  target_col  - Name of target column (default: income)\n");
+    printf("  test_size   - Fraction for test set (default: 0.3)\n\n");
+    printf("Options:\n");
+    printf("  --threads N      - Worker threads (default: one per core)\n");
+    printf("  --shuffle        - Shuffle rows before the train/test split (default: file order)\n");
+    printf("  --stratify       - Keep the class ratios of the target on both sides\n");
+    printf("  --seed N         - Seed for --shuffle (default: 42)\n");
+    printf("  --lin-solver S   - Linear regression solver, cholesky or gd (default: cholesky)\n");
+    printf("  --ridge R        - L2 penalty for the cholesky solver (default: 0)\n");
+    printf("  --log-opt O      - Logistic regression optimizer: gd, sgd, adam, lbfgs or newton\n");
+    printf("                     (default: newton)\n");
+    printf("  --tol T          - Logistic regression convergence tolerance\n");
+    printf("  --max-iter N     - Logistic regression iteration (epoch) limit\n");
+    printf("  --lr R           - Logistic regression step size for gd, sgd and adam\n");
+    printf("  --batch N        - Mini-batch size for sgd and adam (default: 256)\n");
+    printf("  --trees N        - Random forest size (default: 50)\n");
+    printf("  --gbm-rounds N   - Gradient boosting round limit, early stopping may end\n");
+    printf("                     sooner (default: 200)\n");
+    printf("  --knn-tree       - Answer KNN queries from a ball tree index instead of a\n");
+    printf("                     tiled scan (pays off on low dimensional data)\n");
+    printf("  --no-cache       - Neither read nor write the encoded dataset cache\n");
+    printf("  --chunk-rows N   - Train out of core, N rows in memory at a time\n");
+    printf("  --serve SOCKET   - After training, serve the models on a unix socket\n");
+    printf("  --save-model F   - Write the encoding, scaling and trained models to F\n");
+    printf("  --cv K           - K-fold cross-validate a grid of settings instead of one split,\n");
+    printf("                     leaderboard goes to c_cv_leaderboard.csv\n");
+    printf("  --grid SPEC      - Grid values, e.g. \"knn.k=3,5;gbm.max_depth=4\"\n");
+    printf("  --cv-models LIST - Models to tune: logistic,nb,tree,forest,gbm,knn,linear\n\n");
+    cv_grid_usage();
+    printf("\n");
+    printf("Examples:\n");
+    printf("  %s\n", program_name);
+    printf("  %s adult_income_cleaned.csv income 0.3\n", program_name);
+    printf("  %s predict model_file csv_file [out_csv] [--threads N]\n", program_name);
+    printf("  %s serve model_file socket [--model NAME] [--batch-wait US] [--threads N]\n",
+           program_name);
+    printf("  %s client socket [requests_file]\n", program_name);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// predict subcommand: score a CSV with a model file from --save-model, no
+// training. Every model's prediction goes to out_csv, one row per input row;
+// when the file also has the target column the metrics are printed too.
+static int predict_main(int argc, char *argv[]) {
+    const char *paths[3] = { NULL, NULL, "c_predictions.csv" };
+    int n_pos = 0, threads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (n_pos < 3) paths[n_pos++] = argv[i];
+    }
+    if (n_pos < 2) {
+        printf("Usage: ml_program predict model_file csv_file [out_csv] [--threads N]\n");
+        return 1;
+    }
+    parallel_set_threads(threads);
+
+    double t0 = now_ms();
+    ModelBundle M;
+    if (model_load(paths[0], &M) != 0) return 1;
+    double t_load = now_ms();
+
+    Frame X;
+    double *y;
+    load_csv_with_encoding(paths[1], M.target, &M.encoding, &X, &y);
+    FeatureStore F;
+    bundle_features(&M, &X, &F);
+    int n = X.rows;
+    // gbm is only trained for two-class targets, otherwise its slot is empty
+    int no_gbm = !(M.encoding.target_is_categorical && M.encoding.target_classes.count == 2);
+
+    int *cls[BUNDLE_N_MODELS];
+    double *value[BUNDLE_N_MODELS];
+    for (int m = 0; m < BUNDLE_N_MODELS; m++) {
+        cls[m] = calloc(n > 0 ? n : 1, sizeof(int));
+        value[m] = calloc(n > 0 ? n : 1, sizeof(double));
+        bundle_predict(&M, m, &X, &F, cls[m], value[m]);
+    }
+    double t_score = now_ms();
+
+    FILE *fp = fopen(paths[2], "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not create %s\n", paths[2]);
+    } else {
+        char text[MAX_STR];
+        for (int m = 0; m < BUNDLE_N_MODELS; m++)
+            fprintf(fp, "%s%c", BUNDLE_MODEL_NAMES[m], m + 1 < BUNDLE_N_MODELS ? ',' : '\n');
+        for (int i = 0; i < n; i++) {
+            for (int m = 0; m < BUNDLE_N_MODELS; m++) {
+                if (m == BUNDLE_GBM && no_gbm) strcpy(text, "n/a");
+                else bundle_format(&M, m, cls[m][i], value[m][i], text, sizeof(text));
+                fprintf(fp, "%s%c", text, m + 1 < BUNDLE_N_MODELS ? ',' : '\n');
+            }
+        }
+        fclose(fp);
+        printf("Predictions saved to: %s\n", paths[2]);
+    }
+
+    if (y) {
+        int *y_int = malloc((n > 0 ? n : 1) * sizeof(int));
+        for (int i = 0; i < n; i++) y_int[i] = (int)y[i];
+        printf("\n%-12s | Metric 1    | Metric 2\n", "Model");
+        for (int m = 0; m < BUNDLE_N_MODELS; m++) {
+            if (m == BUNDLE_GBM && no_gbm)
+                printf("%-12s | n/a         | n/a\n", BUNDLE_MODEL_NAMES[m]);
+            else if (m < BUNDLE_LINEAR)
+                printf("%-12s | Acc:%.4f  | F1:%.4f\n", BUNDLE_MODEL_NAMES[m],
+                       accuracy_int(y_int, cls[m], n), macro_f1_int(y_int, cls[m], n));
+            else
+                printf("%-12s | RMSE:%.4f | R²:%.4f\n", BUNDLE_MODEL_NAMES[m],
+                       rmse_double(y, value[m], n), r2_double(y, value[m], n));
+        }
+        free(y_int);
+        free(y);
+    }
+    printf("\nModel loaded in %.1f ms, %d rows read and scored in %.1f ms\n",
+           t_load - t0, n, t_score - t_load);
+
+    for (int m = 0; m < BUNDLE_N_MODELS; m++) {
+        free(cls[m]);
+        free(value[m]);
+    }
+    features_free(&F);
+    frame_free(&X);
+    model_bundle_free(&M);
+    parallel_shutdown();
+    return 0;
+}
+
+// serve subcommand: load a model file once and answer rows over a socket
+static int serve_main(int argc, char *argv[]) {
+    const char *paths[2] = { NULL, NULL };
+    const char *model_name = NULL;
+    int n_pos = 0, threads = 0, batch_wait = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) model_name = argv[++i];
+        else if (strcmp(argv[i], "--batch-wait") == 0 && i + 1 < argc) batch_wait = atoi(argv[++i]);
+        else if (n_pos < 2) paths[n_pos++] = argv[i];
+    }
+    if (n_pos < 2) {
+        printf("Usage: ml_program serve model_file socket [--model NAME] [--batch-wait US] [--threads N]\n");
+        return 1;
+    }
+    parallel_set_threads(threads);
+
+    ModelBundle M;
+    if (model_load(paths[0], &M) != 0) return 1;
+    int model = !M.encoding.target_is_categorical ? BUNDLE_GBR
+              : M.encoding.target_classes.count == 2 ? BUNDLE_GBM : BUNDLE_FOREST;
+    if (model_name && (model = bundle_model_find(model_name)) < 0) {
+        printf("Error: unknown model %s\n", model_name);
+        model_bundle_free(&M);
+        return 1;
+    }
+    int rc = serve_models(&M, paths[1], model, batch_wait);
+    model_bundle_free(&M);
+    parallel_shutdown();
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    const char *csv_path = "adult_income_cleaned.csv";
+    const char *target_col = "income";
+    double test_size = 0.3;
+    const char *model_path = NULL;
+    const char *serve_path = NULL;
+    
+    if (argc > 1 && strcmp(argv[1], "predict") == 0) return predict_main(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "serve") == 0) return serve_main(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "client") == 0) {
+        FILE *in = argc > 3 ? fopen(argv[3], "r") : stdin;
+        if (argc < 3 || !in) {
+            printf("Usage: ml_program client socket [requests_file]\n");
+            return 1;
+        }
+        int rc = client_run(argv[2], in);
+        if (in != stdin) fclose(in);
+        return rc;
+    }
+
+    int threads = 0;
+    int lin_cholesky = 1;
+    double ridge = 0.0;
+    LogRegOptimizer log_opt = LOGREG_NEWTON;
+    double log_tol = -1.0, log_lr = -1.0;
+    int log_max_iter = 0, log_batch = 0;
+    int knn_tree = 0;
+    int rf_trees = 0;
+    int gbm_rounds = 0;
+    int shuffle = 0, stratify = 0;
+    unsigned long long split_seed = 42;
+    int cv_folds = 0;
+    int chunk_rows = 0;
+    CvGrid grid;
+    cv_grid_default(&grid);
+    
+    int n_pos = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--lin-solver") == 0 && i + 1 < argc) {
+            lin_cholesky = strcmp(argv[++i], "gd") != 0;
+        } else if (strcmp(argv[i], "--ridge") == 0 && i + 1 < argc) {
+            ridge = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--log-opt") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "gd") == 0) log_opt = LOGREG_GD;
+            else if (strcmp(name, "sgd") == 0) log_opt = LOGREG_SGD;
+            else if (strcmp(name, "adam") == 0) log_opt = LOGREG_ADAM;
+            else if (strcmp(name, "lbfgs") == 0) log_opt = LOGREG_LBFGS;
+            else if (strcmp(name, "newton") == 0) log_opt = LOGREG_NEWTON;
+            else {
+                printf("Error: unknown optimizer %s\n", name);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tol") == 0 && i + 1 < argc) {
+            log_tol = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-iter") == 0 && i + 1 < argc) {
+            log_max_iter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--lr") == 0 && i + 1 < argc) {
+            log_lr = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            log_batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trees") == 0 && i + 1 < argc) {
+            rf_trees = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gbm-rounds") == 0 && i + 1 < argc) {
+            gbm_rounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shuffle") == 0) {
+            shuffle = 1;
+        } else if (strcmp(argv[i], "--stratify") == 0) {
+            stratify = 1;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            split_seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            dataset_cache_enable(0);
+        } else if (strcmp(argv[i], "--chunk-rows") == 0 && i + 1 < argc) {
+            chunk_rows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_path = argv[++i];
+        } else if (strcmp(argv[i], "--save-model") == 0 && i + 1 < argc) {
+            model_path = argv[++i];
+        } else if (strcmp(argv[i], "--cv") == 0 && i + 1 < argc) {
+            cv_folds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc) {
+            if (cv_grid_parse(&grid, argv[++i]) != 0) return 1;
+        } else if (strcmp(argv[i], "--cv-models") == 0 && i + 1 < argc) {
+            if (cv_grid_models(&grid, argv[++i]) != 0) return 1;
+        } else if (strcmp(argv[i], "--knn-tree") == 0) {
+            knn_tree = 1;
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (n_pos == 0) {
+            csv_path = argv[i]; n_pos++;
+        } else if (n_pos == 1) {
+            target_col = argv[i]; n_pos++;
+        } else if (n_pos == 2) {
+            test_size = atof(argv[i]); n_pos++;
+        }
+    }
+    parallel_set_threads(threads);
+    
+    if (test_size <= 0.0 || test_size >= 1.0) {
+        printf("Error: test_size must be between 0.0 and 1.0\n");
+        return 1;
+    }
+    
+    printf("CSV file: %s\n", csv_path);
+    printf("Target column: %s\n", target_col);
+    printf("Test size: %.2f\n", test_size);
+    printf("Threads: %d\n\n", parallel_threads());
+
+    if (chunk_rows > 0) {
+        if (shuffle || stratify || cv_folds > 0 || model_path || serve_path)
+            printf("Note: --chunk-rows keeps file order and ignores --shuffle, --stratify, "
+                   "--cv, --save-model and --serve\n");
+        StreamOptions stream_opts;
+        stream_default_options(&stream_opts);
+        stream_opts.chunk_rows = chunk_rows;
+        stream_opts.test_size = test_size;
+        // only sgd and adam stream, so the defaults the flags refine are adam's
+        if (log_opt != LOGREG_SGD) log_opt = LOGREG_ADAM;
+        logistic_regression_default_options(&stream_opts.log_opts, log_opt);
+        if (log_tol >= 0.0) stream_opts.log_opts.tol = log_tol;
+        if (log_max_iter > 0) stream_opts.log_opts.max_iter = log_max_iter;
+        if (log_lr > 0.0) stream_opts.log_opts.lr = log_lr;
+        if (log_batch > 0) stream_opts.log_opts.batch_size = log_batch;
+        stream_opts.ridge = ridge;
+        stream_opts.seed = split_seed;
+        int rc = stream_train(csv_path, target_col, &stream_opts, "c_model_results.csv");
+        parallel_shutdown();
+        return rc;
+    }
+    
+    //call data loading and preprocessing
+    Frame X, Xtr, Xte;
+    double *y;
+    EncodingInfo encoding_info;
+    load_and_encode_csv(csv_path, target_col, &X, &y, &encoding_info);
+    
+    if (X.rows == 0 || X.cols == 0) {
+        fprintf(stderr, "Error: No data loaded\n");
+        return 1;
+    }
+
+    if (cv_folds > 0) {
+        cv_run(&X, y, &encoding_info, &grid, cv_folds, shuffle, stratify, split_seed,
+               "c_cv_leaderboard.csv");
+        encoding_info_free(&encoding_info);
+        frame_free(&X);
+        free(y);
+        parallel_shutdown();
+        return 0;
+    }
+    
+    //for test size: both sides are row views of X, nothing is copied
+    SplitIndex split;
+    split_indices(X.rows, stratify ? y : NULL, test_size, shuffle, split_seed, &split);
+    frame_view(&X, split.train, split.n_train, &Xtr);
+    frame_view(&X, split.test, split.n_test, &Xte);
+    double *ytr = malloc((split.n_train > 0 ? split.n_train : 1) * sizeof(double));
+    double *yte = malloc((split.n_test > 0 ? split.n_test : 1) * sizeof(double));
+    gather_values(y, split.train, split.n_train, ytr);
+    gather_values(y, split.test, split.n_test, yte);
+    free(y);
+    printf("Training: %d samples\n", Xtr.rows);
+    printf("Test: %d samples\n", Xte.rows);
+    // mixed numeric + category code layout for the linear, NB and KNN kernels
+    FeatureStore Ftr, Fte;
+    features_from_frame(&Xtr, &encoding_info, &Ftr);
+    features_from_frame(&Xte, &encoding_info, &Fte);
+
+    // the feature stores take the stats directly; the frames only feed the
+    // tree models, which do not care about scale, so they stay raw unless
+    // the ball tree needs them
+    Stats S;
+    stats_fit(&Xtr, &S);
+    features_standardize(&Ftr, &S);
+    features_standardize(&Fte, &S);
+
+    
+    int *ytr_int = malloc(Xtr.rows * sizeof(int));
+    int *yte_int = malloc(Xte.rows * sizeof(int));
+    for (int i = 0; i < Xtr.rows; i++) ytr_int[i] = (int)ytr[i];
+    for (int i = 0; i < Xte.rows; i++) yte_int[i] = (int)yte[i];
+    
+
+    double acc_log, f1_log, acc_nb, f1_nb, acc_tree, f1_tree, acc_rf, f1_rf, acc_gbm, f1_gbm;
+    double acc_knn, f1_knn;
+    double rmse_lin, r2_lin, rmse_gbr, r2_gbr;
+    
+    printf("Running Alogirtms\n");
+    printf("========================================\n\n");
+    
+    //Logistic Regression
+    printf("Logistic Regression\n");
+    printf("Training...");
+    fflush(stdout);
+    LogRegOptions log_opts;
+    logistic_regression_default_options(&log_opts, log_opt);
+    if (log_tol >= 0.0) log_opts.tol = log_tol;
+    if (log_max_iter > 0) log_opts.max_iter = log_max_iter;
+    if (log_lr > 0.0) log_opts.lr = log_lr;
+    if (log_batch > 0) log_opts.batch_size = log_batch;
+    double *w_log = malloc(Xtr.cols * sizeof(double)), b_log;
+    FitReport log_report;
+    logistic_regression_fit_fs_opts(&Ftr, ytr_int, &log_opts, w_log, &b_log, &log_report);
+    printf(" %d iterations, loss %.6f%s...", log_report.iterations, log_report.loss,
+           log_report.converged ? "" : " (not converged)");
+    int *pred_log = malloc(Xte.rows * sizeof(int));
+    logistic_regression_predict_fs(&Fte, w_log, b_log, pred_log);
+    acc_log = accuracy_int(yte_int, pred_log, Xte.rows);
+    f1_log = macro_f1_int(yte_int, pred_log, Xte.rows);
+    printf(" Finish with logistic!\n");
+    
+    // Naive Bayes
+    printf("Gaussian Naive Bayes\n");
+    printf("Training...");
+    fflush(stdout);
+    GNBModel nb_model = naive_bayes_fit_fs(&Ftr, ytr_int);
+    int *pred_nb = malloc(Xte.rows * sizeof(int));
+    naive_bayes_predict_fs(&nb_model, &Fte, pred_nb);
+    acc_nb = accuracy_int(yte_int, pred_nb, Xte.rows);
+    f1_nb = macro_f1_int(yte_int, pred_nb, Xte.rows);
+    printf(" finish with NB!\n");
+    
+    //Decision Tree 
+    printf("Decision Tree (ID3)\n");
+    printf("Training...");
+    fflush(stdout);
+    Node *tree = decision_tree_fit(&Xtr, ytr_int, 5, 10, 16);
+    FlatTree flat_tree;
+    decision_tree_flatten(tree, &flat_tree);
+    int *pred_tree = malloc(Xte.rows * sizeof(int));
+    flat_tree_predict(&flat_tree, &Xte, pred_tree);
+    acc_tree = accuracy_int(yte_int, pred_tree, Xte.rows);
+    f1_tree = macro_f1_int(yte_int, pred_tree, Xte.rows);
+    printf(" finish with DT!\n");
+    decision_tree_free(tree);
+    
+    // Random Forest
+    printf("Random Forest\n");
+    printf("Training...");
+    fflush(stdout);
+    ForestOptions rf_opts;
+    random_forest_default_options(&rf_opts);
+    if (rf_trees > 0) rf_opts.n_trees = rf_trees;
+    RandomForest forest;
+    random_forest_fit(&forest, &Xtr, ytr_int, &rf_opts);
+    printf(" %d trees, out-of-bag accuracy %.4f...", forest.n_trees, forest.oob_accuracy);
+    int *pred_rf = malloc(Xte.rows * sizeof(int));
+    random_forest_predict(&forest, &Xte, pred_rf);
+    acc_rf = accuracy_int(yte_int, pred_rf, Xte.rows);
+    f1_rf = macro_f1_int(yte_int, pred_rf, Xte.rows);
+    printf(" finish with RF!\n");
+    
+    // Gradient Boosting (logistic loss, so only for two-class targets)
+    printf("Gradient Boosting\n");
+    int binary_target = encoding_info.target_is_categorical &&
+                        encoding_info.target_classes.count == 2;
+    GbmOptions gbm_opts;
+    GbmModel gbm = { 0 };
+    FitReport gbm_report;
+    int *pred_gbm = malloc(Xte.rows * sizeof(int));
+    if (binary_target) {
+        printf("Training...");
+        fflush(stdout);
+        gbm_default_options(&gbm_opts, GBM_LOGISTIC);
+        if (gbm_rounds > 0) gbm_opts.max_iter = gbm_rounds;
+        gbm_fit(&gbm, &Xtr, ytr, &gbm_opts, &gbm_report);
+        printf(" %d trees, validation loss %.6f...", gbm_report.iterations, gbm_report.loss);
+        gbm_predict(&gbm, &Xte, pred_gbm);
+        acc_gbm = accuracy_int(yte_int, pred_gbm, Xte.rows);
+        f1_gbm = macro_f1_int(yte_int, pred_gbm, Xte.rows);
+        printf(" finish with GBM!\n");
+    } else {
+        printf("Skipped: the target is not a two-class label\n");
+        acc_gbm = f1_gbm = NAN;
+    }
+    
+    //Linear Regression 
+    printf("Linear Regression\n");
+    printf("Training...");
+    fflush(stdout);
+    double *w_lin = malloc(Xtr.cols * sizeof(double)), b_lin;
+    if (!lin_cholesky || linear_regression_fit_cholesky_fs(&Ftr, ytr, ridge, w_lin, &b_lin) != 0) {
+        if (lin_cholesky) printf(" (normal equations singular, using gradient descent)");
+        linear_regression_fit_fs(&Ftr, ytr, w_lin, &b_lin);
+    }
+    double *pred_lin = malloc(Xte.rows * sizeof(double));
+    linear_regression_predict_fs(&Fte, w_lin, b_lin, pred_lin);
+    rmse_lin = rmse_double(yte, pred_lin, Xte.rows);
+    r2_lin = r2_double(yte, pred_lin, Xte.rows);
+    printf(" finish with linear!\n");
+    
+    // Gradient Boosting Regressor
+    printf("Gradient Boosting Regressor\n");
+    printf("Training...");
+    fflush(stdout);
+    gbm_default_options(&gbm_opts, GBM_SQUARED);
+    if (gbm_rounds > 0) gbm_opts.max_iter = gbm_rounds;
+    GbmModel gbr;
+    gbm_fit(&gbr, &Xtr, ytr, &gbm_opts, &gbm_report);
+    printf(" %d trees, validation loss %.6f...", gbm_report.iterations, gbm_report.loss);
+    double *pred_gbr = malloc(Xte.rows * sizeof(double));
+    gbm_predict_raw(&gbr, &Xte, pred_gbr);
+    rmse_gbr = rmse_double(yte, pred_gbr, Xte.rows);
+    r2_gbr = r2_double(yte, pred_gbr, Xte.rows);
+    printf(" finish with GBR!\n");
+    
+    
+
+    // Knn 
+    printf("K-Nearest Neighbors (k=7)\n");
+    printf("Training...");
+    fflush(stdout);
+    int *pred_knn = malloc(Xte.rows * sizeof(int));
+    if (knn_tree) {
+        apply_stats(&Xtr, &S);
+        apply_stats(&Xte, &S);
+        BallTree knn_index;
+        ball_tree_build(&knn_index, &Xtr, 1, BALL_TREE_LEAF);
+        knn_predict_tree(&knn_index, ytr_int, &Xte, 7, 0, 0, 1e-6, pred_knn);
+        ball_tree_free(&knn_index);
+    } else {
+        knn_predict_fs(&Ftr, ytr_int, &Fte, 7, 1, 0, 0, 1e-6, 0, pred_knn);
+    }
+    acc_knn = accuracy_int(yte_int, pred_knn, Xte.rows);
+    f1_knn = macro_f1_int(yte_int, pred_knn, Xte.rows);
+    printf(" finish with KNN!\n\n");
+
+    
+ 
+ 
+    printf("\nRESULTS\n");
+    printf("========================================\n");
+    printf("Model                       | Metric 1  | Metric 2\n");
+    printf("----------------------------|-----------|----------\n");
+    printf("Logistic Regression         | Acc:%.4f | F1:%.4f\n", acc_log, f1_log);
+    printf("Gaussian Naive Bayes        | Acc:%.4f | F1:%.4f\n", acc_nb, f1_nb);
+    printf("Decision Tree (ID3)         | Acc:%.4f | F1:%.4f\n", acc_tree, f1_tree);
+    printf("Random Forest               | Acc:%.4f | F1:%.4f\n", acc_rf, f1_rf);
+    if (binary_target)
+        printf("Gradient Boosting           | Acc:%.4f | F1:%.4f\n", acc_gbm, f1_gbm);
+    else
+        printf("Gradient Boosting           | n/a       | n/a\n");
+    printf("Linear Regression           | RMSE:%.4f| R²:%.4f\n", rmse_lin, r2_lin);
+    printf("Gradient Boosting Regressor | RMSE:%.4f| R²:%.4f\n", rmse_gbr, r2_gbr);
+    printf("K-Nearest Neighbors (k=7)   | Acc:%.4f | F1:%.4f\n", acc_knn, f1_knn); 
+ 
+    save_results_to_csv("c_model_results.csv", 
+                        acc_log, f1_log,
+                        acc_nb, f1_nb,
+                        acc_tree, f1_tree,
+                        acc_rf, f1_rf,
+                        acc_gbm, f1_gbm,
+                        rmse_lin, r2_lin,
+                        rmse_gbr, r2_gbr,
+                        acc_knn, f1_knn);
+
+    if (model_path || serve_path) {
+        // the bundle only borrows what main owns, so it is not freed here
+        ModelBundle bundle = { .encoding = encoding_info, .stats = S, .n_features = Xtr.cols,
+                               .w_log = w_log, .b_log = b_log, .nb = nb_model,
+                               .tree = flat_tree, .forest = forest, .gbm = gbm,
+                               .w_lin = w_lin, .b_lin = b_lin, .gbr = gbr };
+        strncpy(bundle.target, target_col, MAX_STR - 1);
+        if (model_path && model_save(model_path, &bundle) == 0)
+            printf("Models saved to: %s\n", model_path);
+        if (serve_path)
+            serve_models(&bundle, serve_path,
+                         !encoding_info.target_is_categorical ? BUNDLE_GBR
+                         : binary_target ? BUNDLE_GBM : BUNDLE_FOREST, 0);
+    }
+
+    free(w_log); free(pred_log);
+    free(pred_nb);
+    free(pred_tree);
+    free(pred_rf);
+    free(pred_gbm);
+    free(w_lin); free(pred_lin);
+    free(pred_gbr);
+    free(pred_knn);
+    naive_bayes_free(&nb_model);
+    flat_tree_free(&flat_tree);
+    random_forest_free(&forest);
+    gbm_free(&gbm);
+    gbm_free(&gbr);
+    free(ytr); free(yte);
+    free(ytr_int); free(yte_int);
+    stats_free(&S);
+    encoding_info_free(&encoding_info);
+    frame_free(&Xtr);
+    frame_free(&Xte);
+    frame_free(&X);
+    split_free(&split);
+    features_free(&Ftr);
+    features_free(&Fte);
+    parallel_shutdown();
+    return 0;
+}
@@ -1,78 +1,156 @@
-// FILE: metrics.c
-
-#include <stdlib.h>
-#include <math.h>
-#include "metrics.h"
-
-double accuracy_int(const int *y_true, const int *y_pred, int n) {
-    int correct = 0;
-    for (int i = 0; i < n; ++i) 
-        if (y_true[i] == y_pred[i]) ++correct;
-    return (double)correct / (double)n;
-}
-
-static double f1_for_label_int(const int *y_true, const int *y_pred, int n, int label) {
-    long tp = 0, fp = 0, fn = 0;
-    for (int i = 0; i < n; ++i) {
-        if (y_pred[i] == label) {
-            if (y_true[i] == label) ++tp; 
-            else ++fp;
-        } else {
-            if (y_true[i] == label) ++fn;
-        }
-    }
-    double eps = 1e-12;
-    double p = (double)tp / ((double)tp + (double)fp + eps);
-    double r = (double)tp / ((double)tp + (double)fn + eps);
-    return 2.0 * p * r / (p + r + eps);
-}
-
-double macro_f1_int(const int *y_true, const int *y_pred, int n) {
-    int *unique = (int *)malloc(n * sizeof(int));
-    if (!unique) return 0.0;
-    
-    int m = 0;
-    for (int i = 0; i < n; ++i) {
-        int v = y_true[i];
-        int found = 0;
-        for (int j = 0; j < m; ++j) 
-            if (unique[j] == v) { found = 1; break; }
-        if (!found) unique[m++] = v;
-    }
-    
-    if (m == 0) { free(unique); return 0.0; }
-    
-    double sum = 0.0;
-    for (int i = 0; i < m; ++i) 
-        sum += f1_for_label_int(y_true, y_pred, n, unique[i]);
-    
-    double mean = sum / (double)m;
-    free(unique);
-    return mean;
-}
-
-double rmse_double(const double *y_true, const double *y_pred, int n) {
-    double s = 0.0;
-    for (int i = 0; i < n; ++i) {
-        double d = y_true[i] - y_pred[i];
-        s += d * d;
-    }
-    return sqrt(s / (double)n);
-}
-
-double r2_double(const double *y_true, const double *y_pred, int n) {
-    double mean = 0.0;
-    for (int i = 0; i < n; ++i) mean += y_true[i];
-    mean /= (double)n;
-    
-    double ss_tot = 0.0, ss_res = 0.0;
-    for (int i = 0; i < n; ++i) {
-        double dt = y_true[i] - mean;
-        double dr = y_true[i] - y_pred[i];
-        ss_tot += dt * dt;
-        ss_res += dr * dr;
-    }
-    
-    double eps = 1e-12;
-    return 1.0 - ss_res / (ss_tot + eps);
-}
\ No newline at end of file
+// FILE: metrics.c
+
+#include <stdlib.h>
+#include <math.h>
+#include "metrics.h"
+
+double accuracy_int(const int *y_true, const int *y_pred, int n) {
+    int correct = 0;
+    for (int i = 0; i < n; ++i) 
+        if (y_true[i] == y_pred[i]) ++correct;
+    return (double)correct / (double)n;
+}
+
+static double f1_for_label_int(const int *y_true, const int *y_pred, int n, int label) {
+    long tp = 0, fp = 0, fn = 0;
+    for (int i = 0; i < n; ++i) {
+        if (y_pred[i] == label) {
+            if (y_true[i] == label) ++tp; 
+            else ++fp;
+        } else {
+            if (y_true[i] == label) ++fn;
+        }
+    }
+    double eps = 1e-12;
+    double p = (double)tp / ((double)tp + (double)fp + eps);
+    double r = (double)tp / ((double)tp + (double)fn + eps);
+    return 2.0 * p * r / (p + r + eps);
+}
+
+double macro_f1_int(const int *y_true, const int *y_pred, int n) {
+    int *unique = (int *)malloc(n * sizeof(int));
+    if (!unique) return 0.0;
+    
+    int m = 0;
+    for (int i = 0; i < n; ++i) {
+        int v = y_true[i];
+        int found = 0;
+        for (int j = 0; j < m; ++j) 
+            if (unique[j] == v) { found = 1; break; }
+        if (!found) unique[m++] = v;
+    }
+    
+    if (m == 0) { free(unique); return 0.0; }
+    
+    double sum = 0.0;
+    for (int i = 0; i < m; ++i) 
+        sum += f1_for_label_int(y_true, y_pred, n, unique[i]);
+    
+    double mean = sum / (double)m;
+    free(unique);
+    return mean;
+}
+
+double rmse_double(const double *y_true, const double *y_pred, int n) {
+    double s = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double d = y_true[i] - y_pred[i];
+        s += d * d;
+    }
+    return sqrt(s / (double)n);
+}
+
+double r2_double(const double *y_true, const double *y_pred, int n) {
+    double mean = 0.0;
+    for (int i = 0; i < n; ++i) mean += y_true[i];
+    mean /= (double)n;
+    
+    double ss_tot = 0.0, ss_res = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double dt = y_true[i] - mean;
+        double dr = y_true[i] - y_pred[i];
+        ss_tot += dt * dt;
+        ss_res += dr * dr;
+    }
+    
+    double eps = 1e-12;
+    return 1.0 - ss_res / (ss_tot + eps);
+}
+static int score_label(ClassScore *s, int label) {
+    for (int k = 0; k < s->n_labels; ++k)
+        if (s->labels[k] == label) return k;
+    int k = s->n_labels++;
+    s->labels = realloc(s->labels, s->n_labels * sizeof(int));
+    s->in_truth = realloc(s->in_truth, s->n_labels);
+    s->tp = realloc(s->tp, s->n_labels * sizeof(long long));
+    s->fp = realloc(s->fp, s->n_labels * sizeof(long long));
+    s->fn = realloc(s->fn, s->n_labels * sizeof(long long));
+    s->labels[k] = label;
+    s->in_truth[k] = 0;
+    s->tp[k] = s->fp[k] = s->fn[k] = 0;
+    return k;
+}
+
+// Add a batch of predictions; the scores then cover every batch so far and
+// match accuracy_int / macro_f1_int over all of them at once
+void class_score_add(ClassScore *s, const int *y_true, const int *y_pred, int n) {
+    for (int i = 0; i < n; ++i) {
+        int t = score_label(s, y_true[i]);
+        s->in_truth[t] = 1;
+        if (y_true[i] == y_pred[i]) {
+            s->correct++;
+            s->tp[t]++;
+        } else {
+            s->fn[t]++;
+            s->fp[score_label(s, y_pred[i])]++;
+        }
+    }
+    s->n += n;
+}
+
+double class_score_accuracy(const ClassScore *s) {
+    return (double)s->correct / (double)s->n;
+}
+
+// Mean F1 over the labels that occur in y_true
+double class_score_macro_f1(const ClassScore *s) {
+    double eps = 1e-12, sum = 0.0;
+    int m = 0;
+    for (int k = 0; k < s->n_labels; ++k) {
+        if (!s->in_truth[k]) continue;
+        double p = (double)s->tp[k] / ((double)s->tp[k] + (double)s->fp[k] + eps);
+        double r = (double)s->tp[k] / ((double)s->tp[k] + (double)s->fn[k] + eps);
+        sum += 2.0 * p * r / (p + r + eps);
+        m++;
+    }
+    return m > 0 ? sum / (double)m : 0.0;
+}
+
+void class_score_free(ClassScore *s) {
+    free(s->labels);
+    free(s->in_truth);
+    free(s->tp);
+    free(s->fp);
+    free(s->fn);
+}
+
+// Squared errors and the spread of y_true (Welford) of a batch of predictions
+void reg_score_add(RegScore *s, const double *y_true, const double *y_pred, int n) {
+    for (int i = 0; i < n; ++i) {
+        double d = y_true[i] - y_pred[i];
+        s->sse += d * d;
+        s->n++;
+        double delta = y_true[i] - s->mean;
+        s->mean += delta / (double)s->n;
+        s->m2 += delta * (y_true[i] - s->mean);
+    }
+}
+
+double reg_score_rmse(const RegScore *s) {
+    return sqrt(s->sse / (double)s->n);
+}
+
+double reg_score_r2(const RegScore *s) {
+    double eps = 1e-12;
+    return 1.0 - s->sse / (s->m2 + eps);
+}
@@ -1,11 +1,38 @@
-// FILE: metrics.h
-
-#ifndef METRICS_H
-#define METRICS_H
-
-double accuracy_int(const int *y_true, const int *y_pred, int n);
-double macro_f1_int(const int *y_true, const int *y_pred, int n);
-double rmse_double(const double *y_true, const double *y_pred, int n);
-double r2_double(const double *y_true, const double *y_pred, int n);
-
+// FILE: metrics.h
+
+#ifndef METRICS_H
+#define METRICS_H
+
+// Accuracy and macro F1 gathered a batch at a time (start zeroed)
+typedef struct {
+    long long n;
+    long long correct;
+    int n_labels;
+    int *labels;        // every label seen in y_true or y_pred
+    char *in_truth;     // label occurs in y_true
+    long long *tp;
+    long long *fp;
+    long long *fn;
+} ClassScore;
+
+// RMSE and R^2 gathered a batch at a time (start zeroed)
+typedef struct {
+    long long n;
+    double sse;
+    double mean;        // of y_true
+    double m2;
+} RegScore;
+
+double accuracy_int(const int *y_true, const int *y_pred, int n);
+double macro_f1_int(const int *y_true, const int *y_pred, int n);
+double rmse_double(const double *y_true, const double *y_pred, int n);
+double r2_double(const double *y_true, const double *y_pred, int n);
+void class_score_add(ClassScore *s, const int *y_true, const int *y_pred, int n);
+double class_score_accuracy(const ClassScore *s);
+double class_score_macro_f1(const ClassScore *s);
+void class_score_free(ClassScore *s);
+void reg_score_add(RegScore *s, const double *y_true, const double *y_pred, int n);
+double reg_score_rmse(const RegScore *s);
+double reg_score_r2(const RegScore *s);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,430 @@
+// FILE: model_io.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "model_io.h"
+#include "preprocessing.h"
+#include "str_dict.h"
+#include "naive_bayes.h"
+#include "decision_tree.h"
+#include "random_forest.h"
+#include "gradient_boosting.h"
+#include "data_utils.h"
+#include "feature_store.h"
+#include "logistic_regression.h"
+#include "linear_regression.h"
+
+// Model files are a fixed sequence of native ints and doubles: the magic and
+// version, a byte order / type size check, then every section of the bundle
+// in struct order, then MODEL_END. Counts come before the arrays they size.
+// Files are only meant to be read on the machine type that wrote them.
+
+#define MODEL_BYTE_ORDER 0x01020304
+#define MODEL_END 0x454e4421         // last int of the file, catches truncation
+#define MODEL_MAX_ITEMS (1 << 28)    // largest array a file may declare
+
+typedef struct {
+    FILE *fp;
+    int failed;
+} ModelFile;
+
+static void put(ModelFile *f, const void *p, size_t size, int n) {
+    if (!f->failed && n > 0 && fwrite(p, size, n, f->fp) != (size_t)n) f->failed = 1;
+}
+
+static void put_int(ModelFile *f, int v) {
+    put(f, &v, sizeof(v), 1);
+}
+
+static void put_double(ModelFile *f, double v) {
+    put(f, &v, sizeof(v), 1);
+}
+
+static void put_str(ModelFile *f, const char *s) {
+    int n = (int)strlen(s);
+    put_int(f, n);
+    put(f, s, 1, n);
+}
+
+static void put_dict(ModelFile *f, const StrDict *d) {
+    put_int(f, d->count);
+    for (int i = 0; i < d->count; i++) put_str(f, d->keys[i]);
+}
+
+static void put_flat_tree(ModelFile *f, const FlatTree *F) {
+    put_int(f, F->n_nodes);
+    put_int(f, F->depth);
+    put(f, F->feature, sizeof(int), F->n_nodes);
+    put(f, F->threshold, sizeof(double), F->n_nodes);
+    put(f, F->child, sizeof(int), F->n_nodes);
+    put(f, F->label, sizeof(int), F->n_nodes);
+}
+
+static void put_gbm(ModelFile *f, const GbmModel *G) {
+    put_int(f, G->loss);
+    put_double(f, G->base_score);
+    put_int(f, G->n_trees);
+    put(f, G->root, sizeof(int), G->n_trees);
+    put(f, G->depth, sizeof(int), G->n_trees);
+    put_int(f, G->n_nodes);
+    put(f, G->feature, sizeof(int), G->n_nodes);
+    put(f, G->threshold, sizeof(double), G->n_nodes);
+    put(f, G->child, sizeof(int), G->n_nodes);
+    put(f, G->value, sizeof(double), G->n_nodes);
+}
+
+static void put_encoding(ModelFile *f, const EncodingInfo *E) {
+    put_int(f, E->n_cols);
+    for (int c = 0; c < E->n_cols; c++) {
+        put_str(f, E->columns[c].name);
+        put_int(f, E->columns[c].is_categorical);
+        put_dict(f, &E->columns[c].categories);
+        put_int(f, E->original_to_encoded[c]);
+    }
+    put_int(f, E->n_encoded_cols);
+    put_int(f, E->target_is_categorical);
+    put_dict(f, &E->target_classes);
+}
+
+// Write M to path; returns -1 (with a message) if the file cannot be written
+int model_save(const char *path, const ModelBundle *M) {
+    ModelFile f = { fopen(path, "wb"), 0 };
+    if (!f.fp) {
+        fprintf(stderr, "Error: Could not create model file %s\n", path);
+        return -1;
+    }
+    int d = M->n_features;
+
+    put(&f, MODEL_MAGIC, 1, 8);
+    put_int(&f, MODEL_VERSION);
+    put_int(&f, MODEL_BYTE_ORDER);
+    put_int(&f, (int)sizeof(double));
+    put_str(&f, M->target);
+
+    put_encoding(&f, &M->encoding);
+    put_int(&f, d);
+    put(&f, M->stats.means, sizeof(double), d);
+    put(&f, M->stats.stds, sizeof(double), d);
+
+    put(&f, M->w_log, sizeof(double), d);
+    put_double(&f, M->b_log);
+
+    const GNBModel *nb = &M->nb;
+    put_int(&f, nb->num_classes);
+    put(&f, nb->classes, sizeof(int), nb->num_classes);
+    put(&f, nb->counts, sizeof(long long), nb->num_classes);
+    put(&f, nb->priors, sizeof(double), nb->num_classes);
+    for (int c = 0; c < nb->num_classes; c++) {
+        put(&f, nb->means[c], sizeof(double), d);
+        put(&f, nb->vars[c], sizeof(double), d);
+    }
+    put(&f, nb->log_const, sizeof(double), nb->num_classes);
+    put(&f, nb->lin, sizeof(double), nb->num_classes * d);
+    put(&f, nb->quad, sizeof(double), nb->num_classes * d);
+
+    put_flat_tree(&f, &M->tree);
+
+    put_int(&f, M->forest.n_trees);
+    put_int(&f, M->forest.n_classes);
+    put(&f, M->forest.labels, sizeof(int), M->forest.n_classes);
+    put_double(&f, M->forest.oob_accuracy);
+    for (int t = 0; t < M->forest.n_trees; t++) put_flat_tree(&f, &M->forest.trees[t]);
+
+    put_gbm(&f, &M->gbm);
+    put(&f, M->w_lin, sizeof(double), d);
+    put_double(&f, M->b_lin);
+    put_gbm(&f, &M->gbr);
+    put_int(&f, MODEL_END);
+
+    if (fclose(f.fp) != 0) f.failed = 1;
+    if (f.failed) {
+        fprintf(stderr, "Error: Could not write model file %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Reads fail soft: after the first short read every value comes back zero,
+// so sizes stay small and model_load checks f.failed once at the end
+
+static void get(ModelFile *f, void *p, size_t size, int n) {
+    if (n <= 0) return;
+    if (f->failed || fread(p, size, n, f->fp) != (size_t)n) {
+        f->failed = 1;
+        memset(p, 0, size * n);
+    }
+}
+
+static int get_int(ModelFile *f) {
+    int v;
+    get(f, &v, sizeof(v), 1);
+    return v;
+}
+
+static double get_double(ModelFile *f) {
+    double v;
+    get(f, &v, sizeof(v), 1);
+    return v;
+}
+
+// A count in [0, max]; anything else marks the file bad
+static int get_count(ModelFile *f, int max) {
+    int n = get_int(f);
+    if (n < 0 || n > max) {
+        f->failed = 1;
+        return 0;
+    }
+    return n;
+}
+
+static void *load_alloc(size_t size, int n) {
+    void *p = calloc(n > 0 ? n : 1, size);
+    if (!p) {
+        fprintf(stderr, "Error: Out of memory loading model\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void *get_array(ModelFile *f, size_t size, int n) {
+    void *p = load_alloc(size, n);
+    get(f, p, size, n);
+    return p;
+}
+
+static void get_str(ModelFile *f, char *out, int cap) {
+    int n = get_count(f, cap - 1);
+    get(f, out, 1, n);
+    out[n] = '\0';
+}
+
+static void get_dict(ModelFile *f, StrDict *d) {
+    char key[MAX_STR];
+    int n = get_count(f, MODEL_MAX_ITEMS);
+    dict_init(d);
+    for (int i = 0; i < n && !f->failed; i++) {
+        get_str(f, key, MAX_STR);
+        dict_intern(d, key);
+    }
+}
+
+// Columns, categories and target classes. The one hot blocks have to tile
+// [0, n_encoded_cols) in column order, as one_hot_encode_data lays them out.
+static int get_encoding(ModelFile *f, EncodingInfo *E) {
+    encoding_info_init(E, get_count(f, MODEL_MAX_ITEMS));
+    for (int c = 0; c < E->n_cols; c++) {
+        get_str(f, E->columns[c].name, MAX_STR);
+        strcpy(E->original_names[c], E->columns[c].name);
+        E->columns[c].is_categorical = get_int(f) != 0;
+        get_dict(f, &E->columns[c].categories);
+        E->original_to_encoded[c] = get_int(f);
+    }
+    E->n_encoded_cols = get_count(f, MODEL_MAX_ITEMS);
+    E->target_is_categorical = get_int(f) != 0;
+    get_dict(f, &E->target_classes);
+
+    int width = 0, ok = 1;
+    for (int c = 0; c < E->n_cols; c++) {
+        if (E->original_to_encoded[c] != width) ok = 0;
+        width += E->columns[c].is_categorical ? E->columns[c].categories.count : 1;
+    }
+    return ok && width == E->n_encoded_cols;
+}
+
+// Every node must stay inside the node array and split on a real column
+static int nodes_valid(int n, const int *feature, const int *child, int d) {
+    for (int i = 0; i < n; i++) {
+        if (feature[i] < 0 || feature[i] >= d) return 0;
+        if (child[i] < 0 || child[i] >= n) return 0;
+        if (child[i] != i && child[i] + 1 >= n) return 0;
+    }
+    return 1;
+}
+
+static int get_flat_tree(ModelFile *f, FlatTree *F, int d) {
+    F->n_nodes = get_count(f, MODEL_MAX_ITEMS);
+    F->depth = get_count(f, F->n_nodes);
+    F->feature = get_array(f, sizeof(int), F->n_nodes);
+    F->threshold = get_array(f, sizeof(double), F->n_nodes);
+    F->child = get_array(f, sizeof(int), F->n_nodes);
+    F->label = get_array(f, sizeof(int), F->n_nodes);
+    return F->n_nodes > 0 && nodes_valid(F->n_nodes, F->feature, F->child, d);
+}
+
+static int get_gbm(ModelFile *f, GbmModel *G, int d) {
+    G->loss = get_int(f) == GBM_SQUARED ? GBM_SQUARED : GBM_LOGISTIC;
+    G->base_score = get_double(f);
+    G->n_trees = G->cap_trees = get_count(f, MODEL_MAX_ITEMS);
+    G->root = get_array(f, sizeof(int), G->n_trees);
+    G->depth = get_array(f, sizeof(int), G->n_trees);
+    G->n_nodes = G->cap_nodes = get_count(f, MODEL_MAX_ITEMS);
+    G->feature = get_array(f, sizeof(int), G->n_nodes);
+    G->threshold = get_array(f, sizeof(double), G->n_nodes);
+    G->child = get_array(f, sizeof(int), G->n_nodes);
+    G->value = get_array(f, sizeof(double), G->n_nodes);
+    for (int t = 0; t < G->n_trees; t++)
+        if (G->root[t] < 0 || G->root[t] >= G->n_nodes || G->depth[t] < 0) return 0;
+    return nodes_valid(G->n_nodes, G->feature, G->child, d);
+}
+
+// Read a file written by model_save into M. Returns -1 (with a message and
+// M left empty) when the file is missing, from another version or damaged.
+int model_load(const char *path, ModelBundle *M) {
+    memset(M, 0, sizeof(*M));
+    ModelFile f = { fopen(path, "rb"), 0 };
+    if (!f.fp) {
+        fprintf(stderr, "Error: Cannot open model file %s\n", path);
+        return -1;
+    }
+
+    char magic[8];
+    get(&f, magic, 1, 8);
+    if (f.failed || memcmp(magic, MODEL_MAGIC, 8) != 0) {
+        fprintf(stderr, "Error: %s is not a model file\n", path);
+        fclose(f.fp);
+        return -1;
+    }
+    int version = get_int(&f);
+    if (version != MODEL_VERSION || get_int(&f) != MODEL_BYTE_ORDER ||
+        get_int(&f) != (int)sizeof(double)) {
+        fprintf(stderr, "Error: %s was written by another version (%d) or machine type\n",
+                path, version);
+        fclose(f.fp);
+        return -1;
+    }
+    get_str(&f, M->target, MAX_STR);
+
+    int ok = get_encoding(&f, &M->encoding);
+    int d = M->n_features = get_count(&f, MODEL_MAX_ITEMS);
+    if (M->encoding.n_encoded_cols != d) ok = 0;
+    M->stats.n_numeric = d;
+    M->stats.means = get_array(&f, sizeof(double), d);
+    M->stats.stds = get_array(&f, sizeof(double), d);
+
+    M->w_log = get_array(&f, sizeof(double), d);
+    M->b_log = get_double(&f);
+
+    GNBModel *nb = &M->nb;
+    naive_bayes_init(nb, d);
+    int nc = get_count(&f, d > 0 ? MODEL_MAX_ITEMS / d : 0);
+    nb->classes = get_array(&f, sizeof(int), nc);
+    nb->counts = get_array(&f, sizeof(long long), nc);
+    nb->priors = get_array(&f, sizeof(double), nc);
+    nb->means = load_alloc(sizeof(double *), nc);
+    nb->vars = load_alloc(sizeof(double *), nc);
+    nb->num_classes = nc;
+    for (int c = 0; c < nc; c++) {
+        nb->means[c] = get_array(&f, sizeof(double), d);
+        nb->vars[c] = get_array(&f, sizeof(double), d);
+    }
+    nb->log_const = get_array(&f, sizeof(double), nc);
+    nb->lin = get_array(&f, sizeof(double), nc * d);
+    nb->quad = get_array(&f, sizeof(double), nc * d);
+
+    ok &= get_flat_tree(&f, &M->tree, d);
+
+    RandomForest *RF = &M->forest;
+    int n_trees = get_count(&f, MODEL_MAX_ITEMS);
+    RF->n_classes = get_count(&f, MODEL_MAX_ITEMS);
+    RF->labels = get_array(&f, sizeof(int), RF->n_classes);
+    RF->oob_accuracy = get_double(&f);
+    RF->trees = load_alloc(sizeof(FlatTree), n_trees);
+    for (RF->n_trees = 0; RF->n_trees < n_trees && !f.failed; RF->n_trees++) {
+        FlatTree *T = &RF->trees[RF->n_trees];
+        ok &= get_flat_tree(&f, T, d);
+        for (int i = 0; i < T->n_nodes; i++)
+            if (T->child[i] == i && (T->label[i] < 0 || T->label[i] >= RF->n_classes)) ok = 0;
+    }
+
+    ok &= get_gbm(&f, &M->gbm, d);
+    M->w_lin = get_array(&f, sizeof(double), d);
+    M->b_lin = get_double(&f);
+    ok &= get_gbm(&f, &M->gbr, d);
+    if (get_int(&f) != MODEL_END) f.failed = 1;
+    fclose(f.fp);
+
+    if (f.failed || !ok) {
+        fprintf(stderr, "Error: Model file %s is truncated or damaged\n", path);
+        model_bundle_free(M);
+        return -1;
+    }
+    return 0;
+}
+
+// Only for bundles filled by model_load: main saves the models it trained
+// through a bundle of borrowed pointers and frees them itself
+void model_bundle_free(ModelBundle *M) {
+    encoding_info_free(&M->encoding);
+    stats_free(&M->stats);
+    free(M->w_log);
+    naive_bayes_free(&M->nb);
+    flat_tree_free(&M->tree);
+    random_forest_free(&M->forest);
+    gbm_free(&M->gbm);
+    free(M->w_lin);
+    gbm_free(&M->gbr);
+    memset(M, 0, sizeof(*M));
+}
+
+// The encoding section alone, at the current position of an open file: used
+// by the dataset cache. Both return -1 on a short write or a bad section.
+int encoding_write(FILE *fp, const EncodingInfo *E) {
+    ModelFile f = { fp, 0 };
+    put_encoding(&f, E);
+    return f.failed ? -1 : 0;
+}
+
+int encoding_read(FILE *fp, EncodingInfo *E) {
+    ModelFile f = { fp, 0 };
+    memset(E, 0, sizeof(*E));
+    if (!get_encoding(&f, E) || f.failed) {
+        encoding_info_free(E);
+        return -1;
+    }
+    return 0;
+}
+
+const char *const BUNDLE_MODEL_NAMES[BUNDLE_N_MODELS] = {
+    "logistic", "naive_bayes", "tree", "forest", "gbm", "linear", "gbr"
+};
+
+int bundle_model_find(const char *name) {
+    for (int m = 0; m < BUNDLE_N_MODELS; m++)
+        if (strcmp(BUNDLE_MODEL_NAMES[m], name) == 0) return m;
+    return -1;
+}
+
+// X's rows in the mixed layout, standardized like the training rows were
+void bundle_features(ModelBundle *M, const Frame *X, FeatureStore *F) {
+    features_from_frame(X, &M->encoding, F);
+    features_standardize(F, &M->stats);
+}
+
+// Score every row of X (and F, from bundle_features) with one model: class
+// codes go to cls for classifiers, values to value for regressors
+void bundle_predict(ModelBundle *M, BundleModel model, Frame *X, FeatureStore *F,
+                    int *cls, double *value) {
+    switch (model) {
+    case BUNDLE_LOGISTIC:    logistic_regression_predict_fs(F, M->w_log, M->b_log, cls); break;
+    case BUNDLE_NAIVE_BAYES: naive_bayes_predict_fs(&M->nb, F, cls); break;
+    case BUNDLE_TREE:        flat_tree_predict(&M->tree, X, cls); break;
+    case BUNDLE_FOREST:      random_forest_predict(&M->forest, X, cls); break;
+    case BUNDLE_GBM:         gbm_predict(&M->gbm, X, cls); break;
+    case BUNDLE_LINEAR:      linear_regression_predict_fs(F, M->w_lin, M->b_lin, value); break;
+    case BUNDLE_GBR:         gbm_predict_raw(&M->gbr, X, value); break;
+    default: break;
+    }
+}
+
+// One prediction as text: the class as written in the training file, or the value
+void bundle_format(const ModelBundle *M, BundleModel model, int cls, double value,
+                   char *out, size_t cap) {
+    const StrDict *classes = &M->encoding.target_classes;
+    if (model >= BUNDLE_LINEAR)
+        snprintf(out, cap, "%.6g", value);
+    else if (M->encoding.target_is_categorical && cls >= 0 && cls < classes->count)
+        snprintf(out, cap, "%s", classes->keys[cls]);
+    else
+        snprintf(out, cap, "%d", cls);
+}
@@ -0,0 +1,38 @@
+// FILE: model_io.h
+
+#ifndef MODEL_IO_H
+#define MODEL_IO_H
+
+#include <stdio.h>
+#include "data_types.h"
+
+#define MODEL_MAGIC "MLPMODEL"   // first 8 bytes of every model file
+#define MODEL_VERSION 1          // bump whenever the layout below changes
+
+// The models of a bundle, in file order
+typedef enum {
+    BUNDLE_LOGISTIC,
+    BUNDLE_NAIVE_BAYES,
+    BUNDLE_TREE,
+    BUNDLE_FOREST,
+    BUNDLE_GBM,
+    BUNDLE_LINEAR,      // regressors from here on
+    BUNDLE_GBR,
+    BUNDLE_N_MODELS
+} BundleModel;
+
+extern const char *const BUNDLE_MODEL_NAMES[BUNDLE_N_MODELS];
+
+int model_save(const char *path, const ModelBundle *M);
+int model_load(const char *path, ModelBundle *M);
+void model_bundle_free(ModelBundle *M);
+int encoding_write(FILE *fp, const EncodingInfo *E);
+int encoding_read(FILE *fp, EncodingInfo *E);
+int bundle_model_find(const char *name);
+void bundle_features(ModelBundle *M, const Frame *X, FeatureStore *F);
+void bundle_predict(ModelBundle *M, BundleModel model, Frame *X, FeatureStore *F,
+                    int *cls, double *value);
+void bundle_format(const ModelBundle *M, BundleModel model, int cls, double value,
+                   char *out, size_t cap);
+
+#endif
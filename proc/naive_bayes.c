@@ -1,125 +1,312 @@
-// FILE: naive_bayes.c
-
-#include <stdlib.h>
-#include <math.h>
-#include "naive_bayes.h"
-
-// Gaussian log probability
-static double gaussian_logpdf(double x, double mean, double var) {
-    if (var < 1e-9) var = 1e-9; // avoid zero variance
-    return -0.5 * log(2 * M_PI * var) - 0.5 * ((x - mean) * (x - mean)) / var;
-}
-
-// Find unique class labels
-static int *unique_labels(const int *y, int n, int *out_k) {
-    int *vals = malloc(n * sizeof(int));
-    int k = 0;
-    for (int i = 0; i < n; i++) {
-        int v = y[i];
-        int found = 0;
-        for (int j = 0; j < k; j++) {
-            if (vals[j] == v) { found = 1; break; }
-        }
-        if (!found) vals[k++] = v;
-    }
-    *out_k = k;
-    return vals;
-}
-
-GNBModel naive_bayes_fit(Frame *X, int *y) {
-    GNBModel model;
-    int n = X->rows;
-    int d = X->cols;
-    
-    int k;
-    int *classes = unique_labels(y, n, &k); // distinct labels
-    model.num_classes = k;
-    model.classes = classes;
-
-    model.priors = malloc(k * sizeof(double));
-    model.means = malloc(k * sizeof(double *));
-    model.vars = malloc(k * sizeof(double *));
-
-    for (int i = 0; i < k; i++) {
-        int c = classes[i];
-        int count = 0;
-
-        for (int t = 0; t < n; t++)
-            if (y[t] == c) count++;
-
-        model.priors[i] = (double)count / (double)n;
-
-        double *mean = malloc(d * sizeof(double));
-        double *var = malloc(d * sizeof(double));
-        for (int j = 0; j < d; j++) {
-            mean[j] = 0.0;
-            var[j] = 0.0;
-        }
-
-        // sum feature values for this class
-        for (int t = 0; t < n; t++) {
-            if (y[t] == c) {
-                for (int j = 0; j < d; j++)
-                    mean[j] += X->data[t][j];
-            }
-        }
-        for (int j = 0; j < d; j++)
-            mean[j] /= (double)count;
-
-        // compute variance
-        for (int t = 0; t < n; t++) {
-            if (y[t] == c) {
-                for (int j = 0; j < d; j++) {
-                    double diff = X->data[t][j] - mean[j];
-                    var[j] += diff * diff;
-                }
-            }
-        }
-        for (int j = 0; j < d; j++) {
-            var[j] /= (double)count;
-            var[j] += 1e-9; // smoothing
-        }
-
-        model.means[i] = mean;
-        model.vars[i] = var;
-    }
-
-    return model;
-}
-
-void naive_bayes_predict(GNBModel *model, Frame *X, int *pred) {
-    int n = X->rows;
-    int d = X->cols;
-    
-    for (int i = 0; i < n; i++) {
-        double best = -1e300;
-        int best_class = 0;
-
-        // choose class with highest log-probability
-        for (int c = 0; c < model->num_classes; c++) {
-            double logp = log(model->priors[c]);
-            for (int j = 0; j < d; j++) {
-                logp += gaussian_logpdf(X->data[i][j],
-                                       model->means[c][j],
-                                       model->vars[c][j]);
-            }
-            if (logp > best) {
-                best = logp;
-                best_class = model->classes[c];
-            }
-        }
-        pred[i] = best_class;
-    }
-}
-
-void naive_bayes_free(GNBModel *model) {
-    // free allocated memory
-    for (int i = 0; i < model->num_classes; i++) {
-        free(model->means[i]);
-        free(model->vars[i]);
-    }
-    free(model->means);
-    free(model->vars);
-    free(model->priors);
-    free(model->classes);
-}
+// FILE: naive_bayes.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "naive_bayes.h"
+#include "feature_store.h"
+#include "parallel.h"
+
+// Table the expanded Gaussian log density of every class (see GNBModel)
+static void naive_bayes_prepare(GNBModel *model) {
+    int k = model->num_classes, d = model->num_features;
+    model->log_const = realloc(model->log_const, (k > 0 ? k : 1) * sizeof(double));
+    model->lin = realloc(model->lin, ((size_t)k * d + 1) * sizeof(double));
+    model->quad = realloc(model->quad, ((size_t)k * d + 1) * sizeof(double));
+
+    for (int c = 0; c < k; c++) {
+        double lc = log(model->priors[c]);
+        for (int j = 0; j < d; j++) {
+            double mean = model->means[c][j];
+            double var = model->vars[c][j];
+            if (var < 1e-9) var = 1e-9; // avoid zero variance
+            lc += -0.5 * log(2 * M_PI * var) - 0.5 * mean * mean / var;
+            model->lin[(size_t)c * d + j] = mean / var;
+            model->quad[(size_t)c * d + j] = -0.5 / var;
+        }
+        model->log_const[c] = lc;
+    }
+}
+
+// Class scores of one tile: xt holds NB_TILE rows transposed (column j at
+// xt[j * NB_TILE]), so the inner loop runs over rows and vectorizes.
+// scores[c * NB_TILE + r] gets base[c] + sum_j x_rj (lin_cj + x_rj quad_cj).
+static void score_tile(const double *xt, int d, const double *lin, const double *quad,
+                       const double *base, int k, double *scores) {
+    for (int c = 0; c < k; c++) {
+        const double *a = lin + (size_t)c * d;
+        const double *b = quad + (size_t)c * d;
+        double acc[NB_TILE];
+        for (int r = 0; r < NB_TILE; r++) acc[r] = base[c];
+        for (int j = 0; j < d; j++) {
+            const double *col = xt + (size_t)j * NB_TILE;
+            double aj = a[j], bj = b[j];
+            for (int r = 0; r < NB_TILE; r++) acc[r] += col[r] * (aj + bj * col[r]);
+        }
+        for (int r = 0; r < NB_TILE; r++) scores[c * NB_TILE + r] = acc[r];
+    }
+}
+
+// Label of the highest scoring class of tile row r (first one on ties)
+static int tile_best(const GNBModel *model, const double *scores, int r) {
+    double best = -1e300;
+    int best_class = 0;
+    for (int c = 0; c < model->num_classes; c++) {
+        if (scores[c * NB_TILE + r] > best) {
+            best = scores[c * NB_TILE + r];
+            best_class = model->classes[c];
+        }
+    }
+    return best_class;
+}
+
+// Empty model over num_features columns, ready for naive_bayes_partial_fit_fs
+void naive_bayes_init(GNBModel *model, int num_features) {
+    memset(model, 0, sizeof(*model));
+    model->num_features = num_features;
+}
+
+// Class index of every row, adding labels the model has not seen yet (with
+// no rows so far) to the end of its class list
+static int *class_indices(GNBModel *model, const int *y, int n) {
+    int *cls = malloc((n > 0 ? n : 1) * sizeof(int));
+    int d = model->num_features;
+    for (int i = 0; i < n; i++) {
+        int c = 0;
+        while (c < model->num_classes && model->classes[c] != y[i]) c++;
+        if (c == model->num_classes) {
+            int k = ++model->num_classes;
+            model->classes = realloc(model->classes, k * sizeof(int));
+            model->counts = realloc(model->counts, k * sizeof(long long));
+            model->priors = realloc(model->priors, k * sizeof(double));
+            model->means = realloc(model->means, k * sizeof(double *));
+            model->vars = realloc(model->vars, k * sizeof(double *));
+            if (!model->classes || !model->counts || !model->priors || !model->means || !model->vars) {
+                fprintf(stderr, "Error: Out of memory for naive Bayes classes\n");
+                exit(1);
+            }
+            model->classes[c] = y[i];
+            model->counts[c] = 0;
+            model->means[c] = calloc(d > 0 ? d : 1, sizeof(double));
+            model->vars[c] = calloc(d > 0 ? d : 1, sizeof(double));
+        }
+        cls[i] = c;
+    }
+    return cls;
+}
+
+// One pass over a batch: every task keeps a running count, mean and sum of
+// squared deviations (Welford) per class and numeric column over its rows;
+// one hot columns only count set flags in mean.
+typedef struct {
+    const FeatureStore *F;
+    const int *cls;
+    int k;
+    int d;
+    long long *count;   // tasks x k
+    double *mean;       // tasks x k x d
+    double *m2;
+} StatsJob;
+
+static inline void welford(double *mean, double *m2, double x, double inv_n) {
+    double delta = x - *mean;
+    *mean += delta * inv_n;
+    *m2 += delta * (x - *mean);
+}
+
+static void stats_task(void *ctx, int task, int begin, int end) {
+    StatsJob *job = ctx;
+    int d = job->d;
+    long long *count = job->count + (size_t)task * job->k;
+    double *mean = job->mean + (size_t)task * job->k * d;
+    double *m2 = job->m2 + (size_t)task * job->k * d;
+
+    for (int i = begin; i < end; i++) {
+        int c = job->cls[i];
+        double inv_n = 1.0 / (double)++count[c];
+        double *mc = mean + (size_t)c * d, *sc = m2 + (size_t)c * d;
+        const FeatureStore *F = job->F;
+        const feat_t *x = features_num(F, i);
+        const int *code = features_codes(F, i);
+        for (int m = 0; m < F->n_num; m++) {
+            int j = F->num_cols[m];
+            welford(mc + j, sc + j, x[m], inv_n);
+        }
+        for (int m = 0; m < F->n_cat; m++)
+            if (code[m] >= 0) mc[code[m]] += 1.0;
+    }
+}
+
+// Fold a batch into the model: each task's statistics are merged in task
+// order with the pairwise (Chan) update, then priors, variances and the
+// scoring tables are refreshed
+static void naive_bayes_update(GNBModel *model, const FeatureStore *F, const int *y) {
+    int n = F->rows;
+    int *cls = class_indices(model, y, n);
+    int k = model->num_classes, d = model->num_features;
+    int tasks = parallel_tasks(n);
+    StatsJob job = { F, cls, k, d,
+                     calloc((size_t)tasks * k + 1, sizeof(long long)),
+                     calloc((size_t)tasks * k * d + 1, sizeof(double)),
+                     calloc((size_t)tasks * k * d + 1, sizeof(double)) };
+    if (!job.count || !job.mean || !job.m2) {
+        fprintf(stderr, "Error: Out of memory fitting naive Bayes\n");
+        exit(1);
+    }
+    parallel_for(n, stats_task, &job);
+
+    for (int t = 0; t < tasks; t++) {
+        for (int c = 0; c < k; c++) {
+            long long nb = job.count[(size_t)t * k + c];
+            if (nb == 0) continue;
+            double *mb = job.mean + ((size_t)t * k + c) * d;
+            double *sb = job.m2 + ((size_t)t * k + c) * d;
+
+            // set flag share p: standardized mean (p - shift) / scale and
+            // variance p(1 - p) / scale^2
+            for (int m = 0; m < F->n_cat; m++) {
+                for (int j = F->cat_start[m]; j < F->cat_start[m] + F->cat_size[m]; j++) {
+                    double p = mb[j] / (double)nb;
+                    mb[j] = (p - F->shift[j]) / F->scale[j];
+                    sb[j] = nb * p * (1.0 - p) / (F->scale[j] * F->scale[j]);
+                }
+            }
+
+            long long na = model->counts[c];
+            double nab = (double)(na + nb);
+            double *mean = model->means[c], *var = model->vars[c];
+            for (int j = 0; j < d; j++) {
+                double m2a = na > 0 ? (var[j] - 1e-9) * na : 0.0; // undo smoothing
+                double delta = mb[j] - mean[j];
+                mean[j] += delta * nb / nab;
+                var[j] = m2a + sb[j] + delta * delta * ((double)na * nb / nab);
+                var[j] = var[j] / nab + 1e-9; // smoothing
+            }
+            model->counts[c] = na + nb;
+        }
+    }
+
+    long long total = 0;
+    for (int c = 0; c < k; c++) total += model->counts[c];
+    for (int c = 0; c < k; c++) model->priors[c] = (double)model->counts[c] / (double)total;
+    naive_bayes_prepare(model);
+
+    free(job.count);
+    free(job.mean);
+    free(job.m2);
+    free(cls);
+}
+
+GNBModel naive_bayes_fit_fs(FeatureStore *F, int *y) {
+    GNBModel model;
+    naive_bayes_init(&model, F->cols);
+    naive_bayes_update(&model, F, y);
+    return model;
+}
+
+// Add a batch of rows to a fitted (or naive_bayes_init) model in place; the
+// result matches one fit over every batch seen so far
+void naive_bayes_partial_fit_fs(GNBModel *model, FeatureStore *F, int *y) {
+    naive_bayes_update(model, F, y);
+}
+
+// Rows are scored in parallel chunks with the per class tables of
+// naive_bayes_predict_fs
+typedef struct {
+    const GNBModel *model;
+    const FeatureStore *F;
+    const double *base;
+    const double *delta;
+    const double *lin;
+    const double *quad;
+    int *pred;
+} PredictJob;
+
+void naive_bayes_free(GNBModel *model) {
+    // free allocated memory
+    for (int i = 0; i < model->num_classes; i++) {
+        free(model->means[i]);
+        free(model->vars[i]);
+    }
+    free(model->means);
+    free(model->vars);
+    free(model->priors);
+    free(model->classes);
+    free(model->counts);
+    free(model->log_const);
+    free(model->lin);
+    free(model->quad);
+}
+
+// Numeric columns go through the tile kernel with the compact lin/quad of
+// the job; set flags add their delta per row
+static void predict_task(void *ctx, int task, int begin, int end) {
+    PredictJob *job = ctx;
+    const GNBModel *model = job->model;
+    const FeatureStore *F = job->F;
+    int k = model->num_classes, n_num = F->n_num;
+    double *xt = calloc((size_t)(n_num > 0 ? n_num : 1) * NB_TILE, sizeof(double));
+    double *scores = malloc((size_t)k * NB_TILE * sizeof(double));
+    (void)task;
+
+    for (int i = begin; i < end; i += NB_TILE) {
+        int m = end - i < NB_TILE ? end - i : NB_TILE;
+        for (int r = 0; r < m; r++) {
+            const feat_t *x = features_num(F, i + r);
+            for (int j = 0; j < n_num; j++) xt[(size_t)j * NB_TILE + r] = x[j];
+        }
+        score_tile(xt, n_num, job->lin, job->quad, job->base, k, scores);
+
+        for (int r = 0; r < m; r++) {
+            const int *code = features_codes(F, i + r);
+            for (int c = 0; c < k; c++) {
+                const double *dc = job->delta + (size_t)c * F->cols;
+                for (int q = 0; q < F->n_cat; q++)
+                    if (code[q] >= 0) scores[c * NB_TILE + r] += dc[code[q]];
+            }
+            job->pred[i + r] = tile_best(model, scores, r);
+        }
+    }
+    free(xt);
+    free(scores);
+}
+
+// One hot columns only take two values, so their terms are tabled per class:
+// base sums every flag at 0 and delta[j] is the gain when flag j is set
+void naive_bayes_predict_fs(GNBModel *model, FeatureStore *F, int *pred) {
+    int k = model->num_classes, d = model->num_features, n_num = F->n_num;
+    double *base = malloc(k * sizeof(double));
+    double *delta = calloc((size_t)k * F->cols, sizeof(double));
+    double *lin = malloc((size_t)k * (n_num > 0 ? n_num : 1) * sizeof(double));
+    double *quad = malloc((size_t)k * (n_num > 0 ? n_num : 1) * sizeof(double));
+
+    for (int c = 0; c < k; c++) {
+        const double *a = model->lin + (size_t)c * d;
+        const double *b = model->quad + (size_t)c * d;
+        base[c] = model->log_const[c];
+        for (int m = 0; m < n_num; m++) {
+            lin[(size_t)c * n_num + m] = a[F->num_cols[m]];
+            quad[(size_t)c * n_num + m] = b[F->num_cols[m]];
+        }
+        double *dc = delta + (size_t)c * F->cols;
+        for (int m = 0; m < F->n_cat; m++) {
+            for (int j = F->cat_start[m]; j < F->cat_start[m] + F->cat_size[m]; j++) {
+                double x0 = (0.0 - F->shift[j]) / F->scale[j];
+                double x1 = (1.0 - F->shift[j]) / F->scale[j];
+                double lp0 = x0 * (a[j] + x0 * b[j]);
+                double lp1 = x1 * (a[j] + x1 * b[j]);
+                base[c] += lp0;
+                dc[j] = lp1 - lp0;
+            }
+        }
+    }
+
+    PredictJob job = { model, F, base, delta, lin, quad, pred };
+    parallel_for(F->rows, predict_task, &job);
+
+    free(base);
+    free(delta);
+    free(lin);
+    free(quad);
+}
@@ -1,12 +1,16 @@
-// FILE: naive_bayes.h
-
-#ifndef NAIVE_BAYES_H
-#define NAIVE_BAYES_H
-
-#include "data_types.h"
-
-GNBModel naive_bayes_fit(Frame *X, int *y);
-void naive_bayes_predict(GNBModel *model, Frame *X, int *pred);
-void naive_bayes_free(GNBModel *model);
-
+// FILE: naive_bayes.h
+
+#ifndef NAIVE_BAYES_H
+#define NAIVE_BAYES_H
+
+#include "data_types.h"
+
+#define NB_TILE 16   // rows scored together, transposed so classes sweep columns
+
+void naive_bayes_init(GNBModel *model, int num_features);
+GNBModel naive_bayes_fit_fs(FeatureStore *F, int *y);
+void naive_bayes_partial_fit_fs(GNBModel *model, FeatureStore *F, int *y);
+void naive_bayes_predict_fs(GNBModel *model, FeatureStore *F, int *pred);
+void naive_bayes_free(GNBModel *model);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,165 @@
+// FILE: parallel.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "parallel.h"
+
+// Shared worker pool. [0, n) is always cut into parallel_tasks(n) contiguous
+// chunks whose bounds depend only on n and the thread count, so callers that
+// keep one accumulator per task and reduce them in task order get the same
+// bits on every run with the same thread count.
+
+static int n_threads = 0;           // 0 = not configured yet
+static pthread_t *workers = NULL;
+static int n_workers = 0;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t work_done = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t submit = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned long generation = 0;
+static int stopping = 0;
+static parallel_fn job_fn;
+static void *job_ctx;
+static int job_n, job_tasks;
+static int next_task, tasks_left;
+
+static __thread int inside_pool = 0;
+
+static void run_task(int t) {
+    int begin = (int)((long long)job_n * t / job_tasks);
+    int end = (int)((long long)job_n * (t + 1) / job_tasks);
+    job_fn(job_ctx, t, begin, end);
+}
+
+// Claim and run tasks of the current job until none are left
+static void drain(void) {
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        int t = next_task < job_tasks ? next_task++ : -1;
+        pthread_mutex_unlock(&lock);
+        if (t < 0) return;
+
+        run_task(t);
+
+        pthread_mutex_lock(&lock);
+        if (--tasks_left == 0) pthread_cond_broadcast(&work_done);
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+static void *worker_main(void *arg) {
+    (void)arg;
+    inside_pool = 1;
+    pthread_mutex_lock(&lock);
+    unsigned long seen = generation;
+    pthread_mutex_unlock(&lock);
+
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        while (generation == seen && !stopping) pthread_cond_wait(&work_ready, &lock);
+        if (stopping) {
+            pthread_mutex_unlock(&lock);
+            return NULL;
+        }
+        seen = generation;
+        pthread_mutex_unlock(&lock);
+
+        drain();
+    }
+}
+
+static void start_workers(void) {
+    n_workers = parallel_threads() - 1;
+    if (n_workers <= 0) return;
+
+    workers = malloc(n_workers * sizeof(pthread_t));
+    for (int i = 0; i < n_workers; i++) {
+        if (!workers || pthread_create(&workers[i], NULL, worker_main, NULL) != 0) {
+            fprintf(stderr, "Error: Could not start worker threads\n");
+            exit(1);
+        }
+    }
+}
+
+// Thread count for later parallel_for calls (n <= 0 picks one per core)
+void parallel_set_threads(int n) {
+    parallel_shutdown();
+    if (n <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        n = cores > 0 ? (int)cores : 1;
+    }
+    n_threads = n;
+}
+
+int parallel_threads(void) {
+    if (n_threads == 0) parallel_set_threads(0);
+    return n_threads;
+}
+
+// Number of chunks parallel_for(n, ...) will run
+int parallel_tasks(int n) {
+    int t = parallel_threads();
+    if (t > n) t = n;
+    return t > 0 ? t : 1;
+}
+
+static void run_job(int n, int tasks, parallel_fn fn, void *ctx) {
+    // nested or concurrent calls run their chunks inline, in the same order
+    if (tasks == 1 || inside_pool || pthread_mutex_trylock(&submit) != 0) {
+        for (int t = 0; t < tasks; t++)
+            fn(ctx, t, (int)((long long)n * t / tasks), (int)((long long)n * (t + 1) / tasks));
+        return;
+    }
+
+    if (!workers && parallel_threads() > 1) start_workers();
+
+    pthread_mutex_lock(&lock);
+    job_fn = fn;
+    job_ctx = ctx;
+    job_n = n;
+    job_tasks = tasks;
+    next_task = 0;
+    tasks_left = tasks;
+    generation++;
+    pthread_cond_broadcast(&work_ready);
+    pthread_mutex_unlock(&lock);
+
+    inside_pool = 1;
+    drain();
+    inside_pool = 0;
+
+    pthread_mutex_lock(&lock);
+    while (tasks_left > 0) pthread_cond_wait(&work_done, &lock);
+    pthread_mutex_unlock(&lock);
+
+    pthread_mutex_unlock(&submit);
+}
+
+void parallel_for(int n, parallel_fn fn, void *ctx) {
+    run_job(n, parallel_tasks(n), fn, ctx);
+}
+
+// One task per item (begin = task, end = task + 1), claimed by whichever
+// thread is free: for a few uneven items such as whole model fits
+void parallel_run(int n, parallel_fn fn, void *ctx) {
+    if (n > 0) run_job(n, n, fn, ctx);
+}
+
+void parallel_shutdown(void) {
+    if (!workers) return;
+
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    pthread_cond_broadcast(&work_ready);
+    pthread_mutex_unlock(&lock);
+
+    for (int i = 0; i < n_workers; i++) pthread_join(workers[i], NULL);
+    free(workers);
+    workers = NULL;
+    n_workers = 0;
+    stopping = 0;
+}
@@ -0,0 +1,16 @@
+// FILE: parallel.h
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Runs fn on the rows [begin, end) of one chunk; task is the chunk number
+typedef void (*parallel_fn)(void *ctx, int task, int begin, int end);
+
+void parallel_set_threads(int n);
+int parallel_threads(void);
+int parallel_tasks(int n);
+void parallel_for(int n, parallel_fn fn, void *ctx);
+void parallel_run(int n, parallel_fn fn, void *ctx);
+void parallel_shutdown(void);
+
+#endif
@@ -1,149 +1,190 @@
-//FILE: preprocessing.c
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include "preprocessing.h"
-
-int is_numeric_string(const char *s) {
-    if (!s || !*s) return 0;
-    int has_digit = 0;
-    int dot_count = 0;
-    int i = 0;
-    
-
-    if (s[i] == '-' || s[i] == '+') i++;
-    
-    for (; s[i]; i++) {
-        if (isdigit(s[i])) {
-            has_digit = 1;
-        } else if (s[i] == '.') {
-            dot_count++;
-            if (dot_count > 1) return 0;
-        } else if (s[i] != ' ') {
-            return 0;
-        }
-    }
-    return has_digit;
-}
-
-int map_income_to_binary(const char *income_str) {
-    char clean[MAX_STR];
-    strncpy(clean, income_str, MAX_STR - 1);
-    clean[MAX_STR - 1] = '\0';
-    
-    // Remove spaces and .
-    int j = 0;
-    for (int i = 0; clean[i]; i++) {
-        if (clean[i] != ' ' && clean[i] != '.') {
-            clean[j++] = tolower(clean[i]);
-        }
-    }
-    clean[j] = '\0';
-    
-    if (strstr(clean, ">50k")) return 1;
-    if (strstr(clean, "<=50k")) return 0;
-    
-
-    return 0;
-}
-
-void detect_column_types(char data[MAX_ROWS][MAX_COLS][MAX_STR], int n_rows,
-                        char headers[MAX_COLS][MAX_STR], int n_cols,
-                        EncodingInfo *encoding_info) {
-    encoding_info->n_cols = n_cols;
-    
-    for (int c = 0; c < n_cols; c++) {
-        strncpy(encoding_info->columns[c].name, headers[c], MAX_STR - 1);
-        strncpy(encoding_info->original_names[c], headers[c], MAX_STR - 1);
-        
-        //check first 100 not empty values to see if numeric
-        int numeric_count = 0;
-        int checked = 0;
-        for (int r = 0; r < n_rows && checked < 100; r++) {
-            if (data[r][c][0] != '\0') {
-                if (is_numeric_string(data[r][c])) numeric_count++;
-                checked++;
-            }
-        }
-        
-        //if msot are numeric, treat as numeric
-        if (checked > 0 && (double)numeric_count / checked > 0.8) {
-            encoding_info->columns[c].is_categorical = 0;
-            encoding_info->columns[c].n_categories = 0;
-        } else {
-            //find unique values
-            encoding_info->columns[c].is_categorical = 1;
-            int n_cat = 0;
-            
-            for (int r = 0; r < n_rows && n_cat < MAX_CATEGORIES; r++) {
-                if (data[r][c][0] == '\0') continue;
-                
-                // check if category already exists
-                int exists = 0;
-                for (int k = 0; k < n_cat; k++) {
-                    if (strcmp(encoding_info->columns[c].categories[k], data[r][c]) == 0) {
-                        exists = 1;
-                        break;
-                    }
-                }
-                
-                if (!exists) {
-                    strncpy(encoding_info->columns[c].categories[n_cat], 
-                           data[r][c], MAX_STR - 1);
-                    encoding_info->columns[c].categories[n_cat][MAX_STR - 1] = '\0';
-                    n_cat++;
-                }
-            }
-            
-            encoding_info->columns[c].n_categories = n_cat;
-        }
-    }
-}
-
-void one_hot_encode_data(char raw_data[MAX_ROWS][MAX_COLS][MAX_STR],
-                        int n_rows, EncodingInfo *encoding_info,
-                        Frame *X_out) {
-    int out_col = 0;
-    
-    for (int c = 0; c < encoding_info->n_cols; c++) {
-        encoding_info->original_to_encoded[c] = out_col;
-        
-        if (!encoding_info->columns[c].is_categorical) {
-            //just convert
-            for (int r = 0; r < n_rows; r++) {
-                X_out->data[r][out_col] = atof(raw_data[r][c]);
-            }
-            strncpy(X_out->colnames[out_col], encoding_info->columns[c].name, MAX_STR - 1);
-            out_col++;
-        } else {
-            int n_cat = encoding_info->columns[c].n_categories;
-            
-            for (int cat_idx = 0; cat_idx < n_cat; cat_idx++) {
-                // create column name original_name_category
-                snprintf(X_out->colnames[out_col], MAX_STR, "%s_%s",
-                        encoding_info->columns[c].name,
-                        encoding_info->columns[c].categories[cat_idx]);
-                
-                // Fill column with 0 and 1
-                for (int r = 0; r < n_rows; r++) {
-                    if (strcmp(raw_data[r][c], 
-                              encoding_info->columns[c].categories[cat_idx]) == 0) {
-                        X_out->data[r][out_col] = 1.0;
-                    } else {
-                        X_out->data[r][out_col] = 0.0;
-                    }
-                }
-                out_col++;
-            }
-        }
-    }
-    
-    X_out->rows = n_rows;
-    X_out->cols = out_col;
-    encoding_info->n_encoded_cols = out_col;
-    
-    printf("one hot encoding: %d original columns -> %d encoded columns\n",
-           encoding_info->n_cols, out_col);
-}
\ No newline at end of file
+//FILE: preprocessing.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "preprocessing.h"
+#include "frame.h"
+#include "str_dict.h"
+
+int is_numeric_string(const char *s) {
+    if (!s || !*s) return 0;
+    int has_digit = 0;
+    int dot_count = 0;
+    int i = 0;
+    
+
+    if (s[i] == '-' || s[i] == '+') i++;
+    
+    for (; s[i]; i++) {
+        if (isdigit(s[i])) {
+            has_digit = 1;
+        } else if (s[i] == '.') {
+            dot_count++;
+            if (dot_count > 1) return 0;
+        } else if (s[i] != ' ') {
+            return 0;
+        }
+    }
+    return has_digit;
+}
+
+int map_income_to_binary(const char *income_str) {
+    char clean[MAX_STR];
+    strncpy(clean, income_str, MAX_STR - 1);
+    clean[MAX_STR - 1] = '\0';
+    
+    // Remove spaces and .
+    int j = 0;
+    for (int i = 0; clean[i]; i++) {
+        if (clean[i] != ' ' && clean[i] != '.') {
+            clean[j++] = tolower(clean[i]);
+        }
+    }
+    clean[j] = '\0';
+    
+    if (strstr(clean, ">50k")) return 1;
+    if (strstr(clean, "<=50k")) return 0;
+    
+
+    return 0;
+}
+
+// data holds n_rows x n_cols cell strings, row-major. Categorical columns get
+// a dictionary built in one pass, and codes[r * n_cols + c] receives the
+// category code of every cell (-1 for numeric columns and empty cells).
+void detect_column_types(char **data, int n_rows,
+                        char (*headers)[MAX_STR], int n_cols,
+                        EncodingInfo *encoding_info, int *codes) {
+    encoding_info_init(encoding_info, n_cols);
+    
+    for (int c = 0; c < n_cols; c++) {
+        ColumnInfo *col = &encoding_info->columns[c];
+        strncpy(col->name, headers[c], MAX_STR - 1);
+        strncpy(encoding_info->original_names[c], headers[c], MAX_STR - 1);
+        dict_init(&col->categories);
+        
+        //check first 100 not empty values to see if numeric
+        int numeric_count = 0;
+        int checked = 0;
+        for (int r = 0; r < n_rows && checked < 100; r++) {
+            if (data[(size_t)r * n_cols + c][0] != '\0') {
+                if (is_numeric_string(data[(size_t)r * n_cols + c])) numeric_count++;
+                checked++;
+            }
+        }
+        
+        //if msot are numeric, treat as numeric
+        if (checked > 0 && (double)numeric_count / checked > 0.8) {
+            col->is_categorical = 0;
+            for (int r = 0; r < n_rows; r++) codes[(size_t)r * n_cols + c] = -1;
+        } else {
+            //intern every value, codes follow first appearance
+            col->is_categorical = 1;
+            for (int r = 0; r < n_rows; r++) {
+                const char *cell = data[(size_t)r * n_cols + c];
+                codes[(size_t)r * n_cols + c] =
+                    cell[0] == '\0' ? -1 : dict_intern(&col->categories, cell);
+            }
+        }
+    }
+}
+
+// Place every original column in the encoded layout: original_to_encoded and
+// n_encoded_cols from the column types and category counts
+void encoding_layout(EncodingInfo *encoding_info) {
+    int out_col = 0;
+    for (int c = 0; c < encoding_info->n_cols; c++) {
+        const ColumnInfo *col = &encoding_info->columns[c];
+        encoding_info->original_to_encoded[c] = out_col;
+        out_col += col->is_categorical ? col->categories.count : 1;
+    }
+    encoding_info->n_encoded_cols = out_col;
+}
+
+// Encoded column names: numeric columns keep their name, one hot columns
+// become original_name_category
+void encoding_colnames(const EncodingInfo *encoding_info, char (*colnames)[MAX_STR]) {
+    for (int c = 0; c < encoding_info->n_cols; c++) {
+        const ColumnInfo *col = &encoding_info->columns[c];
+        int j = encoding_info->original_to_encoded[c];
+        if (!col->is_categorical) {
+            strncpy(colnames[j], col->name, MAX_STR - 1);
+        } else {
+            for (int k = 0; k < col->categories.count; k++)
+                snprintf(colnames[j + k], MAX_STR, "%s_%s", col->name, col->categories.keys[k]);
+        }
+    }
+}
+
+void one_hot_encode_data(char **raw_data, const int *codes,
+                        int n_rows, EncodingInfo *encoding_info,
+                        Frame *X_out) {
+    int n_cols = encoding_info->n_cols;
+    encoding_layout(encoding_info);
+    frame_init(X_out, n_rows, encoding_info->n_encoded_cols);
+    encoding_colnames(encoding_info, X_out->colnames);
+
+    for (int c = 0; c < n_cols; c++) {
+        ColumnInfo *col = &encoding_info->columns[c];
+        int out_col = encoding_info->original_to_encoded[c];
+        
+        if (!col->is_categorical) {
+            //just convert
+            for (int r = 0; r < n_rows; r++) {
+                frame_row(X_out, r)[out_col] = atof(raw_data[(size_t)r * n_cols + c]);
+            }
+        } else {
+            // frame starts zeroed, so only the hot flag of each row is set
+            for (int r = 0; r < n_rows; r++) {
+                int code = codes[(size_t)r * n_cols + c];
+                if (code >= 0) frame_row(X_out, r)[out_col + code] = 1.0;
+            }
+        }
+    }
+    
+    printf("one hot encoding: %d original columns -> %d encoded columns\n",
+           encoding_info->n_cols, encoding_info->n_encoded_cols);
+}
+
+// One row of raw cells (cells[c] for original column c) into its encoded
+// row x, which must start zeroed: numbers are parsed, known categories set
+// their hot flag, and unknown categories or empty cells leave the block zero
+void encode_cells(const EncodingInfo *encoding_info, const char *const *cells, double *x) {
+    for (int c = 0; c < encoding_info->n_cols; c++) {
+        const ColumnInfo *col = &encoding_info->columns[c];
+        int j = encoding_info->original_to_encoded[c];
+        if (!col->is_categorical) {
+            x[j] = atof(cells[c]);
+        } else {
+            int code = dict_find(&col->categories, cells[c]);
+            if (code >= 0) x[j + code] = 1.0;
+        }
+    }
+}
+
+// Empty encoding with room for n_cols original columns
+void encoding_info_init(EncodingInfo *encoding_info, int n_cols) {
+    memset(encoding_info, 0, sizeof(*encoding_info));
+    encoding_info->n_cols = n_cols;
+    encoding_info->columns = calloc(n_cols > 0 ? n_cols : 1, sizeof(ColumnInfo));
+    encoding_info->original_names = calloc(n_cols > 0 ? n_cols : 1, MAX_STR);
+    encoding_info->original_to_encoded = calloc(n_cols > 0 ? n_cols : 1, sizeof(int));
+    if (!encoding_info->columns || !encoding_info->original_names ||
+        !encoding_info->original_to_encoded) {
+        fprintf(stderr, "Error: Out of memory for %d columns\n", n_cols);
+        exit(1);
+    }
+}
+
+void encoding_info_free(EncodingInfo *encoding_info) {
+    if (encoding_info->columns)
+        for (int c = 0; c < encoding_info->n_cols; c++)
+            dict_free(&encoding_info->columns[c].categories);
+    dict_free(&encoding_info->target_classes);
+    free(encoding_info->columns);
+    free(encoding_info->original_names);
+    free(encoding_info->original_to_encoded);
+    memset(encoding_info, 0, sizeof(*encoding_info));
+}
@@ -1,17 +1,22 @@
-// FILE:preprocessing.h
-
-#ifndef PREPROCESSING_H
-#define PREPROCESSING_H
-
-#include "data_types.h"
-
-int is_numeric_string(const char *s);
-int map_income_to_binary(const char *income_str);
-void detect_column_types(char data[MAX_ROWS][MAX_COLS][MAX_STR], int n_rows, 
-                        char headers[MAX_COLS][MAX_STR], int n_cols,
-                        EncodingInfo *encoding_info);
-void one_hot_encode_data(char raw_data[MAX_ROWS][MAX_COLS][MAX_STR], 
-                        int n_rows, EncodingInfo *encoding_info,
-                        Frame *X_out);
-
+// FILE:preprocessing.h
+
+#ifndef PREPROCESSING_H
+#define PREPROCESSING_H
+
+#include "data_types.h"
+
+int is_numeric_string(const char *s);
+int map_income_to_binary(const char *income_str);
+void detect_column_types(char **data, int n_rows, 
+                        char (*headers)[MAX_STR], int n_cols,
+                        EncodingInfo *encoding_info, int *codes);
+void one_hot_encode_data(char **raw_data, const int *codes,
+                        int n_rows, EncodingInfo *encoding_info,
+                        Frame *X_out);
+void encoding_layout(EncodingInfo *encoding_info);
+void encoding_colnames(const EncodingInfo *encoding_info, char (*colnames)[MAX_STR]);
+void encode_cells(const EncodingInfo *encoding_info, const char *const *cells, double *x);
+void encoding_info_init(EncodingInfo *encoding_info, int n_cols);
+void encoding_info_free(EncodingInfo *encoding_info);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,170 @@
+// FILE: random_forest.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "random_forest.h"
+#include "decision_tree.h"
+#include "frame.h"
+#include "parallel.h"
+#include "rng.h"
+
+void random_forest_default_options(ForestOptions *o) {
+    o->n_trees = 50;
+    o->max_depth = 12;
+    o->min_samples_split = 10;
+    o->n_bins = 32;
+    o->max_features = 0;
+    o->seed = 42;
+}
+
+// Trees are grown in parallel on one shared binning of X. Tree t draws its
+// bootstrap sample and feature subsets from stream t of the seed, so the
+// forest does not depend on the thread count.
+typedef struct {
+    RandomForest *RF;
+    const ForestOptions *opts;
+    const TreeBins *B;
+    const int *cls;
+    const int *class_ids;   // 0..n_classes-1, so leaves hold class indices
+    int max_features;
+    unsigned char *in_bag;  // n_trees x n, set for rows tree t sampled
+} FitJob;
+
+static void fit_task(void *ctx, int task, int begin, int end) {
+    FitJob *job = ctx;
+    int n = job->B->n;
+    int *rows = malloc((n > 0 ? n : 1) * sizeof(int));
+    if (!rows) {
+        fprintf(stderr, "Error: Out of memory training forest\n");
+        exit(1);
+    }
+    (void)task;
+
+    for (int t = begin; t < end; t++) {
+        Rng r;
+        rng_stream(&r, job->opts->seed, t);
+        unsigned char *bag = job->in_bag + (size_t)t * n;
+        for (int i = 0; i < n; i++) {
+            rows[i] = rng_below(&r, n);
+            bag[rows[i]] = 1;
+        }
+
+        Node *tree = decision_tree_fit_bins(job->B, job->cls, job->class_ids,
+                                            job->RF->n_classes, rows, n,
+                                            job->opts->max_depth, job->opts->min_samples_split,
+                                            job->max_features, rng_next(&r));
+        decision_tree_flatten(tree, &job->RF->trees[t]);
+        decision_tree_free(tree);
+    }
+    free(rows);
+}
+
+// Majority class of the votes, ties to the lower class index
+static int top_class(const int *votes, int n_classes) {
+    int best = 0;
+    for (int c = 1; c < n_classes; c++)
+        if (votes[c] > votes[best]) best = c;
+    return best;
+}
+
+typedef struct {
+    const RandomForest *RF;
+    const Frame *X;
+    const unsigned char *in_bag; // NULL: every tree votes
+    const int *cls;              // oob: true class index of each row
+    int *out;                    // predicted labels, or oob hits per task
+} VoteJob;
+
+static void vote_task(void *ctx, int task, int begin, int end) {
+    VoteJob *job = ctx;
+    const RandomForest *RF = job->RF;
+    int n = job->X->rows;
+    int *votes = malloc(RF->n_classes * sizeof(int));
+    int hits = 0, voted = 0;
+
+    for (int i = begin; i < end; i++) {
+        const double *x = frame_row(job->X, i);
+        int total = 0;
+        memset(votes, 0, RF->n_classes * sizeof(int));
+        for (int t = 0; t < RF->n_trees; t++) {
+            if (job->in_bag && job->in_bag[(size_t)t * n + i]) continue;
+            votes[flat_tree_label(&RF->trees[t], x)]++;
+            total++;
+        }
+        if (!job->in_bag) {
+            job->out[i] = RF->labels[top_class(votes, RF->n_classes)];
+        } else if (total > 0) {
+            voted++;
+            hits += top_class(votes, RF->n_classes) == job->cls[i];
+        }
+    }
+    if (job->in_bag) {
+        job->out[2 * task] = hits;
+        job->out[2 * task + 1] = voted;
+    }
+    free(votes);
+}
+
+// Train opts->n_trees trees on bootstrap samples of X, each split choosing
+// among max_features random features (sqrt(d) by default). The rows a tree
+// never sampled score it for free: oob_accuracy is the majority vote of
+// those trees only, over the rows that have any.
+void random_forest_fit(RandomForest *RF, Frame *X, int *y, const ForestOptions *opts) {
+    int n = X->rows;
+    int *cls = malloc((n > 0 ? n : 1) * sizeof(int));
+    RF->n_trees = opts->n_trees > 0 ? opts->n_trees : 1;
+    RF->n_classes = tree_classes(y, n, cls, &RF->labels);
+    RF->trees = calloc(RF->n_trees, sizeof(FlatTree));
+    RF->oob_accuracy = 0.0;
+
+    int max_features = opts->max_features;
+    if (max_features <= 0) max_features = (int)sqrt((double)X->cols);
+    if (max_features < 1) max_features = 1;
+
+    int *class_ids = malloc((RF->n_classes > 0 ? RF->n_classes : 1) * sizeof(int));
+    unsigned char *in_bag = calloc((size_t)RF->n_trees * (n > 0 ? n : 1), 1);
+    if (!cls || !RF->trees || !class_ids || !in_bag) {
+        fprintf(stderr, "Error: Out of memory training forest\n");
+        exit(1);
+    }
+    for (int c = 0; c < RF->n_classes; c++) class_ids[c] = c;
+
+    TreeBins B;
+    tree_bins_build(&B, X, opts->n_bins);
+    FitJob job = { RF, opts, &B, cls, class_ids, max_features, in_bag };
+    parallel_for(RF->n_trees, fit_task, &job);
+    tree_bins_free(&B);
+
+    int tasks = parallel_tasks(n);
+    int *tally = calloc(2 * tasks, sizeof(int));
+    VoteJob vote = { RF, X, in_bag, cls, tally };
+    parallel_for(n, vote_task, &vote);
+    int hits = 0, voted = 0;
+    for (int t = 0; t < tasks; t++) {
+        hits += tally[2 * t];
+        voted += tally[2 * t + 1];
+    }
+    if (voted > 0) RF->oob_accuracy = (double)hits / voted;
+
+    free(tally);
+    free(in_bag);
+    free(class_ids);
+    free(cls);
+}
+
+// Predict labels by majority vote over all trees, rows split across the pool
+void random_forest_predict(const RandomForest *RF, Frame *X, int *out) {
+    VoteJob job = { RF, X, NULL, NULL, out };
+    parallel_for(X->rows, vote_task, &job);
+}
+
+void random_forest_free(RandomForest *RF) {
+    for (int t = 0; t < RF->n_trees; t++) flat_tree_free(&RF->trees[t]);
+    free(RF->trees);
+    free(RF->labels);
+    RF->trees = NULL;
+    RF->labels = NULL;
+    RF->n_trees = 0;
+}
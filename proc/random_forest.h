@@ -0,0 +1,13 @@
+// FILE: random_forest.h
+
+#ifndef RANDOM_FOREST_H
+#define RANDOM_FOREST_H
+
+#include "data_types.h"
+
+void random_forest_default_options(ForestOptions *o);
+void random_forest_fit(RandomForest *RF, Frame *X, int *y, const ForestOptions *opts);
+void random_forest_predict(const RandomForest *RF, Frame *X, int *out);
+void random_forest_free(RandomForest *RF);
+
+#endif
@@ -0,0 +1,41 @@
+// FILE: rng.h
+
+#ifndef RNG_H
+#define RNG_H
+
+// Small seeded generator (splitmix64) so shuffles and tie breaks are
+// repeatable without touching the global rand() state.
+typedef struct {
+    unsigned long long state;
+} Rng;
+
+static inline void rng_seed(Rng *r, unsigned long long seed) {
+    r->state = seed;
+}
+
+// Independent stream number `stream` of a seed, e.g. one per test row so
+// results do not depend on which thread handles the row
+static inline void rng_stream(Rng *r, unsigned long long seed, unsigned long long stream) {
+    r->state = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+}
+
+static inline unsigned long long rng_next(Rng *r) {
+    unsigned long long z = (r->state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform integer in [0, n)
+static inline int rng_below(Rng *r, int n) {
+    return (int)(rng_next(r) % (unsigned long long)n);
+}
+
+static inline void rng_shuffle(Rng *r, int *a, int n) {
+    for (int i = n - 1; i > 0; i--) {
+        int j = rng_below(r, i + 1);
+        int t = a[i]; a[i] = a[j]; a[j] = t;
+    }
+}
+
+#endif
@@ -0,0 +1,557 @@
+// FILE: server.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "server.h"
+#include "frame.h"
+#include "feature_store.h"
+#include "preprocessing.h"
+
+/*
+Line protocol, one reply line per request line, in order per connection:
+
+  39,Private,Bachelors,...          a CSV row, training feature columns in order
+  {"age": 39, "sex": "Male", ...}   a JSON row, columns by name (missing = empty)
+  @forest 39,Private,...            either row form, scored by another model
+  COLUMNS                           the feature columns, comma separated
+  MODELS                            the model names
+
+Rows reply with the predicted class (as written in the training file) or
+value, anything malformed with "ERR <reason>".
+
+One thread runs the whole server: it polls every connection, encodes all the
+complete lines that have arrived into one batch (after waiting up to
+batch_wait_us for more to join), scores the batch with each model it asks
+for through the parallel pool, then queues the replies. Rows that arrive
+while a batch is scored simply make the next batch bigger.
+*/
+
+typedef struct {
+    int fd;             // -1 for a free slot
+    char *in;           // bytes received, not yet taken as lines
+    size_t in_len, in_cap;
+    char *out;          // replies not yet sent
+    size_t out_len, out_cap;
+    int closing;        // peer stopped sending: close once everything is answered
+} Conn;
+
+// One request of the batch; row i of the batch frame belongs to item i
+typedef struct {
+    int conn;
+    int model;          // -1 when text already holds the reply
+    char *text;
+} Item;
+
+typedef struct {
+    ModelBundle *M;
+    BundleModel default_model;
+    int listen_fd;
+    Conn conns[SERVE_MAX_CONNS];
+    Frame batch;
+    Item items[SERVE_MAX_BATCH];
+    int n;
+    const char **cells; // one per original column
+    int *cls;           // SERVE_MAX_BATCH per model
+    double *value;
+    long long rows_served, batches;
+} Server;
+
+static volatile sig_atomic_t stop_serving = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_serving = 1;
+}
+
+static void *serve_alloc(size_t n, size_t size) {
+    void *p = calloc(n ? n : 1, size);
+    if (!p) {
+        fprintf(stderr, "Error: Out of memory in server\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void buf_append(char **buf, size_t *len, size_t *cap, const char *s, size_t n) {
+    if (*len + n > *cap) {
+        size_t c = *cap ? *cap : 4096;
+        while (c < *len + n) c *= 2;
+        *buf = realloc(*buf, c);
+        if (!*buf) {
+            fprintf(stderr, "Error: Out of memory in server\n");
+            exit(1);
+        }
+        *cap = c;
+    }
+    memcpy(*buf + *len, s, n);
+    *len += n;
+}
+
+static void close_conn(Conn *c) {
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+static void reply(Server *S, int conn, const char *text) {
+    Item *it = &S->items[S->n];
+    memset(frame_row(&S->batch, S->n), 0, S->batch.cols * sizeof(double));
+    it->conn = conn;
+    it->model = -1;
+    it->text = strdup(text);
+    S->n++;
+}
+
+// Split a CSV line in place: fields are trimmed and may be "quoted" with ""
+// for a literal quote. Returns the field count, -1 for more than max.
+static int split_csv(char *s, const char **cells, int max) {
+    int n = 0;
+    for (;;) {
+        while (*s == ' ') s++;
+        if (n == max) return -1;
+        char *out = s;
+        cells[n++] = s;
+        if (*s == '"') {
+            char *r = s + 1;
+            while (*r && !(*r == '"' && r[1] != '"')) {
+                if (*r == '"') r++;
+                *out++ = *r++;
+            }
+            if (*r == '"') r++;
+            while (*r && *r != ',') r++;
+            s = r;
+        } else {
+            while (*s && *s != ',') s++;
+            out = s;
+            while (out > cells[n - 1] && out[-1] == ' ') out--;
+        }
+        int more = *s == ',';
+        *out = '\0';
+        if (!more) return n;
+        s++;
+    }
+}
+
+// Read the JSON string (or, if bare, number / literal) at *sp in place into
+// *tok and step past the delimiter that follows; returns that delimiter, or
+// 0 for a malformed token. \uXXXX escapes are not supported.
+static char json_token(char **sp, const char **tok, int bare) {
+    char *s = *sp, *start, *out;
+    while (*s == ' ') s++;
+    int quoted = *s == '"';
+    if (quoted) {
+        start = out = ++s;
+        while (*s && *s != '"') {
+            if (*s == '\\' && s[1]) {
+                s++;
+                *out++ = *s == 'n' ? '\n' : *s == 't' ? '\t' : *s;
+                s++;
+            } else {
+                *out++ = *s++;
+            }
+        }
+        if (*s != '"') return 0;
+        s++;
+    } else {
+        start = s;
+        while (*s && *s != ',' && *s != '}' && *s != ':' && *s != ' ') s++;
+        out = s;
+        if (!bare || out == start) return 0;
+    }
+    while (*s == ' ') s++;
+    char delim = *s;
+    *out = '\0';
+    *sp = delim ? s + 1 : s;
+    *tok = !quoted && strcmp(start, "null") == 0 ? "" : start;
+    return delim;
+}
+
+// Cells of a flat JSON object row, by column name: missing columns are
+// empty and unknown keys are ignored. Returns an error or NULL.
+static const char *split_json(char *s, const EncodingInfo *E, const char **cells) {
+    for (int c = 0; c < E->n_cols; c++) cells[c] = "";
+    while (*s == ' ') s++;
+    if (*s++ != '{') return "expected {";
+    while (*s == ' ') s++;
+    if (*s == '}') return NULL;
+    for (;;) {
+        const char *key, *value;
+        if (json_token(&s, &key, 0) != ':') return "expected \"key\":";
+        char delim = json_token(&s, &value, 1);
+        if (delim != ',' && delim != '}') return "expected , or }";
+        for (int c = 0; c < E->n_cols; c++)
+            if (strcmp(E->columns[c].name, key) == 0) cells[c] = value;
+        if (delim == '}') return NULL;
+    }
+}
+
+// Turn one request line into a batch item
+static void take_line(Server *S, int conn, char *line) {
+    const EncodingInfo *E = &S->M->encoding;
+    size_t len = strlen(line);
+    if (len > 0 && line[len - 1] == '\r') line[--len] = '\0';
+
+    int model = S->default_model;
+    if (line[0] == '@') {
+        char *sp = strchr(line, ' ');
+        if (sp) *sp = '\0';
+        model = bundle_model_find(line + 1);
+        if (model < 0) {
+            reply(S, conn, "ERR unknown model");
+            return;
+        }
+        line = sp ? sp + 1 : line + len;
+    }
+
+    if (strcmp(line, "COLUMNS") == 0 || strcmp(line, "MODELS") == 0) {
+        char *text = NULL;
+        size_t n = 0, cap = 0;
+        int columns = line[0] == 'C', count = columns ? E->n_cols : BUNDLE_N_MODELS;
+        for (int i = 0; i < count; i++) {
+            const char *name = columns ? E->columns[i].name : BUNDLE_MODEL_NAMES[i];
+            if (i > 0) buf_append(&text, &n, &cap, ",", 1);
+            buf_append(&text, &n, &cap, name, strlen(name));
+        }
+        buf_append(&text, &n, &cap, "", 1);
+        reply(S, conn, text);
+        free(text);
+        return;
+    }
+
+    const char **cells = S->cells;
+    const char *err = NULL;
+    if (line[0] == '{') {
+        err = split_json(line, E, cells);
+    } else if (line[0] == '\0') {
+        err = "empty row";
+    } else if (split_csv(line, cells, E->n_cols) != E->n_cols) {
+        err = "wrong number of columns";
+    }
+    if (err) {
+        char text[MAX_STR];
+        snprintf(text, sizeof(text), "ERR %s", err);
+        reply(S, conn, text);
+        return;
+    }
+
+    double *x = frame_row(&S->batch, S->n);
+    memset(x, 0, S->batch.cols * sizeof(double));
+    encode_cells(E, cells, x);
+    S->items[S->n] = (Item){ conn, model, NULL };
+    S->n++;
+}
+
+// Move complete lines from the connections into the batch until it is full
+static void drain_lines(Server *S) {
+    for (int c = 0; c < SERVE_MAX_CONNS && S->n < SERVE_MAX_BATCH; c++) {
+        Conn *cn = &S->conns[c];
+        if (cn->fd < 0) continue;
+        size_t pos = 0;
+        while (S->n < SERVE_MAX_BATCH) {
+            char *nl = memchr(cn->in + pos, '\n', cn->in_len - pos);
+            if (!nl) break;
+            *nl = '\0';
+            take_line(S, c, cn->in + pos);
+            pos = nl - cn->in + 1;
+        }
+        memmove(cn->in, cn->in + pos, cn->in_len - pos);
+        cn->in_len -= pos;
+        if (cn->in_len > SERVE_MAX_LINE && S->n < SERVE_MAX_BATCH) {
+            reply(S, c, "ERR line too long");
+            cn->in_len = 0;
+            cn->closing = 1;
+        }
+    }
+}
+
+static int lines_waiting(const Server *S) {
+    for (int c = 0; c < SERVE_MAX_CONNS; c++)
+        if (S->conns[c].fd >= 0 && memchr(S->conns[c].in, '\n', S->conns[c].in_len)) return 1;
+    return 0;
+}
+
+static void flush_conn(Conn *c) {
+    while (c->out_len > 0) {
+        ssize_t k = send(c->fd, c->out, c->out_len, MSG_NOSIGNAL);
+        if (k < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR) continue;
+            c->out_len = 0;        // peer is gone, drop what it did not take
+            c->in_len = 0;
+            c->closing = 1;
+            return;
+        }
+        memmove(c->out, c->out + k, c->out_len - k);
+        c->out_len -= k;
+    }
+}
+
+// Wait (at most timeout, NULL = until something happens) for new clients,
+// input and room to send, and handle all of it
+static void poll_io(Server *S, const struct timespec *timeout) {
+    struct pollfd fds[SERVE_MAX_CONNS + 1];
+    int slot[SERVE_MAX_CONNS + 1], nfds = 0;
+    fds[nfds] = (struct pollfd){ S->listen_fd, POLLIN, 0 };
+    slot[nfds++] = -1;
+    for (int c = 0; c < SERVE_MAX_CONNS; c++) {
+        Conn *cn = &S->conns[c];
+        if (cn->fd < 0) continue;
+        short events = (cn->closing ? 0 : POLLIN) | (cn->out_len ? POLLOUT : 0);
+        fds[nfds] = (struct pollfd){ cn->fd, events, 0 };
+        slot[nfds++] = c;
+    }
+    if (ppoll(fds, nfds, timeout, NULL) <= 0) return;
+
+    if (fds[0].revents & POLLIN) {
+        int fd;
+        while ((fd = accept(S->listen_fd, NULL, NULL)) >= 0) {
+            int c = 0;
+            while (c < SERVE_MAX_CONNS && S->conns[c].fd >= 0) c++;
+            if (c == SERVE_MAX_CONNS) {
+                close(fd);
+                continue;
+            }
+            fcntl(fd, F_SETFL, O_NONBLOCK);
+            S->conns[c].fd = fd;
+        }
+    }
+
+    char buf[65536];
+    for (int i = 1; i < nfds; i++) {
+        Conn *cn = &S->conns[slot[i]];
+        if (fds[i].revents & POLLOUT) flush_conn(cn);
+        if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)) || cn->closing) continue;
+        for (;;) {
+            ssize_t k = recv(cn->fd, buf, sizeof(buf), 0);
+            if (k > 0) {
+                buf_append(&cn->in, &cn->in_len, &cn->in_cap, buf, k);
+                continue;
+            }
+            if (k < 0 && errno == EINTR) continue;
+            if (k == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                // a last line without a newline still counts
+                if (cn->in_len > 0 && cn->in[cn->in_len - 1] != '\n')
+                    buf_append(&cn->in, &cn->in_len, &cn->in_cap, "\n", 1);
+                cn->closing = 1;
+            }
+            break;
+        }
+    }
+}
+
+// Score the batch with every model it uses and queue the replies
+static void score_batch(Server *S) {
+    if (S->n == 0) return;
+    int used[BUNDLE_N_MODELS] = { 0 }, need_features = 0, scored = 0;
+    for (int i = 0; i < S->n; i++)
+        if (S->items[i].model >= 0) used[S->items[i].model] = scored = 1;
+    need_features = used[BUNDLE_LOGISTIC] || used[BUNDLE_NAIVE_BAYES] || used[BUNDLE_LINEAR];
+
+    S->batch.rows = S->n;
+    FeatureStore F;
+    if (need_features) bundle_features(S->M, &S->batch, &F);
+    for (int m = 0; m < BUNDLE_N_MODELS; m++)
+        if (used[m])
+            bundle_predict(S->M, m, &S->batch, &F, S->cls + (size_t)m * SERVE_MAX_BATCH,
+                           S->value + (size_t)m * SERVE_MAX_BATCH);
+    if (need_features) features_free(&F);
+
+    char text[MAX_STR + 2];
+    for (int i = 0; i < S->n; i++) {
+        Item *it = &S->items[i];
+        Conn *cn = &S->conns[it->conn];
+        if (it->model >= 0) {
+            size_t k = (size_t)it->model * SERVE_MAX_BATCH + i;
+            bundle_format(S->M, it->model, S->cls[k], S->value[k], text, MAX_STR);
+            buf_append(&cn->out, &cn->out_len, &cn->out_cap, text, strlen(text));
+            S->rows_served++;
+        } else {
+            buf_append(&cn->out, &cn->out_len, &cn->out_cap, it->text, strlen(it->text));
+            free(it->text);
+        }
+        buf_append(&cn->out, &cn->out_len, &cn->out_cap, "\n", 1);
+    }
+    S->batches += scored;
+    S->n = 0;
+}
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Serve M on a Unix socket at socket_path until SIGINT or SIGTERM. Returns
+// nonzero if the socket cannot be set up.
+int serve_models(ModelBundle *M, const char *socket_path, BundleModel default_model,
+                 int batch_wait_us) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", socket_path);
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    // a socket left behind by an earlier server is replaced, anything else is not
+    struct stat st;
+    if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(socket_path);
+
+    Server *S = serve_alloc(1, sizeof(Server));
+    S->M = M;
+    S->default_model = default_model;
+    S->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (S->listen_fd < 0 || bind(S->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(S->listen_fd, 64) != 0) {
+        fprintf(stderr, "Error: Cannot listen on %s: %s\n", socket_path, strerror(errno));
+        if (S->listen_fd >= 0) close(S->listen_fd);
+        free(S);
+        return 1;
+    }
+    fcntl(S->listen_fd, F_SETFL, O_NONBLOCK);
+    for (int c = 0; c < SERVE_MAX_CONNS; c++) S->conns[c].fd = -1;
+    frame_init(&S->batch, SERVE_MAX_BATCH, M->n_features);
+    S->cls = serve_alloc((size_t)BUNDLE_N_MODELS * SERVE_MAX_BATCH, sizeof(int));
+    S->value = serve_alloc((size_t)BUNDLE_N_MODELS * SERVE_MAX_BATCH, sizeof(double));
+    S->cells = serve_alloc(M->encoding.n_cols, sizeof(char *));
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;   // no SA_RESTART, so ppoll wakes up
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    stop_serving = 0;
+
+    printf("Serving on %s (default model %s, batch wait %d us), stop with Ctrl-C\n",
+           socket_path, BUNDLE_MODEL_NAMES[default_model], batch_wait_us);
+    fflush(stdout);
+
+    const struct timespec now_ts = { 0, 0 };
+    while (!stop_serving) {
+        poll_io(S, lines_waiting(S) ? &now_ts : NULL);
+        drain_lines(S);
+
+        // give rows a short window to join a batch that is not full yet
+        if (batch_wait_us > 0 && S->n > 0) {
+            double deadline = now_us() + batch_wait_us;
+            while (S->n < SERVE_MAX_BATCH && !stop_serving) {
+                double left = deadline - now_us();
+                if (left <= 0) break;
+                struct timespec ts = { (time_t)(left / 1e6), (long)((long long)left % 1000000 * 1000) };
+                poll_io(S, &ts);
+                drain_lines(S);
+            }
+        }
+
+        score_batch(S);
+        for (int c = 0; c < SERVE_MAX_CONNS; c++) {
+            Conn *cn = &S->conns[c];
+            if (cn->fd < 0) continue;
+            flush_conn(cn);
+            if (cn->closing && cn->out_len == 0 && !memchr(cn->in, '\n', cn->in_len))
+                close_conn(cn);
+        }
+    }
+
+    printf("\nServed %lld rows in %lld batches\n", S->rows_served, S->batches);
+    for (int c = 0; c < SERVE_MAX_CONNS; c++)
+        if (S->conns[c].fd >= 0) close_conn(&S->conns[c]);
+    for (int i = 0; i < S->n; i++) free(S->items[i].text);
+    close(S->listen_fd);
+    unlink(socket_path);
+    frame_free(&S->batch);
+    free(S->cls);
+    free(S->value);
+    free(S->cells);
+    free(S);
+    return 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Send every non empty line of in as one request, waiting for each reply,
+// print the replies and report the round trip latencies on stderr
+int client_run(const char *socket_path, FILE *in) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Error: Cannot connect to %s: %s\n", socket_path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+
+    char *line = NULL, *resp = NULL;
+    size_t line_cap = 0, resp_len = 0, resp_cap = 0;
+    double *lat = NULL;
+    int n = 0, cap = 0, failed = 0;
+    ssize_t len;
+    while (!failed && (len = getline(&line, &line_cap, in)) > 0) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+        if (len == 0) continue;
+        line[len++] = '\n';
+
+        double t0 = now_us();
+        for (ssize_t sent = 0; sent < len;) {
+            ssize_t k = send(fd, line + sent, len - sent, MSG_NOSIGNAL);
+            if (k <= 0) {
+                failed = 1;
+                break;
+            }
+            sent += k;
+        }
+        char *nl;
+        while (!failed && !(nl = memchr(resp, '\n', resp_len))) {
+            char buf[4096];
+            ssize_t k = recv(fd, buf, sizeof(buf), 0);
+            if (k <= 0) failed = 1;
+            else buf_append(&resp, &resp_len, &resp_cap, buf, k);
+        }
+        if (failed) break;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 1024;
+            lat = realloc(lat, cap * sizeof(double));
+            if (!lat) {
+                fprintf(stderr, "Error: Out of memory in client\n");
+                exit(1);
+            }
+        }
+        lat[n++] = now_us() - t0;
+
+        size_t k = nl - resp + 1;
+        fwrite(resp, 1, k, stdout);
+        memmove(resp, resp + k, resp_len - k);
+        resp_len -= k;
+    }
+    if (failed) fprintf(stderr, "Error: Connection to %s closed\n", socket_path);
+
+    if (n > 0) {
+        qsort(lat, n, sizeof(double), cmp_double);
+        fprintf(stderr, "%d requests, round trip p50 %.1f us, p99 %.1f us, max %.1f us\n",
+                n, lat[n / 2], lat[(int)(n * 0.99) < n ? (int)(n * 0.99) : n - 1], lat[n - 1]);
+    }
+    free(line);
+    free(resp);
+    free(lat);
+    close(fd);
+    return failed;
+}
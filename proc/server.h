@@ -0,0 +1,18 @@
+// FILE: server.h
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+#include "data_types.h"
+#include "model_io.h"
+
+#define SERVE_MAX_BATCH 1024     // rows scored together
+#define SERVE_MAX_LINE 65536     // longest request line
+#define SERVE_MAX_CONNS 256      // clients connected at once
+
+int serve_models(ModelBundle *M, const char *socket_path, BundleModel default_model,
+                 int batch_wait_us);
+int client_run(const char *socket_path, FILE *in);
+
+#endif
@@ -0,0 +1,92 @@
+// FILE: str_dict.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "str_dict.h"
+
+// FNV-1a string hash
+static unsigned int hash_str(const char *s) {
+    unsigned int h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void *checked_realloc(void *p, size_t bytes) {
+    void *q = realloc(p, bytes);
+    if (!q) {
+        fprintf(stderr, "Error: Out of memory growing dictionary\n");
+        exit(1);
+    }
+    return q;
+}
+
+// Rebuild the slot table at twice the size (codes do not change)
+static void grow_slots(StrDict *d) {
+    int n_slots = d->n_slots ? d->n_slots * 2 : 64;
+    int *slots = checked_realloc(NULL, n_slots * sizeof(int));
+    for (int i = 0; i < n_slots; i++) slots[i] = -1;
+
+    for (int code = 0; code < d->count; code++) {
+        unsigned int i = d->hashes[code] & (n_slots - 1);
+        while (slots[i] >= 0) i = (i + 1) & (n_slots - 1);
+        slots[i] = code;
+    }
+
+    free(d->slots);
+    d->slots = slots;
+    d->n_slots = n_slots;
+}
+
+void dict_init(StrDict *d) {
+    memset(d, 0, sizeof(*d));
+}
+
+// Code of key, or -1 if it has never been interned
+int dict_find(const StrDict *d, const char *key) {
+    if (d->n_slots == 0) return -1;
+    unsigned int h = hash_str(key);
+    unsigned int i = h & (d->n_slots - 1);
+    while (d->slots[i] >= 0) {
+        int code = d->slots[i];
+        if (d->hashes[code] == h && strcmp(d->keys[code], key) == 0) return code;
+        i = (i + 1) & (d->n_slots - 1);
+    }
+    return -1;
+}
+
+// Code of key, adding it with the next free code the first time it is seen
+int dict_intern(StrDict *d, const char *key) {
+    if (2 * (d->count + 1) > d->n_slots) grow_slots(d);
+
+    unsigned int h = hash_str(key);
+    unsigned int i = h & (d->n_slots - 1);
+    while (d->slots[i] >= 0) {
+        int code = d->slots[i];
+        if (d->hashes[code] == h && strcmp(d->keys[code], key) == 0) return code;
+        i = (i + 1) & (d->n_slots - 1);
+    }
+
+    if (d->count == d->cap) {
+        d->cap = d->cap ? d->cap * 2 : 16;
+        d->keys = checked_realloc(d->keys, d->cap * sizeof(char *));
+        d->hashes = checked_realloc(d->hashes, d->cap * sizeof(unsigned int));
+    }
+
+    int code = d->count++;
+    d->keys[code] = strdup(key);
+    d->hashes[code] = h;
+    d->slots[i] = code;
+    return code;
+}
+
+void dict_free(StrDict *d) {
+    for (int i = 0; i < d->count; i++) free(d->keys[i]);
+    free(d->keys);
+    free(d->hashes);
+    free(d->slots);
+    memset(d, 0, sizeof(*d));
+}
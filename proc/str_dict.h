@@ -0,0 +1,13 @@
+// FILE: str_dict.h
+
+#ifndef STR_DICT_H
+#define STR_DICT_H
+
+#include "data_types.h"
+
+void dict_init(StrDict *d);
+int dict_intern(StrDict *d, const char *key);
+int dict_find(const StrDict *d, const char *key);
+void dict_free(StrDict *d);
+
+#endif
@@ -0,0 +1,263 @@
+// FILE: stream_train.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stream_train.h"
+#include "chunk_reader.h"
+#include "frame.h"
+#include "feature_store.h"
+#include "data_utils.h"
+#include "metrics.h"
+#include "linalg.h"
+#include "logistic_regression.h"
+#include "linear_regression.h"
+#include "naive_bayes.h"
+#include "decision_tree.h"
+#include "rng.h"
+
+// Out-of-core training for files that do not fit in memory. Only one chunk
+// of rows is held at a time and every model is fitted from passes over the
+// file (the first parses the CSV and writes the dataset cache, the rest
+// read the cache):
+//
+//   pass 1    column stats (Chan merge per chunk) and a reservoir sample of
+//             the training rows for the tree's bins
+//   pass 2..  naive Bayes from accumulated per-class stats, the linear
+//             normal equations X^T X / X^T y, one mini-batch epoch of
+//             logistic regression and one level of the tree per pass, until
+//             logistic regression converges and the tree is complete
+//   last      the test rows, scored chunk by chunk
+//
+// The split keeps file order like the default in-memory one, so the test
+// side is the tail of the file and training passes stop where it begins.
+// Random forest, boosting and KNN need every row at once and are left to the
+// in-memory path.
+
+void stream_default_options(StreamOptions *o) {
+    o->chunk_rows = CHUNK_ROWS_DEFAULT;
+    o->test_size = 0.3;
+    logistic_regression_default_options(&o->log_opts, LOGREG_ADAM);
+    o->ridge = 0.0;
+    o->tree_max_depth = 5;
+    o->tree_min_samples_split = 10;
+    o->tree_bins = 16;
+    o->seed = 42;
+}
+
+// Rows of the chunk [first, first + m) that are training rows (a prefix)
+static int train_part(int first, int m, int n_train) {
+    int k = n_train - first;
+    return k < 0 ? 0 : k > m ? m : k;
+}
+
+// Frame over rows [begin, begin + m) of a heap frame, nothing copied
+static Frame frame_slice(const Frame *X, int begin, int m) {
+    Frame part = *X;
+    part.data = X->data + (size_t)begin * X->cols;
+    part.rows = m;
+    return part;
+}
+
+static FILE *open_results(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) fprintf(stderr, "Error: Could not create %s\n", path);
+    else fprintf(fp, "Model,Metric1_Name,Metric1_Value,Metric2_Name,Metric2_Value\n");
+    return fp;
+}
+
+int stream_train(const char *csv_path, const char *target_col, const StreamOptions *o,
+                 const char *results_csv) {
+    ChunkReader r;
+    chunk_reader_open(&r, csv_path, target_col, o->chunk_rows);
+    const EncodingInfo *E = &r.encoding;
+    int n = r.rows, d = r.X.cols, cap = r.chunk_rows;
+    int n_train = (int)(n * (1 - o->test_size));
+    int classify = E->target_is_categorical;
+    int n_classes = E->target_classes.count;
+    printf("Training: %d samples\n", n_train);
+    printf("Test: %d samples\n", n - n_train);
+    printf("Chunks of %d rows\n\n", cap);
+    if (n_train <= 0 || n_train >= n) {
+        fprintf(stderr, "Error: test_size leaves no rows on one side\n");
+        chunk_reader_close(&r);
+        return 1;
+    }
+
+    //pass 1: column stats and the bin sample (reservoir over the training rows)
+    printf("Pass 1: column stats...");
+    fflush(stdout);
+    StatsAcc acc;
+    stats_acc_init(&acc, d);
+    Frame sample;
+    frame_init(&sample, cap, d);
+    int n_sample = 0, m;
+    long long seen = 0;
+    Rng rng;
+    rng_seed(&rng, o->seed);
+    while ((m = chunk_reader_next(&r)) > 0) {
+        int k = train_part(r.next - m, m, n_train);
+        if (k == 0) continue; // read on: the pass writes the cache
+        Frame part = frame_slice(&r.X, 0, k);
+        stats_acc_add(&acc, &part);
+        for (int i = 0; i < k; i++) {
+            long long slot = seen++ < cap ? n_sample++ : (long long)(rng_next(&rng) % seen);
+            if (slot < cap) memcpy(frame_row(&sample, slot), frame_row(&r.X, i), d * sizeof(double));
+        }
+    }
+    Stats S;
+    stats_acc_finish(&acc, &S);
+    sample.rows = n_sample;
+    printf(" done\n");
+
+    //passes 2..: every model that learns from the training rows
+    int d1 = d + 1;
+    double *A = calloc((size_t)d1 * d1, sizeof(double));
+    double *rhs = calloc(d1, sizeof(double));
+    double *A_chunk = malloc((size_t)d1 * d1 * sizeof(double));
+    double *rhs_chunk = malloc(d1 * sizeof(double));
+    int *cls = malloc((size_t)cap * sizeof(int));
+    int *pred = malloc((size_t)cap * sizeof(int));
+    double *pred_value = malloc((size_t)cap * sizeof(double));
+    if (!A || !rhs || !A_chunk || !rhs_chunk || !cls || !pred || !pred_value) {
+        fprintf(stderr, "Error: Out of memory for streamed training\n");
+        exit(1);
+    }
+
+    GNBModel nb;
+    naive_bayes_init(&nb, d);
+    LogRegStream log_stream;
+    logistic_regression_stream_init(&log_stream, d, cap, &o->log_opts);
+    TreeStream tree_stream;
+    tree_stream_init(&tree_stream, &sample, n_classes, o->tree_max_depth,
+                     o->tree_min_samples_split, o->tree_bins, cap);
+    frame_free(&sample);
+
+    printf("Training %s...", classify
+           ? "logistic regression, naive Bayes, decision tree and linear regression"
+           : "linear regression");
+    fflush(stdout);
+    int first_pass = 1, log_done = !classify, tree_done = !classify, pass = 1;
+    while (first_pass || !log_done || !tree_done) {
+        pass++;
+        chunk_reader_rewind(&r);
+        while ((m = chunk_reader_next(&r)) > 0) {
+            int k = train_part(r.next - m, m, n_train);
+            if (k == 0) break; // only test rows from here on
+            Frame part = frame_slice(&r.X, 0, k);
+            for (int i = 0; i < k; i++) cls[i] = (int)r.y[i];
+
+            if (first_pass || !log_done) {
+                FeatureStore F;
+                features_from_frame(&part, E, &F);
+                features_standardize(&F, &S);
+                if (first_pass) {
+                    if (classify) naive_bayes_partial_fit_fs(&nb, &F, cls);
+                    gram_fs(&F, NULL, r.y, A_chunk, rhs_chunk);
+                    for (size_t q = 0; q < (size_t)d1 * d1; q++) A[q] += A_chunk[q];
+                    for (int j = 0; j < d1; j++) rhs[j] += rhs_chunk[j];
+                }
+                if (!log_done) logistic_regression_stream_chunk(&log_stream, &F, r.y);
+                features_free(&F);
+            }
+            if (!tree_done) tree_stream_chunk(&tree_stream, &part, cls);
+        }
+        first_pass = 0;
+        if (!log_done) log_done = logistic_regression_stream_epoch(&log_stream);
+        if (!tree_done) tree_done = tree_stream_level(&tree_stream);
+    }
+    printf(" %d pass%s\n", pass - 1, pass - 1 == 1 ? "" : "es");
+
+    double *w_log = malloc(d * sizeof(double)), b_log;
+    FitReport log_report;
+    logistic_regression_stream_finish(&log_stream, w_log, &b_log, &log_report);
+    Node *tree = tree_stream_finish(&tree_stream);
+    FlatTree flat_tree;
+    decision_tree_flatten(tree, &flat_tree);
+    decision_tree_free(tree);
+
+    double *w_lin = calloc(d, sizeof(double)), b_lin;
+    double *x = malloc(d1 * sizeof(double));
+    if (ridge_solve(A, rhs, d, o->ridge, x) == 0) {
+        memcpy(w_lin, x, d * sizeof(double));
+        b_lin = x[d];
+    } else {
+        printf("Linear regression: normal equations singular, predicting the mean\n");
+        b_lin = rhs[d] / A[(size_t)d * d1 + d];
+    }
+    if (classify)
+        printf("Logistic regression: %d epochs, loss %.6f%s\n", log_report.iterations,
+               log_report.loss, log_report.converged ? "" : " (not converged)");
+
+    //last pass: score the test rows
+    printf("Scoring the test rows...");
+    fflush(stdout);
+    ClassScore score_log = { 0 }, score_nb = { 0 }, score_tree = { 0 };
+    RegScore score_lin = { 0 };
+    chunk_reader_rewind(&r);
+    while ((m = chunk_reader_next(&r)) > 0) {
+        int k = train_part(r.next - m, m, n_train);
+        if (k == m) continue;
+        Frame part = frame_slice(&r.X, k, m - k);
+        const double *y = r.y + k;
+        for (int i = 0; i < m - k; i++) cls[i] = (int)y[i];
+
+        FeatureStore F;
+        features_from_frame(&part, E, &F);
+        features_standardize(&F, &S);
+        if (classify) {
+            logistic_regression_predict_fs(&F, w_log, b_log, pred);
+            class_score_add(&score_log, cls, pred, part.rows);
+            naive_bayes_predict_fs(&nb, &F, pred);
+            class_score_add(&score_nb, cls, pred, part.rows);
+            flat_tree_predict(&flat_tree, &part, pred);
+            class_score_add(&score_tree, cls, pred, part.rows);
+        }
+        linear_regression_predict_fs(&F, w_lin, b_lin, pred_value);
+        reg_score_add(&score_lin, y, pred_value, part.rows);
+        features_free(&F);
+    }
+    printf(" done after %d passes\n", pass + 1);
+
+    printf("\nRESULTS\n");
+    printf("========================================\n");
+    printf("Model                       | Metric 1  | Metric 2\n");
+    printf("----------------------------|-----------|----------\n");
+    FILE *fp = open_results(results_csv);
+    if (classify) {
+        const char *names[3] = { "Logistic Regression", "Gaussian Naive Bayes",
+                                 "Decision Tree (ID3)" };
+        const ClassScore *scores[3] = { &score_log, &score_nb, &score_tree };
+        for (int k = 0; k < 3; k++) {
+            double acc_k = class_score_accuracy(scores[k]), f1_k = class_score_macro_f1(scores[k]);
+            printf("%-27s | Acc:%.4f | F1:%.4f\n", names[k], acc_k, f1_k);
+            if (fp) fprintf(fp, "%s,Accuracy,%.4f,F1-Score,%.4f\n", names[k], acc_k, f1_k);
+        }
+    }
+    double rmse_lin = reg_score_rmse(&score_lin), r2_lin = reg_score_r2(&score_lin);
+    printf("Linear Regression           | RMSE:%.4f| R²:%.4f\n", rmse_lin, r2_lin);
+    if (fp) {
+        fprintf(fp, "Linear Regression,RMSE,%.4f,R-Squared,%.4f\n", rmse_lin, r2_lin);
+        fclose(fp);
+        printf("\nResults saved to: %s\n", results_csv);
+    }
+
+    class_score_free(&score_log);
+    class_score_free(&score_nb);
+    class_score_free(&score_tree);
+    free(w_log);
+    free(w_lin);
+    free(x);
+    free(A);
+    free(rhs);
+    free(A_chunk);
+    free(rhs_chunk);
+    free(cls);
+    free(pred);
+    free(pred_value);
+    naive_bayes_free(&nb);
+    flat_tree_free(&flat_tree);
+    stats_free(&S);
+    chunk_reader_close(&r);
+    return 0;
+}
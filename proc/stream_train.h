@@ -0,0 +1,24 @@
+// FILE: stream_train.h
+
+#ifndef STREAM_TRAIN_H
+#define STREAM_TRAIN_H
+
+#include "data_types.h"
+
+// Settings of an out-of-core run
+typedef struct {
+    int chunk_rows;            // rows in memory at once
+    double test_size;          // the last share of the file is the test side
+    LogRegOptions log_opts;    // sgd or adam; other optimizers train with adam
+    double ridge;              // L2 penalty of the linear normal equations
+    int tree_max_depth;
+    int tree_min_samples_split;
+    int tree_bins;
+    unsigned long long seed;   // sample the tree bins are fitted on
+} StreamOptions;
+
+void stream_default_options(StreamOptions *o);
+int stream_train(const char *csv_path, const char *target_col, const StreamOptions *o,
+                 const char *results_csv);
+
+#endif